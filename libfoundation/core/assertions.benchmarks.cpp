@@ -0,0 +1,85 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include "libfoundation/core/assertions.hpp"
+#include "libfoundation/heaps/heaps.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <numeric>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+namespace core = foundation::core;
+
+/* doc
+The same loop over state.range(0) sorted values, without checks and with a
+cheap check per element plus an expensive check of the whole range per
+pass.  The counter ``level`` is ``core::ASSERT_LEVEL``: in release builds it
+is 0 and both loops must run equally fast, as the checks compile to nothing.
+*/
+static void BMunchecked(benchmark::State& state)
+{
+    std::vector<std::int64_t> values(state.range(0));
+    std::iota(values.begin(), values.end(), 0);
+    for (auto _ : state)
+    {
+        std::int64_t sum{0};
+        for (std::int64_t value : values)
+            sum += value;
+        benchmark::DoNotOptimize(sum);
+    }
+    state.counters["level"] = static_cast<int>(core::ASSERT_LEVEL);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BMunchecked)->Arg(1 << 10)->Arg(1 << 16);
+
+static void BMchecked(benchmark::State& state)
+{
+    std::vector<std::int64_t> values(state.range(0));
+    std::iota(values.begin(), values.end(), 0);
+    for (auto _ : state)
+    {
+        std::int64_t sum{0};
+        for (std::int64_t value : values)
+        {
+            ERR_ASSERT_CHEAP_m(value >= 0, "negative value");
+            sum += value;
+        }
+        ERR_ASSERT_EXPENSIVE_m(std::is_sorted(values.begin(), values.end()), "unsorted values");
+        benchmark::DoNotOptimize(sum);
+    }
+    state.counters["level"] = static_cast<int>(core::ASSERT_LEVEL);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BMchecked)->Arg(1 << 10)->Arg(1 << 16);
+
+/* doc
+A push and a pop on a heap of state.range(0) values, through
+``heaps::pushHeap`` and ``heaps::popHeap``, which check the heap property of
+the whole range after every operation in builds with expensive checks.
+Against ``BMpushPop`` of the heap benchmarks, the cost of that check turns
+O(log n) operations into O(n) ones; in release builds the two agree.
+*/
+static void BMheapChecks(benchmark::State& state)
+{
+    std::vector<std::int64_t> data(state.range(0));
+    std::generate(data.begin(), data.end(), [] { return std::rand() >> 1; });
+    foundation::heaps::makeHeap(data.begin(), data.end());
+    data.reserve(data.size() + 1);
+
+    for (auto _ : state)
+    {
+        data.push_back(std::rand() >> 1);
+        foundation::heaps::pushHeap(data.begin(), data.end());
+        foundation::heaps::popHeap(data.begin(), data.end());
+        data.pop_back();
+    }
+    state.counters["level"] = static_cast<int>(core::ASSERT_LEVEL);
+    state.SetItemsProcessed(2 * state.iterations());
+}
+BENCHMARK(BMheapChecks)->Arg(1 << 10)->Arg(1 << 16);
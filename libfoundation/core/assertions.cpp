@@ -0,0 +1,19 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include "libfoundation/core/assertions.hpp"
+
+namespace foundation {
+namespace core {
+namespace internal {
+
+void assertionFailed(const char* file, int line, const char* condition, const char* msg) {
+    throw AssertionError("\nError in " + std::string(file) + ":" + std::to_string(line) +
+                         "\nCheck failed: " + condition + "\nMessage: " + msg);
+}
+
+}  // namespace internal
+}  // namespace core
+}  // namespace foundation
@@ -6,23 +6,105 @@
 #ifndef ASSERTIONS_HPP_
 #define ASSERTIONS_HPP_
 
+#include <stdexcept>
+#include <string>
+
+/* doc
+Checked assertions come in two levels on top of the ERR_ASSERT_THROW_m
+family, which is always active: cheap checks cost O(1) and may sit in hot
+loops, expensive checks verify a whole invariant, such as the heap property
+of a range, and may change the complexity of the code they guard.
+
+ERR_ASSERT_LEVEL_m selects the checks compiled in. It defaults to cheap, or
+to off when NDEBUG is defined; the CMake cache variable
+FOUNDATION_ASSERT_LEVEL overrides it for the whole build. Checks above the
+level are discarded at compile time, their conditions are not evaluated.
+*/
+#define ERR_LEVEL_OFF_m       0
+#define ERR_LEVEL_CHEAP_m     1
+#define ERR_LEVEL_EXPENSIVE_m 2
+
+#ifndef ERR_ASSERT_LEVEL_m
+#ifdef NDEBUG
+#define ERR_ASSERT_LEVEL_m ERR_LEVEL_OFF_m
+#else
+#define ERR_ASSERT_LEVEL_m ERR_LEVEL_CHEAP_m
+#endif
+#endif
+
 namespace foundation {
 namespace core {
 
+/** @brief Thrown by a failed checked assertion, the code is broken rather than its input */
+class AssertionError : public std::logic_error
+{
+ public:
+    using std::logic_error::logic_error;
+};
+
+enum class AssertLevel
+{
+    off       = ERR_LEVEL_OFF_m,
+    cheap     = ERR_LEVEL_CHEAP_m,
+    expensive = ERR_LEVEL_EXPENSIVE_m
+};
+
+/** @brief The level this translation unit was compiled with */
+inline constexpr AssertLevel ASSERT_LEVEL = static_cast<AssertLevel>(ERR_ASSERT_LEVEL_m);
+
+/** @brief Whether checks of the given level are compiled in */
+constexpr bool checks(AssertLevel level)
+{
+    return level <= ASSERT_LEVEL;
+}
+
+namespace internal {
+
+// failures are kept out of line and in the cold section, so a check costs
+// its comparison and a not taken branch at the call site
+template <typename Exception>
+[[noreturn, gnu::cold, gnu::noinline]] void raise(const char* file, int line, const std::string& msg)
+{
+    throw Exception("\nError in " + std::string(file) + ":" + std::to_string(line) + "\nMessage: " + msg);
+}
+
+[[noreturn, gnu::cold, gnu::noinline]] void assertionFailed(const char* file, int line,
+                                                             const char* condition, const char* msg);
+
+}  // namespace internal
 
 #define ERR_FILE2_m std::string(__FILE__)
 #define ERR_FILE_m ERR_FILE2_m
 #define ERR_LINE2_m std::to_string(__LINE__)
 #define ERR_LINE_m ERR_LINE2_m
 
-#define ERR_ASSERT_THROW_m(cond, exception, msg)\
-if(!(cond)) {throw exception("\nError in " + ERR_FILE_m + ":" + ERR_LINE_m + "\nMessage: " + msg);}    
+#define ERR_ASSERT_THROW_m(cond, exception, msg)                                        \
+    do {                                                                                \
+        if (!(cond)) [[unlikely]]                                                       \
+            ::foundation::core::internal::raise<exception>(__FILE__, __LINE__, msg);    \
+    } while (false)
 
 #define ERR_ASSERT_THROW_INVARG_m(cond, msg) ERR_ASSERT_THROW_m(cond, std::invalid_argument, msg)
 #define ERR_ASSERT_THROW_LENGTH_m(cond, msg) ERR_ASSERT_THROW_m(cond, std::length_error, msg)
 #define ERR_ASSERT_THROW_RANGE_m(cond, msg)  ERR_ASSERT_THROW_m(cond, std::out_of_range, msg)
-}
-}
 
+#define ERR_ASSERT_LEVEL_CHECK_m(level, cond, msg)                                              \
+    do {                                                                                        \
+        if constexpr (::foundation::core::checks(level)) {                                      \
+            if (!(cond)) [[unlikely]]                                                           \
+                ::foundation::core::internal::assertionFailed(__FILE__, __LINE__, #cond, msg);  \
+        }                                                                                       \
+    } while (false)
+
+/** @brief Throws AssertionError if cond is false, in builds with cheap checks */
+#define ERR_ASSERT_CHEAP_m(cond, msg) \
+    ERR_ASSERT_LEVEL_CHECK_m(::foundation::core::AssertLevel::cheap, cond, msg)
+
+/** @brief Throws AssertionError if cond is false, in builds with expensive checks */
+#define ERR_ASSERT_EXPENSIVE_m(cond, msg) \
+    ERR_ASSERT_LEVEL_CHECK_m(::foundation::core::AssertLevel::expensive, cond, msg)
+
+}  // namespace core
+}  // namespace foundation
 
-#endif
\ No newline at end of file
+#endif  // ASSERTIONS_HPP_
@@ -0,0 +1,124 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <libfoundation/core/assertions.hpp>
+#include <libfoundation/heaps/heaps.hpp>
+#include <libfoundation/rbtree/rbtree.hpp>
+#include <libfoundation/sorting/sorting.hpp>
+
+#include <gtest/gtest.h>
+
+namespace foundation {
+namespace core {
+
+TEST(AssertionsTests, throws)
+{
+    int num_evaluated{0};
+    auto check = [&](int value)
+    {
+        ++num_evaluated;
+        return value > 0;
+    };
+    ERR_ASSERT_THROW_RANGE_m(check(1), "not thrown");
+    ASSERT_EQ(num_evaluated, 1);
+
+    try
+    {
+        ERR_ASSERT_THROW_RANGE_m(check(0), "value " + std::to_string(0));
+        FAIL();
+    }
+    catch (const std::out_of_range& error)
+    {
+        std::string what = error.what();
+        ASSERT_NE(what.find("assertions.tests.cpp:"), std::string::npos);
+        ASSERT_NE(what.find("Message: value 0"), std::string::npos);
+    }
+    ASSERT_EQ(num_evaluated, 2);
+
+    // a single statement, safe as the body of an if without braces
+    if (num_evaluated == 0)
+        ERR_ASSERT_THROW_INVARG_m(false, "not reached");
+    else
+        ++num_evaluated;
+    ASSERT_EQ(num_evaluated, 3);
+}
+
+TEST(AssertionsTests, levels)
+{
+    int num_evaluated{0};
+    auto fails = [&]
+    {
+        ++num_evaluated;
+        return false;
+    };
+
+    if constexpr (checks(AssertLevel::cheap))
+    {
+        try
+        {
+            ERR_ASSERT_CHEAP_m(fails(), "cheap");
+            FAIL();
+        }
+        catch (const AssertionError& error)
+        {
+            ASSERT_NE(std::string(error.what()).find("Check failed: fails()"), std::string::npos);
+        }
+        ASSERT_EQ(num_evaluated, 1);
+    }
+    else
+    {
+        // compiled out, the condition is not even evaluated
+        ERR_ASSERT_CHEAP_m(fails(), "cheap");
+        ASSERT_EQ(num_evaluated, 0);
+    }
+
+    num_evaluated = 0;
+    if constexpr (checks(AssertLevel::expensive))
+    {
+        ASSERT_THROW(ERR_ASSERT_EXPENSIVE_m(fails(), "expensive"), AssertionError);
+        ASSERT_EQ(num_evaluated, 1);
+    }
+    else
+    {
+        ERR_ASSERT_EXPENSIVE_m(fails(), "expensive");
+        ASSERT_EQ(num_evaluated, 0);
+    }
+}
+
+TEST(AssertionsTests, invariants)
+{
+    // pushHeap on a range whose prefix is not a heap breaks the heap property
+    std::vector<int> values{1, 5, 3};
+    if constexpr (checks(AssertLevel::expensive))
+        ASSERT_THROW(heaps::pushHeap(values.begin(), values.end()), AssertionError);
+    else
+        heaps::pushHeap(values.begin(), values.end());
+
+    // operations used correctly pass their checks at every level
+    values = {9, 4, 7, 1, 8, 2, 6, 3, 5, 0};
+    heaps::makeHeap(values.begin(), values.end());
+    for (auto end = values.end(); end != values.begin(); --end)
+        heaps::popHeap(values.begin(), end);
+    ASSERT_TRUE(std::is_sorted(values.begin(), values.end()));
+    std::reverse(values.begin(), values.end());
+    sorting::quickSort(values.begin(), values.end());
+    ASSERT_TRUE(std::is_sorted(values.begin(), values.end()));
+
+    rbree::RBtree<int> tree;
+    for (int value : values)
+        tree.insert(value * 7 % 10);
+    tree.erase(3);
+    auto greater = tree.split(5);
+    tree.join(greater);
+    ASSERT_EQ(tree.size(), 9);
+    ASSERT_TRUE(tree.isValid());
+}
+
+}
+}
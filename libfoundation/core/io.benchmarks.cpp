@@ -0,0 +1,235 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include "libfoundation/core/io.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+namespace core = foundation::core;
+
+/* doc
+Documents of state.range(0) records shaped like serialized tree nodes,
+written once to a temporary file which stays in the page cache.
+*/
+static std::string writeDocument(std::int64_t n)
+{
+    core::Json json;
+    for (std::int64_t i = 1; i <= n; ++i)
+    {
+        json[core::format("{}", i)] = {{"data", i * 7919 % 1000003}, {"uid", i % 3 ? i : -i},
+                                       {"p", i / 2}, {"l", 2 * i}, {"r", 2 * i + 1}};
+    }
+    auto path = (std::filesystem::temp_directory_path() / "foundation-io-bench.json").string();
+    core::saveJson(json, path);
+    return path;
+}
+
+template <typename Load>
+static void loads(benchmark::State& state, Load load)
+{
+    auto path = writeDocument(state.range(0));
+    auto bytes = std::filesystem::file_size(path);
+    for (auto _ : state)
+    {
+        core::Json json = load(path);
+        benchmark::DoNotOptimize(json.size());
+    }
+    std::filesystem::remove(path);
+    state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+/* doc
+Parsing from a ``std::ifstream`` through ``operator>>``, the previous
+implementation of ``loadJson``.
+*/
+static void BMloadStream(benchmark::State& state)
+{
+    loads(state, [](const std::string& path)
+    {
+        std::ifstream stream(path);
+        core::Json json;
+        stream >> json;
+        return json;
+    });
+}
+BENCHMARK(BMloadStream)->RangeMultiplier(8)->Range(1 << 8, 1 << 17)->Unit(benchmark::kMillisecond);
+
+/* doc
+Parsing in place from the mapped file with ``loadJson``, and from a reused
+read buffer with ``JsonReader``.
+*/
+static void BMloadMapped(benchmark::State& state)
+{
+    loads(state, [](const std::string& path) {return core::loadJson(path);});
+}
+BENCHMARK(BMloadMapped)->RangeMultiplier(8)->Range(1 << 8, 1 << 17)->Unit(benchmark::kMillisecond);
+
+static void BMloadReader(benchmark::State& state)
+{
+    core::JsonReader reader;
+    loads(state, [&](const std::string& path) {return reader.load(path);});
+}
+BENCHMARK(BMloadReader)->RangeMultiplier(8)->Range(1 << 8, 1 << 17)->Unit(benchmark::kMillisecond);
+
+/* doc
+Encoding and decoding the same document in each format, state.range(1)
+indexing ``core::Format``.  The counter ``bytes`` is the encoded size.
+*/
+static void BMencode(benchmark::State& state)
+{
+    auto path = writeDocument(state.range(0));
+    core::Json json = core::loadJson(path);
+    std::filesystem::remove(path);
+    auto format = static_cast<core::Format>(state.range(1));
+
+    std::size_t bytes{0};
+    for (auto _ : state)
+    {
+        auto encoded = core::encode(json, format);
+        bytes = encoded.size();
+        benchmark::DoNotOptimize(encoded.data());
+    }
+    state.counters["bytes"] = bytes;
+    state.SetBytesProcessed(state.iterations() * bytes);
+}
+BENCHMARK(BMencode)
+    ->ArgsProduct({{1 << 12, 1 << 16}, {0, 1, 2, 3}})
+    ->ArgNames({"n", "format"})
+    ->Unit(benchmark::kMillisecond);
+
+static void BMdecode(benchmark::State& state)
+{
+    auto path = writeDocument(state.range(0));
+    auto encoded = core::encode(core::loadJson(path), static_cast<core::Format>(state.range(1)));
+    std::filesystem::remove(path);
+    auto bytes = std::as_bytes(std::span(encoded));
+    auto format = static_cast<core::Format>(state.range(1));
+
+    for (auto _ : state)
+    {
+        core::Json json = core::decode(bytes, format);
+        benchmark::DoNotOptimize(json.size());
+    }
+    state.counters["bytes"] = encoded.size();
+    state.SetBytesProcessed(state.iterations() * encoded.size());
+}
+BENCHMARK(BMdecode)
+    ->ArgsProduct({{1 << 12, 1 << 16}, {0, 1, 2, 3}})
+    ->ArgNames({"n", "format"})
+    ->Unit(benchmark::kMillisecond);
+
+/* doc
+The time a caller spends checkpointing a document of state.range(0)
+records: encoding and writing it with ``save``, against copying it into
+``AsyncWriter::save``, which encodes and writes on its own thread.  Saves
+arriving faster than the disk takes them replace each other.
+*/
+static void BMsaveSync(benchmark::State& state)
+{
+    auto path = writeDocument(state.range(0));
+    core::Json json = core::loadJson(path);
+    for (auto _ : state)
+        core::save(json, path);
+    std::filesystem::remove(path);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BMsaveSync)->RangeMultiplier(8)->Range(1 << 10, 1 << 16)->Unit(benchmark::kMillisecond);
+
+static void BMsaveAsync(benchmark::State& state)
+{
+    auto path = writeDocument(state.range(0));
+    core::Json json = core::loadJson(path);
+    core::AsyncWriter writer;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(writer.save(json, path));
+    writer.wait();
+    state.counters["replaced"] = writer.numReplaced();
+    std::filesystem::remove(path);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BMsaveAsync)->RangeMultiplier(8)->Range(1 << 10, 1 << 16)->Unit(benchmark::kMillisecond);
+
+/* doc
+Records of state.range(0) written as JSON Lines, and as one array holding
+the same records.
+*/
+static std::string writeRecords(std::int64_t n, bool lines)
+{
+    auto path = (std::filesystem::temp_directory_path() / "foundation-io-bench.jsonl").string();
+    core::Json array = core::Json::array();
+    core::NdjsonWriter writer(path);
+    for (std::int64_t i = 0; i < n; ++i)
+    {
+        core::Json record = {{"id", i}, {"name", core::format("record-{}", i * 7919 % 1000003)},
+                             {"tags", {"a", "b"}}, {"score", i * 0.25}};
+        if (lines)
+            writer.append(record);
+        else
+            array.push_back(std::move(record));
+    }
+    writer.close();
+    if (!lines)
+        core::saveJson(array, path);
+    return path;
+}
+
+/* doc
+Handing every record to a callback with ``NdjsonReader``, state.range(1)
+threads parsing each block, against loading the array with ``loadJson``,
+which holds every record at once.
+*/
+static void BMreadNdjson(benchmark::State& state)
+{
+    auto path = writeRecords(state.range(0), true);
+    auto bytes = std::filesystem::file_size(path);
+    core::NdjsonReader reader(core::NdjsonReader::DEFAULT_BLOCK_SIZE, state.range(1));
+    for (auto _ : state)
+    {
+        std::int64_t sum{0};
+        reader.read(path, [&](core::Json& record) {sum += record["id"].get<std::int64_t>();});
+        benchmark::DoNotOptimize(sum);
+    }
+    std::filesystem::remove(path);
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BMreadNdjson)
+    ->ArgsProduct({{1 << 14, 1 << 18}, {1, 2, 4}})
+    ->ArgNames({"n", "threads"})
+    ->Unit(benchmark::kMillisecond);
+
+static void BMloadArray(benchmark::State& state)
+{
+    auto path = writeRecords(state.range(0), false);
+    auto bytes = std::filesystem::file_size(path);
+    for (auto _ : state)
+    {
+        std::int64_t sum{0};
+        for (const core::Json& record : core::loadJson(path))
+            sum += record["id"].get<std::int64_t>();
+        benchmark::DoNotOptimize(sum);
+    }
+    std::filesystem::remove(path);
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BMloadArray)->Arg(1 << 14)->Arg(1 << 18)->Unit(benchmark::kMillisecond);
+
+/* doc
+Writing the records with ``NdjsonWriter``.
+*/
+static void BMwriteNdjson(benchmark::State& state)
+{
+    for (auto _ : state)
+        std::filesystem::remove(writeRecords(state.range(0), true));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BMwriteNdjson)->Arg(1 << 14)->Arg(1 << 18)->Unit(benchmark::kMillisecond);
@@ -4,18 +4,577 @@
 // ------------------------------------------------------
 
 #include <libfoundation/core/io.hpp>
+#include <libfoundation/core/assertions.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
 #include <fstream>
+#include <iterator>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FOUNDATION_HAS_MMAP 1
+#endif
 
 namespace foundation {
 namespace core {
 
+MappedFile::MappedFile(const std::string& filename) {
+#ifdef FOUNDATION_HAS_MMAP
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    ERR_ASSERT_THROW_m(fd >= 0, std::runtime_error, "cannot open " + filename);
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        ERR_ASSERT_THROW_m(false, std::runtime_error, "cannot stat " + filename);
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    // an empty file cannot be mapped and has nothing to map
+    if (size_ > 0) {
+        void* data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        ERR_ASSERT_THROW_m(data != MAP_FAILED, std::runtime_error, "cannot map " + filename);
+        ::madvise(data, size_, MADV_SEQUENTIAL);
+        data_   = static_cast<const std::byte*>(data);
+        mapped_ = true;
+    } else {
+        ::close(fd);
+    }
+#else
+    std::FILE* file = std::fopen(filename.c_str(), "rb");
+    ERR_ASSERT_THROW_m(file != nullptr, std::runtime_error, "cannot open " + filename);
+    std::fseek(file, 0, SEEK_END);
+    long file_size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    buffer_.resize(file_size > 0 ? file_size : 0);
+    std::size_t num_read = std::fread(buffer_.data(), 1, buffer_.size(), file);
+    std::fclose(file);
+    ERR_ASSERT_THROW_m(num_read == buffer_.size(), std::runtime_error, "cannot read " + filename);
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#endif
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_{std::exchange(other.data_, nullptr)},
+      size_{std::exchange(other.size_, 0)},
+      mapped_{std::exchange(other.mapped_, false)},
+      buffer_{std::move(other.buffer_)} {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        data_   = std::exchange(other.data_, nullptr);
+        size_   = std::exchange(other.size_, 0);
+        mapped_ = std::exchange(other.mapped_, false);
+        buffer_ = std::move(other.buffer_);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    unmap();
+}
+
+void MappedFile::unmap() {
+#ifdef FOUNDATION_HAS_MMAP
+    if (mapped_) {
+        ::munmap(const_cast<std::byte*>(data_), size_);
+    }
+#endif
+    data_   = nullptr;
+    size_   = 0;
+    mapped_ = false;
+    buffer_.clear();
+}
+
+Json parseJson(std::string_view text, const std::string& name) {
+    try {
+        return Json::parse(text.data(), text.data() + text.size());
+    } catch (const Json::parse_error& ex) {
+        throw std::runtime_error(format("cannot parse {} at byte {}: {}", name, ex.byte, ex.what()));
+    }
+}
+
 Json loadJson(const std::string& filename) {
-    // create filestream
-    std::ifstream file_stream(filename);
-    // stream into json object
-    Json json_obj;
-    file_stream >> json_obj;    
-    return json_obj;
+    MappedFile file(filename);
+    return parseJson(file.text(), filename);
+}
+
+Json JsonReader::load(const std::string& filename) {
+    std::FILE* file = std::fopen(filename.c_str(), "rb");
+    ERR_ASSERT_THROW_m(file != nullptr, std::runtime_error, "cannot open " + filename);
+    std::fseek(file, 0, SEEK_END);
+    long file_size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    buffer_.resize(file_size > 0 ? file_size : 0);
+    std::size_t num_read = std::fread(buffer_.data(), 1, buffer_.size(), file);
+    std::fclose(file);
+    ERR_ASSERT_THROW_m(num_read == buffer_.size(), std::runtime_error, "cannot read " + filename);
+    return parseJson({buffer_.data(), buffer_.size()}, filename);
+}
+
+namespace {
+
+/* CBOR tag 55799, "self-described CBOR" */
+constexpr std::uint8_t CBOR_MAGIC[3] = {0xd9, 0xd9, 0xf7};
+
+/* MessagePack and BSON have no magic of their own; 0xc1 is never used by
+   MessagePack and cannot start JSON text or self-described CBOR */
+constexpr std::uint8_t MSGPACK_MAGIC[4] = {0xc1, 'F', 'M', 'P'};
+constexpr std::uint8_t BSON_MAGIC[4]    = {0xc1, 'F', 'B', 'S'};
+
+const std::uint8_t* u8(std::span<const std::byte> bytes) {
+    return reinterpret_cast<const std::uint8_t*>(bytes.data());
+}
+
+template <std::size_t N>
+bool startsWith(std::span<const std::byte> bytes, const std::uint8_t (&magic)[N]) {
+    return bytes.size() >= N && std::equal(magic, magic + N, u8(bytes));
+}
+
+}  // namespace
+
+namespace {
+
+/* appends what an ostream writes to a byte vector */
+class AppendBuffer : public std::streambuf {
+ public:
+    explicit AppendBuffer(std::vector<std::uint8_t>& out) : out_{out} {}
+
+ protected:
+    int_type overflow(int_type c) override {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            out_.push_back(static_cast<std::uint8_t>(c));
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        out_.insert(out_.end(), s, s + n);
+        return n;
+    }
+
+ private:
+    std::vector<std::uint8_t>& out_;
+};
+
+}  // namespace
+
+void encode(const Json& json, Format format, std::vector<std::uint8_t>& out) {
+    std::size_t size = out.size();
+    try {
+        switch (format) {
+            case Format::json: {
+                AppendBuffer buffer(out);
+                std::ostream stream(&buffer);
+                stream << json;
+                break;
+            }
+            case Format::cbor:
+                out.insert(out.end(), std::begin(CBOR_MAGIC), std::end(CBOR_MAGIC));
+                Json::to_cbor(json, out);
+                break;
+            case Format::msgpack:
+                out.insert(out.end(), std::begin(MSGPACK_MAGIC), std::end(MSGPACK_MAGIC));
+                Json::to_msgpack(json, out);
+                break;
+            case Format::bson:
+                out.insert(out.end(), std::begin(BSON_MAGIC), std::end(BSON_MAGIC));
+                Json::to_bson(json, out);
+                break;
+        }
+    } catch (const Json::exception& ex) {
+        // out is left as it was, without the magic
+        out.resize(size);
+        throw std::invalid_argument(fmt::format("cannot encode: {}", ex.what()));
+    }
+}
+
+std::vector<std::uint8_t> encode(const Json& json, Format format) {
+    std::vector<std::uint8_t> out;
+    encode(json, format, out);
+    return out;
+}
+
+Json decode(std::span<const std::byte> bytes, Format format, const std::string& name) {
+    const std::uint8_t* first = u8(bytes);
+    const std::uint8_t* last  = first + bytes.size();
+    try {
+        switch (format) {
+            case Format::json:
+                return parseJson({reinterpret_cast<const char*>(first), bytes.size()}, name);
+            case Format::cbor:
+                return Json::from_cbor(first, last, true, true, Json::cbor_tag_handler_t::ignore);
+            case Format::msgpack:
+                return Json::from_msgpack(first + (startsWith(bytes, MSGPACK_MAGIC) ? sizeof(MSGPACK_MAGIC) : 0),
+                                          last);
+            case Format::bson:
+                return Json::from_bson(first + (startsWith(bytes, BSON_MAGIC) ? sizeof(BSON_MAGIC) : 0), last);
+        }
+    } catch (const Json::exception& ex) {
+        throw std::runtime_error(fmt::format("cannot decode {}: {}", name, ex.what()));
+    }
+    return {};
+}
+
+Format detectFormat(std::span<const std::byte> bytes) {
+    const std::uint8_t* data = u8(bytes);
+    std::size_t         size = bytes.size();
+
+    if (startsWith(bytes, CBOR_MAGIC)) {
+        return Format::cbor;
+    }
+    if (startsWith(bytes, MSGPACK_MAGIC)) {
+        return Format::msgpack;
+    }
+    if (startsWith(bytes, BSON_MAGIC)) {
+        return Format::bson;
+    }
+    // untagged BSON and MessagePack from other writers
+    if (size >= 5) {
+        std::uint32_t length = data[0] | data[1] << 8 | data[2] << 16 | std::uint32_t{data[3]} << 24;
+        if (length == size && data[size - 1] == 0) {
+            return Format::bson;
+        }
+    }
+    std::size_t pos = 0;
+    while (pos < size && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\n' || data[pos] == '\r')) {
+        ++pos;
+    }
+    if (pos < size) {
+        std::uint8_t c = data[pos];
+        if (c == '{' || c == '[' || c == '"' || c == '-' || (c >= '0' && c <= '9') || c == 't' ||
+            c == 'f' || c == 'n') {
+            return Format::json;
+        }
+    }
+    if (size > 0 && ((data[0] >= 0x80 && data[0] <= 0x9f) || (data[0] >= 0xdc && data[0] <= 0xdf))) {
+        return Format::msgpack;
+    }
+    throw std::runtime_error("unknown encoding");
+}
+
+namespace {
+
+void writeBytes(const std::vector<std::uint8_t>& bytes, const std::string& filename, bool sync) {
+    std::FILE* file = std::fopen(filename.c_str(), "wb");
+    ERR_ASSERT_THROW_m(file != nullptr, std::runtime_error, "cannot create " + filename);
+    std::size_t num_written = std::fwrite(bytes.data(), 1, bytes.size(), file);
+    bool flushed = std::fflush(file) == 0;
+#ifdef FOUNDATION_HAS_MMAP
+    if (sync && flushed) {
+        flushed = ::fsync(::fileno(file)) == 0;
+    }
+#endif
+    int status = std::fclose(file);
+    ERR_ASSERT_THROW_m(num_written == bytes.size() && flushed && status == 0, std::runtime_error,
+                       "cannot write " + filename);
+}
+
+}  // namespace
+
+void save(const Json& json, const std::string& filename, Format format) {
+    writeBytes(encode(json, format), filename, false);
+}
+
+Json load(const std::string& filename) {
+    MappedFile file(filename);
+    Format format;
+    try {
+        format = detectFormat(file.bytes());
+    } catch (const std::runtime_error&) {
+        throw std::runtime_error("unknown encoding of " + filename);
+    }
+    return decode(file.bytes(), format, filename);
+}
+
+AsyncWriter::AsyncWriter() : thread_{[this] { run(); }} {}
+
+AsyncWriter::~AsyncWriter() {
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+std::future<void> AsyncWriter::save(Json json, const std::string& filename, Format format) {
+    std::promise<void> promise;
+    std::future<void>  out = promise.get_future();
+    {
+        std::lock_guard lock(mutex_);
+        auto it = std::find_if(pending_.begin(), pending_.end(),
+                               [&](const Request& request) { return request.filename_ == filename; });
+        if (it != pending_.end()) {
+            it->json_   = std::move(json);
+            it->format_ = format;
+            it->promises_.push_back(std::move(promise));
+            ++num_replaced_;
+            return out;
+        }
+        std::vector<std::promise<void>> promises;
+        promises.push_back(std::move(promise));
+        pending_.push_back({std::move(json), filename, format, std::move(promises)});
+    }
+    wake_.notify_one();
+    return out;
+}
+
+void AsyncWriter::wait() {
+    std::unique_lock lock(mutex_);
+    idle_.wait(lock, [this] { return pending_.empty() && !busy_; });
+}
+
+std::size_t AsyncWriter::numReplaced() const {
+    std::lock_guard lock(mutex_);
+    return num_replaced_;
+}
+
+void AsyncWriter::run() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+        if (pending_.empty()) {
+            return;
+        }
+        Request request = std::move(pending_.front());
+        pending_.pop_front();
+        busy_ = true;
+        lock.unlock();
+
+        std::exception_ptr error;
+        try {
+            write(request);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        request.json_ = Json();
+        for (auto& promise : request.promises_) {
+            if (error) {
+                promise.set_exception(error);
+            } else {
+                promise.set_value();
+            }
+        }
+
+        lock.lock();
+        busy_ = false;
+        if (pending_.empty()) {
+            idle_.notify_all();
+        }
+    }
+}
+
+void AsyncWriter::write(const Request& request) {
+    buffer_.clear();
+    encode(request.json_, request.format_, buffer_);
+
+    // the temporary file is in the same directory, a rename cannot cross file systems
+    std::string tmp = request.filename_ + ".tmp";
+    writeBytes(buffer_, tmp, true);
+    std::error_code ec;
+    std::filesystem::rename(tmp, request.filename_, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+        ERR_ASSERT_THROW_m(false, std::runtime_error, "cannot replace " + request.filename_);
+    }
+}
+
+std::future<void> saveJsonAsync(Json json, const std::string& filename, Format format) {
+    static AsyncWriter writer;
+    return writer.save(std::move(json), filename, format);
+}
+
+namespace {
+
+/* parses the lines of text, the first numbered first_line, and returns the number of lines */
+std::size_t parseLines(std::string_view text, std::size_t first_line, const std::string& name,
+                       const std::function<void(Json&)>& callback) {
+    std::size_t num_lines = 0;
+    std::size_t pos       = 0;
+    while (pos < text.size()) {
+        std::size_t eol = std::min(text.find('\n', pos), text.size());
+        std::string_view line = text.substr(pos, eol - pos);
+        if (line.find_first_not_of(" \t\r") != std::string_view::npos) {
+            Json record;
+            try {
+                record = Json::parse(line.data(), line.data() + line.size());
+            } catch (const Json::parse_error& ex) {
+                throw std::runtime_error(
+                    format("cannot parse {} line {}: {}", name, first_line + num_lines, ex.what()));
+            }
+            callback(record);
+        }
+        ++num_lines;
+        pos = eol + 1;
+    }
+    return num_lines;
+}
+
+/* the records of a chunk parsed on a worker thread, up to the first bad one */
+struct ParsedChunk {
+    std::vector<Json>  records_;
+    std::exception_ptr error_;
+};
+
+ParsedChunk parseChunk(std::string_view text, std::size_t first_line, const std::string& name) {
+    ParsedChunk out;
+    try {
+        parseLines(text, first_line, name, [&](Json& record) { out.records_.push_back(std::move(record)); });
+    } catch (...) {
+        out.error_ = std::current_exception();
+    }
+    return out;
+}
+
+/* chunks smaller than this are not worth a thread */
+constexpr std::size_t MIN_CHUNK_SIZE = std::size_t{1} << 16;
+
+}  // namespace
+
+NdjsonReader::NdjsonReader(std::size_t block_size, unsigned num_threads)
+    : block_size_{std::max<std::size_t>(block_size, 1)}, num_threads_{std::max(num_threads, 1u)} {}
+
+std::size_t NdjsonReader::read(const std::string& filename, const Callback& callback) {
+    std::FILE* file = std::fopen(filename.c_str(), "rb");
+    ERR_ASSERT_THROW_m(file != nullptr, std::runtime_error, "cannot open " + filename);
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> closer(file, &std::fclose);
+    return read(
+        [&](char* data, std::size_t size) {
+            std::size_t num_read = std::fread(data, 1, size, file);
+            ERR_ASSERT_THROW_m(num_read == size || !std::ferror(file), std::runtime_error,
+                               "cannot read " + filename);
+            return num_read;
+        },
+        callback, filename);
+}
+
+std::size_t NdjsonReader::read(std::istream& stream, const Callback& callback, const std::string& name) {
+    return read(
+        [&](char* data, std::size_t size) {
+            stream.read(data, static_cast<std::streamsize>(size));
+            ERR_ASSERT_THROW_m(!stream.bad(), std::runtime_error, "cannot read " + name);
+            return static_cast<std::size_t>(stream.gcount());
+        },
+        callback, name);
+}
+
+std::size_t NdjsonReader::read(const Source& source, const Callback& callback, const std::string& name) {
+    std::vector<char>* block = &blocks_[0];
+    std::vector<char>* next  = &blocks_[1];
+
+    // appends up to count bytes to buffer and tells whether the input ended
+    auto fill = [&](std::vector<char>& buffer, std::size_t count) {
+        std::size_t size = buffer.size();
+        buffer.resize(size + count);
+        std::size_t num_read = source(buffer.data() + size, count);
+        buffer.resize(size + num_read);
+        return num_read < count;
+    };
+
+    std::size_t num_records = 0;
+    std::size_t line        = 1;
+    block->clear();
+    bool eof = fill(*block, block_size_);
+    while (!block->empty()) {
+        std::string_view text(block->data(), block->size());
+        std::size_t end = eof ? text.size() : text.rfind('\n') + 1;
+        if (end == 0) {
+            // a record longer than the block, which doubles so that it is scanned a few times only
+            eof = fill(*block, block->size());
+            continue;
+        }
+        text = text.substr(0, end);
+
+        std::vector<std::future<ParsedChunk>> chunks;
+        if (num_threads_ > 1 && text.size() >= 2 * MIN_CHUNK_SIZE) {
+            std::size_t chunk_size = std::max(text.size() / num_threads_, MIN_CHUNK_SIZE);
+            std::size_t first_line = line;
+            for (std::size_t pos = 0; pos < text.size();) {
+                std::size_t cut = pos + chunk_size < text.size() ? text.find('\n', pos + chunk_size) : text.npos;
+                cut = std::min(cut, text.size() - 1) + 1;
+                std::string_view chunk = text.substr(pos, cut - pos);
+                chunks.push_back(std::async(std::launch::async, parseChunk, chunk, first_line, std::cref(name)));
+                first_line += std::count(chunk.begin(), chunk.end(), '\n');
+                pos = cut;
+            }
+        } else {
+            line += parseLines(text, line, name, [&](Json& record) {
+                ++num_records;
+                callback(record);
+            });
+        }
+
+        // the partial record and the next block, read while the chunks are parsed
+        next->assign(block->begin() + end, block->end());
+        bool next_eof = eof || fill(*next, block_size_);
+
+        for (auto& chunk : chunks) {
+            ParsedChunk parsed = chunk.get();
+            for (Json& record : parsed.records_) {
+                ++num_records;
+                callback(record);
+            }
+            if (parsed.error_) {
+                std::rethrow_exception(parsed.error_);
+            }
+        }
+        if (!chunks.empty()) {
+            line += std::count(text.begin(), text.end(), '\n');
+        }
+        std::swap(block, next);
+        eof = next_eof;
+    }
+    return num_records;
+}
+
+NdjsonWriter::NdjsonWriter(const std::string& filename, std::size_t buffer_size)
+    : filename_{filename}, buffer_size_{buffer_size} {
+    file_ = std::fopen(filename.c_str(), "wb");
+    ERR_ASSERT_THROW_m(file_ != nullptr, std::runtime_error, "cannot create " + filename);
+    buffer_.reserve(buffer_size_ + buffer_size_ / 4);
+}
+
+NdjsonWriter::~NdjsonWriter() {
+    if (file_) {
+        std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+        std::fclose(file_);
+    }
+}
+
+void NdjsonWriter::append(const Json& record) {
+    // compact Json has no raw line breaks, they are escaped in strings
+    encode(record, Format::json, buffer_);
+    buffer_.push_back('\n');
+    ++size_;
+    if (buffer_.size() >= buffer_size_) {
+        flush();
+    }
+}
+
+void NdjsonWriter::flush() {
+    std::size_t num_written = std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+    ERR_ASSERT_THROW_m(num_written == buffer_.size(), std::runtime_error, "cannot write " + filename_);
+    buffer_.clear();
+}
+
+void NdjsonWriter::close() {
+    flush();
+    int status = std::fclose(file_);
+    file_      = nullptr;
+    ERR_ASSERT_THROW_m(status == 0, std::runtime_error, "cannot write " + filename_);
 }
 
 void saveJson(const Json& json, const std::string& filename) {
@@ -24,4 +583,4 @@ void saveJson(const Json& json, const std::string& filename) {
 }
 
 }  // namespace io
-}  // namespace libhedral
\ No newline at end of file
+}  // namespace libhedral
@@ -9,7 +9,22 @@
 #include <nlohmann/json.hpp>
 #include <fmt/core.h>
 #include <fmt/format.h>
+#include <concepts>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <future>
+#include <istream>
+#include <memory_resource>
+#include <mutex>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 namespace foundation {
 namespace core {
@@ -17,12 +32,89 @@ namespace core {
 using Json = nlohmann::json;
 using namespace fmt;
 
+/** @brief A read-only view of the contents of a whole file.
+
+    The file is memory-mapped where the platform supports it, so opening it
+    costs a few system calls and pages are read as they are touched. Elsewhere
+    it is read into a buffer with a single read.
+*/
+class MappedFile
+{
+ public:
+    MappedFile() = default;
+
+    /** @brief Maps the file
+        @param filename The name of the file
+        @throw std::runtime_error if the file cannot be opened or mapped
+    */
+    explicit MappedFile(const std::string& filename);
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    /** @brief The contents, page aligned when mapped */
+    std::span<const std::byte> bytes() const { return {data_, size_}; }
+
+    std::string_view text() const
+    {
+        return {reinterpret_cast<const char*>(data_), size_};
+    }
+
+    std::size_t size() const { return size_; }
+
+ private:
+    void unmap();
+
+    const std::byte*       data_{nullptr};
+    std::size_t            size_{0};
+    bool                   mapped_{false};
+    std::vector<std::byte> buffer_;
+};
+
+/** @brief Parses Json text
+    @param text The text to parse
+    @param name The name of the source, for error messages
+    @throw std::runtime_error with the name and byte offset of a syntax error
+*/
+Json parseJson(std::string_view text, const std::string& name = "<text>");
+
 /** @brief Reads Json from file
     @param filename The name of the file
     @return A Json object with contents of file.
+    @throw std::runtime_error if the file cannot be read or is not valid Json
+
+    The file is mapped and parsed in place, without going through a stream.
 */
 Json loadJson(const std::string& filename);
 
+/** @brief Loads Json files through one reusable read buffer.
+
+    Each file is read with a single read into the buffer, which keeps its
+    capacity between loads and is allocated from the given memory resource.
+    Prefer it to loadJson() for many small files, where mapping and unmapping
+    cost more than the copy.
+*/
+class JsonReader
+{
+ public:
+    explicit JsonReader(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : buffer_{resource}
+    {
+    }
+
+    /** @brief Reads Json from file, see loadJson() */
+    Json load(const std::string& filename);
+
+    /** @brief Capacity of the read buffer in bytes */
+    std::size_t capacity() const { return buffer_.capacity(); }
+
+ private:
+    std::pmr::vector<char> buffer_;
+};
+
 /** @brief Writes Json object to file.
     @param json A Json object to save.
     @param filename Name of the file to which to write.
@@ -30,21 +122,267 @@ Json loadJson(const std::string& filename);
 void saveJson(const Json& json, const std::string& filename);
 
 
+/** @brief Encodings understood by save() and load()
+
+    The binary encodings are nlohmann's codecs. Every binary encoding starts
+    with a magic which load() uses to recognize it: CBOR the self-describing
+    tag 55799, MessagePack and BSON, which have none of their own, the bytes
+    c1 'F' 'M' 'P' and c1 'F' 'B' 'S'. 0xc1 is never used by MessagePack, so
+    decode() accepts MessagePack and BSON with or without the magic.
+*/
+enum class Format
+{
+    json,
+    cbor,
+    msgpack,
+    bson
+};
+
+/** @brief Encodes Json
+    @param json The value to encode, BSON only encodes objects
+    @param format The encoding
+    @return The encoded bytes
+    @throw std::invalid_argument if the value cannot be encoded in format
+*/
+std::vector<std::uint8_t> encode(const Json& json, Format format);
+
+/** @brief Encodes Json, appending to a buffer whose capacity is reused
+    @param json The value to encode, BSON only encodes objects
+    @param format The encoding
+    @param out The buffer to append to
+*/
+void encode(const Json& json, Format format, std::vector<std::uint8_t>& out);
+
+/** @brief Decodes Json
+    @param bytes The encoded bytes
+    @param format The encoding
+    @param name The name of the source, for error messages
+    @throw std::runtime_error if the bytes are not valid in format
+*/
+Json decode(std::span<const std::byte> bytes, Format format, const std::string& name = "<bytes>");
+
+/** @brief Guesses the encoding of bytes from their first bytes
+
+    Bytes written by encode() are recognized by their magic, see Format.
+    Otherwise JSON is recognized by its first non-blank character, and
+    untagged BSON by its length prefix matching the number of bytes and
+    MessagePack by a leading map or array marker, none of which is valid at
+    the start of JSON text.
+
+    @throw std::runtime_error if the bytes match none of the formats
+*/
+Format detectFormat(std::span<const std::byte> bytes);
+
+/** @brief Writes Json to file in the given encoding
+    @param json A Json object to save.
+    @param filename Name of the file to which to write.
+    @param format The encoding
+*/
+void save(const Json& json, const std::string& filename, Format format = Format::json);
+
+/** @brief Reads Json from file in any encoding save() writes
+    @param filename The name of the file
+    @throw std::runtime_error if the file cannot be read or decoded
+*/
+Json load(const std::string& filename);
+
+/** @brief Writes Json files on a background thread.
+
+    save() only moves the value into a queue and returns a future, the value is
+    encoded into a reused buffer and written by the writer's thread. A file is
+    written to a temporary file next to it first, flushed to disk and then
+    renamed over the target, so readers see either the old or the new file,
+    never a partial one.
+
+    While a save is being written, newer saves wait; a newer save to the same
+    file replaces a waiting one, so a writer falling behind checkpoints skips
+    the stale ones. The futures of replaced saves complete together with the
+    save which replaced them. The destructor writes what is waiting and stops
+    the thread.
+*/
+class AsyncWriter
+{
+ public:
+    AsyncWriter();
+    AsyncWriter(const AsyncWriter&)            = delete;
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+    ~AsyncWriter();
+
+    /** @brief Queues json to be written to filename
+        @return A future which completes once the file, or a newer save
+                replacing it, is written, and holds the exception if that
+                failed
+    */
+    std::future<void> save(Json json, const std::string& filename, Format format = Format::json);
+
+    /** @brief Blocks until every queued save is written */
+    void wait();
+
+    /** @brief Number of saves dropped because a newer one replaced them */
+    std::size_t numReplaced() const;
+
+ private:
+    struct Request
+    {
+        Json                            json_;
+        std::string                     filename_;
+        Format                          format_;
+        std::vector<std::promise<void>> promises_;
+    };
+
+    void run();
+    void write(const Request& request);
+
+    mutable std::mutex      mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::deque<Request>     pending_;
+    bool                    busy_{false};
+    bool                    stop_{false};
+    std::size_t             num_replaced_{0};
+    std::vector<std::uint8_t> buffer_;
+    std::thread             thread_;
+};
+
+/** @brief Writes Json to file on a shared background writer, see AsyncWriter
+    @param json The value to save, moved or copied by the caller
+    @param filename Name of the file to which to write.
+    @param format The encoding
+*/
+std::future<void> saveJsonAsync(Json json, const std::string& filename, Format format = Format::json);
+
+/** @brief Reads newline-delimited Json (JSON Lines), one record per line.
+
+    The input is read in blocks of a fixed size and split at the last line
+    break of each block; the partial record after it is carried over into the
+    next block, and a block is grown only for a record longer than itself.
+    Records are handed to a callback on the calling thread in file order, so
+    the memory used stays flat however large the file is. Blank lines are
+    skipped.
+
+    With more than one thread, the records of a block are split at line breaks
+    into chunks parsed on worker threads while the next block is read. The
+    callback still sees the records in order and is never called concurrently.
+*/
+class NdjsonReader
+{
+ public:
+    using Callback = std::function<void(Json& record)>;
+
+    static constexpr std::size_t DEFAULT_BLOCK_SIZE = std::size_t{1} << 20;
+
+    /** @brief A reader
+        @param block_size The number of bytes read at a time
+        @param num_threads The number of threads parsing a block
+    */
+    explicit NdjsonReader(std::size_t block_size = DEFAULT_BLOCK_SIZE, unsigned num_threads = 1);
+
+    /** @brief Calls callback on each record of a file
+        @return The number of records
+        @throw std::runtime_error if the file cannot be read, or with the line
+               number of a record which is not valid Json, after the records
+               before it were handed over
+    */
+    std::size_t read(const std::string& filename, const Callback& callback);
+
+    /** @brief Calls callback on each record read from stream, see above */
+    std::size_t read(std::istream& stream, const Callback& callback, const std::string& name = "<stream>");
+
+ private:
+    using Source = std::function<std::size_t(char* data, std::size_t size)>;
+
+    std::size_t read(const Source& source, const Callback& callback, const std::string& name);
+
+    std::size_t       block_size_;
+    unsigned          num_threads_;
+    std::vector<char> blocks_[2];
+};
+
+/** @brief Writes newline-delimited Json, one record per line.
+
+    Records are encoded into a buffer which is written out whenever it grows
+    past the buffer size. The file is complete after close(); the destructor
+    closes it too but cannot report errors.
+*/
+class NdjsonWriter
+{
+ public:
+    /** @brief Creates or truncates the file
+        @throw std::runtime_error if the file cannot be created
+    */
+    explicit NdjsonWriter(const std::string& filename,
+                          std::size_t buffer_size = NdjsonReader::DEFAULT_BLOCK_SIZE);
+    NdjsonWriter(const NdjsonWriter&)            = delete;
+    NdjsonWriter& operator=(const NdjsonWriter&) = delete;
+    ~NdjsonWriter();
+
+    /** @brief Appends a record */
+    void append(const Json& record);
+
+    /** @brief Writes the buffered records and closes the file
+        @throw std::runtime_error if writing failed
+    */
+    void close();
+
+    /** @brief Number of records appended */
+    std::size_t size() const { return size_; }
+
+ private:
+    void flush();
+
+    std::FILE*                file_{nullptr};
+    std::string               filename_;
+    std::size_t               buffer_size_;
+    std::vector<std::uint8_t> buffer_;
+    std::size_t               size_{0};
+};
+
+/** @brief Types which write themselves to Json, either by returning it or by
+           filling in a Json object
+*/
 template <typename T>
 concept HasToJson = requires(const T& a, Json& json)
 {
     {a.toJson(json)} -> std::same_as<void>;
+} || requires(const T& a)
+{
+    {a.toJson()} -> std::convertible_to<Json>;
 };
 
+/** @brief Types which read themselves from Json */
 template <typename T>
 concept HasFromJson = requires(T& a, const Json& json)
 {
-    {a.toJson(json)} -> std::same_as<void>;
+    a.fromJson(json);
 };
 
+template <HasToJson T>
+Json toJson(const T& a)
+{
+    if constexpr (requires { {a.toJson()} -> std::convertible_to<Json>; }) {
+        return a.toJson();
+    } else {
+        Json json;
+        a.toJson(json);
+        return json;
+    }
+}
 
+/** @brief Writes an object to file in the given encoding */
+template <HasToJson T>
+void save(const T& a, const std::string& filename, Format format = Format::json)
+{
+    save(toJson(a), filename, format);
+}
+
+/** @brief Reads an object from file in any encoding save() writes */
+template <HasFromJson T>
+void load(T& a, const std::string& filename)
+{
+    a.fromJson(load(filename));
+}
 
 }  // namespace io
 }  // namespace foundation
 
-#endif  // IO_JSON_HPP_
\ No newline at end of file
+#endif  // IO_JSON_HPP_
@@ -0,0 +1,290 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <future>
+#include <memory_resource>
+#include <sstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <libfoundation/core/io.hpp>
+
+#include <gtest/gtest.h>
+
+namespace foundation {
+namespace core {
+
+static std::string ioPath(const std::string& name)
+{
+    return (std::filesystem::temp_directory_path() / ("foundation-io-" + name)).string();
+}
+
+static void writeText(const std::string& path, const std::string& text)
+{
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    std::fwrite(text.data(), 1, text.size(), file);
+    std::fclose(file);
+}
+
+static Json sample()
+{
+    Json json;
+    json["name"] = "tree";
+    json["values"] = {1, 2.5, "three", nullptr, true};
+    json["nested"]["deep"] = Json::array({Json::object({{"k", -7}})});
+    return json;
+}
+
+TEST(IoTests, loadJson)
+{
+    auto path = ioPath("load.json");
+    saveJson(sample(), path);
+    ASSERT_EQ(loadJson(path), sample());
+
+    MappedFile file(path);
+    ASSERT_EQ(file.text(), sample().dump());
+    MappedFile moved = std::move(file);
+    ASSERT_EQ(moved.size(), sample().dump().size());
+    ASSERT_EQ(file.size(), 0);
+    std::filesystem::remove(path);
+}
+
+TEST(IoTests, loadErrors)
+{
+    auto path = ioPath("errors.json");
+    ASSERT_THROW(loadJson(ioPath("missing.json")), std::runtime_error);
+
+    writeText(path, "");
+    ASSERT_THROW(loadJson(path), std::runtime_error);
+
+    writeText(path, sample().dump().substr(0, 20));
+    try
+    {
+        loadJson(path);
+        FAIL() << "a truncated file must not load";
+    }
+    catch (const std::runtime_error& ex)
+    {
+        // the message names the file and the position
+        ASSERT_NE(std::string(ex.what()).find(path), std::string::npos);
+        ASSERT_NE(std::string(ex.what()).find("at byte 21"), std::string::npos);
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(IoTests, jsonReader)
+{
+    auto path = ioPath("reader.json");
+    saveJson(sample(), path);
+
+    std::pmr::unsynchronized_pool_resource resource;
+    JsonReader reader(&resource);
+    ASSERT_EQ(reader.load(path), sample());
+    std::size_t capacity = reader.capacity();
+    ASSERT_GE(capacity, sample().dump().size());
+
+    // the buffer is reused for files no larger than the largest so far
+    writeText(path, "[1, 2, 3]");
+    ASSERT_EQ(reader.load(path), Json::array({1, 2, 3}));
+    ASSERT_EQ(reader.capacity(), capacity);
+
+    ASSERT_THROW(reader.load(ioPath("missing.json")), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+/* a type writing itself into a Json object, the other HasToJson shape */
+struct Point
+{
+    int x_{0};
+    int y_{0};
+
+    void toJson(Json& json) const
+    {
+        json = {{"x", x_}, {"y", y_}};
+    }
+
+    void fromJson(const Json& json)
+    {
+        x_ = json["x"];
+        y_ = json["y"];
+    }
+};
+
+static_assert(HasToJson<Point> && HasFromJson<Point>);
+
+TEST(IoTests, formats)
+{
+    auto path = ioPath("formats");
+    for (Format format : {Format::json, Format::cbor, Format::msgpack, Format::bson})
+    {
+        save(sample(), path, format);
+        auto bytes = encode(sample(), format);
+        ASSERT_EQ(detectFormat(std::as_bytes(std::span(bytes))), format);
+        ASSERT_EQ(load(path), sample());
+
+        Point point{3, -4};
+        save(point, path, format);
+        Point loaded;
+        load(loaded, path);
+        ASSERT_EQ(loaded.x_, 3);
+        ASSERT_EQ(loaded.y_, -4);
+    }
+
+    // all but BSON also hold top level arrays and scalars, which the magic
+    // keeps apart from JSON text
+    for (Format format : {Format::json, Format::cbor, Format::msgpack})
+    {
+        for (const Json& value : {Json::array({1, 2}), Json(49), Json(5), Json(-3), Json("abc"), Json(1.5),
+                                  Json(true), Json(nullptr)})
+        {
+            save(value, path, format);
+            ASSERT_EQ(load(path), value) << value.dump();
+        }
+    }
+    std::vector<std::uint8_t> encoded{1, 2};
+    ASSERT_THROW(encode(Json::array({1, 2}), Format::bson, encoded), std::invalid_argument);
+    ASSERT_EQ(encoded, std::vector<std::uint8_t>({1, 2}));
+
+    // MessagePack and BSON from other writers have no magic
+    for (const Json& value : {sample(), Json::array({1, 2})})
+    {
+        auto bytes = Json::to_msgpack(value);
+        ASSERT_EQ(detectFormat(std::as_bytes(std::span(bytes))), Format::msgpack);
+        ASSERT_EQ(decode(std::as_bytes(std::span(bytes)), Format::msgpack), value);
+    }
+    auto document = Json::to_bson(sample());
+    ASSERT_EQ(detectFormat(std::as_bytes(std::span(document))), Format::bson);
+    ASSERT_EQ(decode(std::as_bytes(std::span(document)), Format::bson), sample());
+
+    writeText(path, "\x01\x02garbage");
+    ASSERT_THROW(load(path), std::runtime_error);
+    auto bytes = encode(sample(), Format::cbor);
+    bytes.resize(bytes.size() / 2);
+    ASSERT_THROW(decode(std::as_bytes(std::span(bytes)), Format::cbor), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST(IoTests, asyncWriter)
+{
+    auto path = ioPath("async.json");
+    std::vector<std::future<void>> futures;
+    {
+        AsyncWriter writer;
+        for (int i = 0; i < 50; ++i)
+        {
+            Json json = sample();
+            json["version"] = i;
+            futures.push_back(writer.save(std::move(json), path));
+            futures.push_back(writer.save(Json::array({i}), path + ".other", Format::msgpack));
+        }
+        writer.wait();
+        for (auto& future : futures)
+        {
+            ASSERT_EQ(future.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+            future.get();
+        }
+        // the last save of each file is the one on disk
+        ASSERT_EQ(load(path)["version"], 49);
+        ASSERT_EQ(load(path + ".other"), Json::array({49}));
+        ASSERT_FALSE(std::filesystem::exists(path + ".tmp"));
+
+        auto failed = writer.save(sample(), ioPath("missing") + "/dir/file.json");
+        ASSERT_THROW(failed.get(), std::runtime_error);
+
+        // pending saves are written before the writer stops
+        futures.clear();
+        futures.push_back(writer.save(Json::array({"last"}), path));
+    }
+    futures.back().get();
+    ASSERT_EQ(load(path), Json::array({"last"}));
+
+    saveJsonAsync(sample(), path, Format::cbor).get();
+    ASSERT_EQ(load(path), sample());
+    std::filesystem::remove(path);
+    std::filesystem::remove(path + ".other");
+}
+
+TEST(IoTests, ndjson)
+{
+    auto path = ioPath("records.jsonl");
+    std::vector<Json> records;
+    {
+        NdjsonWriter writer(path, 1000);
+        for (int i = 0; i < 5000; ++i)
+        {
+            Json record = {{"id", i}, {"text", std::string(i % 37, 'x') + "\nline"}};
+            if (i % 1000 == 0)
+                record["long"] = std::string(20000, 'y');
+            writer.append(record);
+            records.push_back(std::move(record));
+        }
+        ASSERT_EQ(writer.size(), records.size());
+        writer.close();
+    }
+
+    // blocks much smaller than a record, and chunks parsed on threads
+    for (auto [block_size, num_threads] : {std::pair{64, 1}, {NdjsonReader::DEFAULT_BLOCK_SIZE, 1},
+                                           {NdjsonReader::DEFAULT_BLOCK_SIZE, 4}})
+    {
+        NdjsonReader reader(block_size, num_threads);
+        std::vector<Json> found;
+        ASSERT_EQ(reader.read(path, [&](Json& record) {found.push_back(std::move(record));}), records.size());
+        ASSERT_EQ(found, records);
+    }
+
+    // blank lines, carriage returns and no line break at the end
+    std::istringstream stream("{\"a\": 1}\r\n\n  \n[2]\n3");
+    std::vector<Json> found;
+    ASSERT_EQ(NdjsonReader(4).read(stream, [&](Json& record) {found.push_back(record);}), 3);
+    ASSERT_EQ(found, (std::vector<Json>{{{"a", 1}}, Json::array({2}), 3}));
+
+    writeText(path, "1\n2\n\n{oops}\n5\n");
+    found.clear();
+    try
+    {
+        NdjsonReader().read(path, [&](Json& record) {found.push_back(record);});
+        FAIL() << "an invalid record must not load";
+    }
+    catch (const std::runtime_error& ex)
+    {
+        ASSERT_NE(std::string(ex.what()).find("line 4"), std::string::npos);
+    }
+    ASSERT_EQ(found, (std::vector<Json>{1, 2}));
+
+    // with threads, the records of a chunk before its bad one are handed over
+    // too; the input is large enough to be split into several chunks
+    for (int bad_line : {101, 30000})
+    {
+        std::string text;
+        for (int i = 1; i <= 40000; ++i)
+            text += i == bad_line ? "{oops}\n" : std::to_string(i) + "\n";
+        writeText(path, text);
+        for (unsigned num_threads : {1u, 4u})
+        {
+            std::size_t num_found{0};
+            try
+            {
+                NdjsonReader(NdjsonReader::DEFAULT_BLOCK_SIZE, num_threads)
+                    .read(path, [&](Json& record) {ASSERT_EQ(record, ++num_found);});
+                FAIL() << "an invalid record must not load";
+            }
+            catch (const std::runtime_error& ex)
+            {
+                ASSERT_NE(std::string(ex.what()).find("line " + std::to_string(bad_line)), std::string::npos);
+            }
+            ASSERT_EQ(num_found, bad_line - 1);
+        }
+    }
+
+    ASSERT_THROW(NdjsonReader().read(ioPath("missing.jsonl"), [](Json&) {}), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+}
+}
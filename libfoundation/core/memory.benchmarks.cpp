@@ -0,0 +1,106 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include "libfoundation/core/memory.hpp"
+#include "libfoundation/sorting/sorting.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory_resource>
+#include <stack>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+namespace core = foundation::core;
+
+/* doc
+A node based map of state.range(0) keys, filled and emptied again, with
+nodes from the global heap, from a ``core::PoolResource`` and from
+``std::pmr::unsynchronized_pool_resource``.  Run with several threads, the
+global heap is shared while each thread has its own pool.
+*/
+template <typename Map, typename... Resource>
+static void fillMap(benchmark::State& state, Resource*... resource)
+{
+    std::vector<std::int64_t> keys(state.range(0));
+    for (auto& key : keys)
+        key = std::rand();
+    for (auto _ : state)
+    {
+        Map map(resource...);
+        for (auto key : keys)
+            map.emplace(key, key);
+        for (auto key : keys)
+            map.erase(key);
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+static void BMmapHeap(benchmark::State& state)
+{
+    fillMap<std::map<std::int64_t, std::int64_t>>(state);
+}
+BENCHMARK(BMmapHeap)->Arg(1 << 10)->Arg(1 << 16)->ThreadRange(1, 4)->UseRealTime();
+
+static void BMmapPool(benchmark::State& state)
+{
+    core::PoolResource pool;
+    fillMap<std::pmr::map<std::int64_t, std::int64_t>>(state, &pool);
+    state.counters["high_water"] = pool.stats().high_water_;
+}
+BENCHMARK(BMmapPool)->Arg(1 << 10)->Arg(1 << 16)->ThreadRange(1, 4)->UseRealTime();
+
+static void BMmapStdPool(benchmark::State& state)
+{
+    std::pmr::unsynchronized_pool_resource pool;
+    fillMap<std::pmr::map<std::int64_t, std::int64_t>>(state, &pool);
+}
+BENCHMARK(BMmapStdPool)->Arg(1 << 10)->Arg(1 << 16)->ThreadRange(1, 4)->UseRealTime();
+
+/* doc
+Many short sorts of state.range(0) values, where the pending range stack
+of ``quickSort`` comes from the thread's arena, against the same loop with
+a ``std::stack`` on the global heap.
+*/
+static void BMquickSortScratch(benchmark::State& state)
+{
+    std::vector<int> values(state.range(0));
+    for (auto _ : state)
+    {
+        for (auto& value : values)
+            value = std::rand();
+        foundation::sorting::quickSort(values.begin(), values.end());
+        benchmark::DoNotOptimize(values.data());
+    }
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BMquickSortScratch)->Arg(16)->Arg(256)->Arg(4096);
+
+static void BMscratchStack(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        core::ScratchScope scratch;
+        std::stack<int, std::pmr::vector<int>> stack(scratch.vector<int>(64));
+        for (int i = 0; i < state.range(0); ++i)
+            stack.push(i);
+        benchmark::DoNotOptimize(stack.top());
+    }
+}
+BENCHMARK(BMscratchStack)->Arg(16)->Arg(256);
+
+static void BMheapStack(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        std::stack<int> stack;
+        for (int i = 0; i < state.range(0); ++i)
+            stack.push(i);
+        benchmark::DoNotOptimize(stack.top());
+    }
+}
+BENCHMARK(BMheapStack)->Arg(16)->Arg(256);
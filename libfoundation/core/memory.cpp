@@ -0,0 +1,159 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include <libfoundation/core/memory.hpp>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <new>
+
+namespace foundation {
+namespace core {
+
+namespace {
+
+/* chunks start with their header, a cache line keeps the first allocation aligned */
+constexpr std::size_t CHUNK_HEADER_BYTES = 64;
+
+std::byte* alignUp(std::byte* p, std::size_t alignment) {
+    auto addr = reinterpret_cast<std::uintptr_t>(p);
+    return p + ((alignment - addr % alignment) % alignment);
+}
+
+}  // namespace
+
+Arena::Arena(std::pmr::memory_resource* upstream, std::size_t min_chunk_bytes)
+    : upstream_{upstream}, next_chunk_bytes_{std::max(min_chunk_bytes, 2 * CHUNK_HEADER_BYTES)} {}
+
+Arena::~Arena() {
+    release();
+}
+
+void* Arena::do_allocate(std::size_t bytes, std::size_t alignment) {
+    std::byte* p = alignUp(cur_, alignment);
+    if (cur_ == nullptr || p > end_ || static_cast<std::size_t>(end_ - p) < bytes) {
+        grow(bytes, alignment);
+        p = alignUp(cur_, alignment);
+    }
+    cur_ = p + bytes;
+    stats_.allocated(bytes);
+    return p;
+}
+
+void Arena::do_deallocate(void* p, std::size_t bytes, std::size_t) {
+    // the last allocation, typically a scratch buffer, is given back right away
+    if (static_cast<std::byte*>(p) + bytes == cur_) {
+        cur_ = static_cast<std::byte*>(p);
+    }
+    stats_.deallocated(bytes);
+}
+
+void Arena::grow(std::size_t bytes, std::size_t alignment) {
+    std::size_t needed = CHUNK_HEADER_BYTES + bytes + alignment;
+
+    // chunks after the current one are left over from before a rewind
+    Chunk* next = current_ ? current_->next_ : first_;
+    if (next == nullptr || next->bytes_ < needed) {
+        std::size_t chunk_bytes = std::max(next_chunk_bytes_, needed);
+        auto chunk    = static_cast<Chunk*>(upstream_->allocate(chunk_bytes, alignof(std::max_align_t)));
+        chunk->next_  = next;
+        chunk->bytes_ = chunk_bytes;
+        if (current_) {
+            current_->next_ = chunk;
+        } else {
+            first_ = chunk;
+        }
+        next = chunk;
+        stats_.bytes_reserved_ += chunk_bytes;
+        next_chunk_bytes_ = std::min(2 * next_chunk_bytes_, MAX_CHUNK_BYTES);
+    }
+    current_ = next;
+    cur_     = reinterpret_cast<std::byte*>(current_) + CHUNK_HEADER_BYTES;
+    end_     = reinterpret_cast<std::byte*>(current_) + current_->bytes_;
+}
+
+void Arena::rewind(const Marker& marker) {
+    current_ = static_cast<Chunk*>(marker.chunk_);
+    cur_     = marker.cur_;
+    end_     = current_ ? reinterpret_cast<std::byte*>(current_) + current_->bytes_ : nullptr;
+    stats_.bytes_in_use_ = marker.bytes_in_use_;
+}
+
+void Arena::release() {
+    while (first_) {
+        Chunk* next = first_->next_;
+        upstream_->deallocate(first_, first_->bytes_, alignof(std::max_align_t));
+        first_ = next;
+    }
+    current_ = nullptr;
+    cur_     = nullptr;
+    end_     = nullptr;
+    stats_.bytes_in_use_   = 0;
+    stats_.bytes_reserved_ = 0;
+}
+
+Arena& threadArena() {
+    thread_local Arena arena;
+    return arena;
+}
+
+namespace {
+
+/* the size class of a request, classes being powers of two from MIN_POOLED_BYTES */
+std::size_t sizeClass(std::size_t bytes, std::size_t alignment) {
+    bytes = std::max({bytes, alignment, PoolResource::MIN_POOLED_BYTES});
+    return std::bit_width(bytes - 1) - std::bit_width(PoolResource::MIN_POOLED_BYTES - 1);
+}
+
+bool pooled(std::size_t bytes, std::size_t alignment) {
+    return bytes <= PoolResource::MAX_POOLED_BYTES && alignment <= alignof(std::max_align_t);
+}
+
+}  // namespace
+
+static_assert(PoolResource::MIN_POOLED_BYTES << 9 == PoolResource::MAX_POOLED_BYTES);
+
+PoolResource::PoolResource(std::pmr::memory_resource* upstream)
+    : upstream_{upstream}, slots_{upstream, Arena::MIN_CHUNK_BYTES * 4} {}
+
+void* PoolResource::do_allocate(std::size_t bytes, std::size_t alignment) {
+    void* p;
+    if (!pooled(bytes, alignment)) {
+        p = upstream_->allocate(bytes, alignment);
+        large_bytes_ += bytes;
+    } else if (FreeSlot*& slot = free_[sizeClass(bytes, alignment)]; slot != nullptr) {
+        p    = slot;
+        slot = slot->next_;
+    } else {
+        // slots of a class are aligned to their size, up to the fundamental alignment
+        std::size_t slot_bytes = MIN_POOLED_BYTES << sizeClass(bytes, alignment);
+        p = slots_.allocate(slot_bytes, std::min(slot_bytes, alignof(std::max_align_t)));
+    }
+    stats_.allocated(bytes);
+    stats_.bytes_reserved_ = slots_.stats().bytes_reserved_ + large_bytes_;
+    return p;
+}
+
+void PoolResource::do_deallocate(void* p, std::size_t bytes, std::size_t alignment) {
+    if (!pooled(bytes, alignment)) {
+        upstream_->deallocate(p, bytes, alignment);
+        large_bytes_ -= bytes;
+    } else {
+        FreeSlot*& slot = free_[sizeClass(bytes, alignment)];
+        slot = ::new (p) FreeSlot{slot};
+    }
+    stats_.deallocated(bytes);
+    stats_.bytes_reserved_ = slots_.stats().bytes_reserved_ + large_bytes_;
+}
+
+void PoolResource::release() {
+    slots_.release();
+    free_.fill(nullptr);
+    stats_.bytes_in_use_   = large_bytes_;
+    stats_.bytes_reserved_ = large_bytes_;
+}
+
+}  // namespace core
+}  // namespace foundation
@@ -0,0 +1,255 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#ifndef MEMORY_HPP_
+#define MEMORY_HPP_
+
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+namespace foundation {
+namespace core {
+
+/** @brief Allocation statistics of a memory resource, for sizing arenas and
+           pools from real workloads
+*/
+struct MemoryStats
+{
+    /** @brief Bytes handed out and not returned yet */
+    std::size_t bytes_in_use_{0};
+    /** @brief The largest bytes_in_use_ so far */
+    std::size_t high_water_{0};
+    /** @brief Number of allocations */
+    std::size_t num_allocations_{0};
+    /** @brief Bytes currently held from the upstream resource */
+    std::size_t bytes_reserved_{0};
+
+    void allocated(std::size_t bytes)
+    {
+        bytes_in_use_ += bytes;
+        high_water_ = bytes_in_use_ > high_water_ ? bytes_in_use_ : high_water_;
+        ++num_allocations_;
+    }
+
+    void deallocated(std::size_t bytes) { bytes_in_use_ -= bytes; }
+};
+
+/** @brief A bump allocator over chunks from an upstream resource.
+
+    Allocation moves a pointer through the current chunk; chunks grow
+    geometrically from min_chunk_bytes, so the number of upstream calls is
+    logarithmic in the bytes allocated. Deallocation only gives memory back
+    when it is the last allocation, the rest is reclaimed by rewind(), reset()
+    or release(). A rewound arena reuses its chunks, so an arena which has seen
+    its peak does not call upstream any more.
+
+    Arenas are not synchronized; use one per thread, see threadArena().
+*/
+class Arena : public std::pmr::memory_resource
+{
+ public:
+    static constexpr std::size_t MIN_CHUNK_BYTES = 4096;
+    static constexpr std::size_t MAX_CHUNK_BYTES = std::size_t{1} << 22;
+
+    /** @brief A position in the arena to rewind to */
+    struct Marker
+    {
+        void*       chunk_;
+        std::byte*  cur_;
+        std::size_t bytes_in_use_;
+    };
+
+    explicit Arena(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource(),
+                   std::size_t min_chunk_bytes = MIN_CHUNK_BYTES);
+    Arena(const Arena&)            = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena() override;
+
+    Marker mark() const { return {current_, cur_, stats_.bytes_in_use_}; }
+
+    /** @brief Frees everything allocated since marker was taken, keeping the chunks */
+    void rewind(const Marker& marker);
+
+    /** @brief Frees everything, keeping the chunks */
+    void reset() { rewind({nullptr, nullptr, 0}); }
+
+    /** @brief Frees everything and returns the chunks to the upstream resource */
+    void release();
+
+    const MemoryStats& stats() const { return stats_; }
+
+    std::pmr::memory_resource* upstream() const { return upstream_; }
+
+ protected:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void  do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+    bool  do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+ private:
+    struct Chunk
+    {
+        Chunk*      next_;
+        std::size_t bytes_;
+    };
+
+    void grow(std::size_t bytes, std::size_t alignment);
+
+    std::pmr::memory_resource* upstream_;
+    Chunk*                     first_{nullptr};
+    Chunk*                     current_{nullptr};
+    std::byte*                 cur_{nullptr};
+    std::byte*                 end_{nullptr};
+    std::size_t                next_chunk_bytes_;
+    MemoryStats                stats_;
+};
+
+/** @brief The arena of the calling thread, for scratch memory
+
+    Memory from it must not be used after the thread ends, and must only be
+    allocated and freed by the thread itself.
+*/
+Arena& threadArena();
+
+/** @brief A pool of fixed size slots in power of two size classes.
+
+    Requests up to MAX_POOLED_BYTES are rounded up to a size class and served
+    from the free list of the class, freed slots go back onto it; slots are
+    carved out of an Arena over the upstream resource. Larger or over-aligned
+    requests go to the upstream resource. Unlike the global heap, a pool per
+    thread never contends with other threads, and slots of one size are reused
+    only for that size, which keeps long running processes from fragmenting.
+
+    Pools are not synchronized; use one per thread or wrap it in
+    std::pmr::synchronized_pool_resource.
+*/
+class PoolResource : public std::pmr::memory_resource
+{
+ public:
+    static constexpr std::size_t MIN_POOLED_BYTES = 8;
+    static constexpr std::size_t MAX_POOLED_BYTES = 4096;
+
+    explicit PoolResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+    PoolResource(const PoolResource&)            = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    /** @brief Returns the slots to the upstream resource, including those in use
+
+        Blocks too large for a size class are not tracked and must be
+        deallocated by their owners.
+    */
+    void release();
+
+    /** @brief The statistics, bytes_in_use_ counting requested not rounded bytes */
+    const MemoryStats& stats() const { return stats_; }
+
+    std::pmr::memory_resource* upstream() const { return upstream_; }
+
+ protected:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void  do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+    bool  do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+ private:
+    struct FreeSlot
+    {
+        FreeSlot* next_;
+    };
+
+    static constexpr std::size_t NUM_CLASSES = 10;
+
+    std::pmr::memory_resource*         upstream_;
+    Arena                              slots_;
+    std::array<FreeSlot*, NUM_CLASSES> free_{};
+    std::size_t                        large_bytes_{0};
+    MemoryStats                        stats_;
+};
+
+/** @brief Adds MemoryStats to any memory resource, passing every call on to it
+
+    Useful to measure what a container or algorithm allocates before choosing
+    the size of an arena or pool for it. Not synchronized.
+*/
+class CountingResource : public std::pmr::memory_resource
+{
+ public:
+    explicit CountingResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : upstream_{upstream}
+    {
+    }
+
+    const MemoryStats& stats() const { return stats_; }
+
+    std::pmr::memory_resource* upstream() const { return upstream_; }
+
+ protected:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        void* p = upstream_->allocate(bytes, alignment);
+        stats_.allocated(bytes);
+        stats_.bytes_reserved_ = stats_.bytes_in_use_;
+        return p;
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+    {
+        upstream_->deallocate(p, bytes, alignment);
+        stats_.deallocated(bytes);
+        stats_.bytes_reserved_ = stats_.bytes_in_use_;
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+ private:
+    std::pmr::memory_resource* upstream_;
+    MemoryStats                stats_;
+};
+
+/** @brief Scratch memory from the thread's arena for the duration of a scope.
+
+    Everything allocated from resource() while the scope is alive, by it or by
+    scopes nested in it, is freed at once when it ends. Scopes must end in the
+    reverse order they began, and containers using a scope must not outlive it
+    nor grow while a nested scope is alive, or their new storage would be freed
+    with the nested scope.
+*/
+class ScratchScope
+{
+ public:
+    ScratchScope() : arena_{threadArena()}, marker_{arena_.mark()} {}
+    ScratchScope(const ScratchScope&)            = delete;
+    ScratchScope& operator=(const ScratchScope&) = delete;
+    ~ScratchScope() { arena_.rewind(marker_); }
+
+    Arena* resource() const { return &arena_; }
+
+    /** @brief An empty vector of scratch memory with room for capacity elements */
+    template <typename T>
+    std::pmr::vector<T> vector(std::size_t capacity = 0) const
+    {
+        std::pmr::vector<T> out(&arena_);
+        out.reserve(capacity);
+        return out;
+    }
+
+ private:
+    Arena&        arena_;
+    Arena::Marker marker_;
+};
+
+}  // namespace core
+}  // namespace foundation
+
+#endif  // MEMORY_HPP_
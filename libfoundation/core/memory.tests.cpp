@@ -0,0 +1,164 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <libfoundation/core/memory.hpp>
+#include <libfoundation/sorting/sorting.hpp>
+
+#include <gtest/gtest.h>
+
+namespace foundation {
+namespace core {
+
+static bool aligned(void* p, std::size_t alignment)
+{
+    return reinterpret_cast<std::uintptr_t>(p) % alignment == 0;
+}
+
+TEST(MemoryTests, arena)
+{
+    CountingResource upstream(std::pmr::new_delete_resource());
+    Arena arena(&upstream, 256);
+    ASSERT_EQ(arena.stats().bytes_reserved_, 0);
+
+    std::vector<char*> blocks;
+    for (std::size_t i = 0; i < 1000; ++i)
+    {
+        std::size_t alignment = std::size_t{1} << (i % 7);
+        auto p = static_cast<char*>(arena.allocate(i % 100 + 1, alignment));
+        ASSERT_TRUE(aligned(p, alignment));
+        std::fill(p, p + i % 100 + 1, static_cast<char>(i));
+        blocks.push_back(p);
+    }
+    for (std::size_t i = 0; i < blocks.size(); ++i)
+        ASSERT_EQ(blocks[i][i % 100], static_cast<char>(i));
+    ASSERT_EQ(arena.stats().num_allocations_, 1000);
+    ASSERT_EQ(arena.stats().bytes_reserved_, upstream.stats().bytes_in_use_);
+
+    // the last allocation is given back at once
+    void* p = arena.allocate(64, 8);
+    arena.deallocate(p, 64, 8);
+    ASSERT_EQ(arena.allocate(64, 8), p);
+
+    // a rewound arena reuses its chunks
+    auto marker = arena.mark();
+    std::size_t in_use = arena.stats().bytes_in_use_;
+    for (int i = 0; i < 100; ++i)
+        ASSERT_NE(arena.allocate(1000, 16), nullptr);
+    std::size_t reserved = arena.stats().bytes_reserved_;
+    std::size_t num_upstream = upstream.stats().num_allocations_;
+    arena.rewind(marker);
+    ASSERT_EQ(arena.stats().bytes_in_use_, in_use);
+    for (int i = 0; i < 100; ++i)
+        ASSERT_NE(arena.allocate(1000, 16), nullptr);
+    ASSERT_EQ(arena.stats().bytes_reserved_, reserved);
+    ASSERT_EQ(upstream.stats().num_allocations_, num_upstream);
+
+    // larger than any chunk so far
+    auto large = static_cast<char*>(arena.allocate(std::size_t{1} << 24, 64));
+    ASSERT_TRUE(aligned(large, 64));
+    large[(std::size_t{1} << 24) - 1] = 1;
+
+    arena.reset();
+    ASSERT_EQ(arena.stats().bytes_in_use_, 0);
+    ASSERT_GT(arena.stats().high_water_, std::size_t{1} << 24);
+    arena.release();
+    ASSERT_EQ(arena.stats().bytes_reserved_, 0);
+    ASSERT_EQ(upstream.stats().bytes_in_use_, 0);
+}
+
+TEST(MemoryTests, pool)
+{
+    CountingResource upstream(std::pmr::new_delete_resource());
+    {
+        PoolResource pool(&upstream);
+        void* p = pool.allocate(24, 8);
+        pool.deallocate(p, 24, 8);
+        // the same size class reuses the slot
+        ASSERT_EQ(pool.allocate(32, 8), p);
+        ASSERT_TRUE(aligned(pool.allocate(8, 16), 16));
+        ASSERT_TRUE(aligned(pool.allocate(4096, 16), 16));
+
+        // over-aligned and large blocks come from upstream
+        void* page = pool.allocate(4096, 64);
+        ASSERT_TRUE(aligned(page, 64));
+        void* large = pool.allocate(100000, 8);
+        ASSERT_EQ(pool.stats().bytes_in_use_, 32 + 8 + 4096 + 4096 + 100000);
+        pool.deallocate(page, 4096, 64);
+        pool.deallocate(large, 100000, 8);
+        pool.release();
+        ASSERT_EQ(pool.stats().bytes_reserved_, 0);
+        ASSERT_EQ(upstream.stats().bytes_in_use_, 0);
+
+        // a node based container matches its std counterpart
+        std::pmr::map<int, std::pmr::string> map(&pool);
+        std::map<int, std::string> reference;
+        for (int i = 0; i < 20000; ++i)
+        {
+            int key = std::rand() % 5000;
+            if (std::rand() % 3 == 0)
+            {
+                map.erase(key);
+                reference.erase(key);
+            }
+            else
+            {
+                std::string value(key % 50, 'v');
+                map.emplace(key, value);
+                reference.emplace(key, value);
+            }
+        }
+        ASSERT_EQ(map.size(), reference.size());
+        for (auto& [key, value] : reference)
+            ASSERT_EQ(std::string_view(map.at(key)), value);
+        ASSERT_LE(pool.stats().high_water_, pool.stats().bytes_reserved_);
+    }
+    ASSERT_EQ(upstream.stats().bytes_in_use_, 0);
+}
+
+TEST(MemoryTests, scratch)
+{
+    Arena& arena = threadArena();
+    std::size_t in_use = arena.stats().bytes_in_use_;
+    {
+        ScratchScope outer;
+        auto values = outer.vector<int>(1000);
+        values.assign(1000, 7);
+        {
+            ScratchScope inner;
+            auto more = inner.vector<double>(100);
+            more.assign(100, 1.5);
+            ASSERT_EQ(more.get_allocator().resource(), &arena);
+        }
+        ASSERT_EQ(values, std::pmr::vector<int>(1000, 7));
+    }
+    ASSERT_EQ(arena.stats().bytes_in_use_, in_use);
+
+    // sorting takes its stack from the arena and leaves it as it was
+    std::vector<int> values(10000);
+    for (int& value : values)
+        value = std::rand();
+    std::size_t num_allocations = arena.stats().num_allocations_;
+    sorting::quickSort(values.begin(), values.end());
+    ASSERT_TRUE(std::is_sorted(values.begin(), values.end()));
+    ASSERT_GT(arena.stats().num_allocations_, num_allocations);
+    ASSERT_EQ(arena.stats().bytes_in_use_, in_use);
+
+    // every thread has its own arena
+    Arena* other{nullptr};
+    std::thread([&] { other = &threadArena(); }).join();
+    ASSERT_NE(other, &arena);
+}
+
+}
+}
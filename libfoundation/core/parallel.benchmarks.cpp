@@ -0,0 +1,133 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include "libfoundation/core/parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+namespace core = foundation::core;
+
+/* doc
+The cost of a task: state.range(0) empty tasks spawned into one group from
+outside the pool and synced, against spawning the same number recursively
+from inside the pool, where every spawn goes onto the worker's own deque.
+*/
+static void BMspawnFlat(benchmark::State& state)
+{
+    core::ThreadPool pool(2);
+    for (auto _ : state)
+    {
+        core::TaskGroup group(pool);
+        for (std::int64_t i = 0; i < state.range(0); ++i)
+            group.spawn([] {});
+        group.sync();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BMspawnFlat)->Arg(1 << 10)->Arg(1 << 16)->UseRealTime();
+
+static void spawnTree(core::ThreadPool& pool, std::int64_t n)
+{
+    if (n <= 1)
+        return;
+    core::TaskGroup group(pool);
+    group.spawn([&pool, n] { spawnTree(pool, n / 2); });
+    spawnTree(pool, n - n / 2 - 1);
+    group.sync();
+}
+
+static void BMspawnNested(benchmark::State& state)
+{
+    core::ThreadPool pool(2);
+    for (auto _ : state)
+    {
+        core::TaskGroup group(pool);
+        group.spawn([&] { spawnTree(pool, state.range(0)); });
+        group.sync();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BMspawnNested)->Arg(1 << 10)->Arg(1 << 16)->UseRealTime();
+
+/* doc
+Recursive divide and conquer on a pool of state.range(0) workers, a
+Fibonacci recursion spawning one branch down to a cutoff.  ``balance`` is
+the largest number of tasks run by one worker over the mean, 1 being a
+perfect spread, and ``stolen`` the tasks that moved between workers.
+*/
+static std::int64_t fibSerial(int n)
+{
+    return n < 2 ? n : fibSerial(n - 1) + fibSerial(n - 2);
+}
+
+static std::int64_t fib(core::ThreadPool& pool, int n)
+{
+    if (n < 16)
+        return fibSerial(n);
+    std::int64_t a{0};
+    core::TaskGroup group(pool);
+    group.spawn([&] { a = fib(pool, n - 1); });
+    std::int64_t b = fib(pool, n - 2);
+    group.sync();
+    return a + b;
+}
+
+static void BMfibSerial(benchmark::State& state)
+{
+    int n = 30;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(n);
+        benchmark::DoNotOptimize(fibSerial(n));
+    }
+}
+BENCHMARK(BMfibSerial)->Unit(benchmark::kMillisecond);
+
+static void BMfibParallel(benchmark::State& state)
+{
+    core::ThreadPool pool(state.range(0));
+    int n = 30;
+    for (auto _ : state)
+    {
+        // from a worker, like nested parallelism inside a running task
+        benchmark::DoNotOptimize(n);
+        core::TaskGroup group(pool);
+        group.spawn([&] { benchmark::DoNotOptimize(fib(pool, n)); });
+        group.sync();
+    }
+    std::vector<std::size_t> executed;
+    for (unsigned i = 0; i < pool.size(); ++i)
+        executed.push_back(pool.numExecuted(i));
+    double mean = 0;
+    for (auto num : executed)
+        mean += static_cast<double>(num) / executed.size();
+    state.counters["balance"] = *std::max_element(executed.begin(), executed.end()) / mean;
+    state.counters["stolen"] = pool.numStolen();
+}
+BENCHMARK(BMfibParallel)->Arg(1)->Arg(2)->Arg(4)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+/* doc
+``parallelFor`` over state.range(0) elements with a grain of
+state.range(1) elements per task, 0 being the default.
+*/
+static void BMparallelFor(benchmark::State& state)
+{
+    std::vector<std::int64_t> values(state.range(0));
+    for (auto _ : state)
+    {
+        core::parallelFor(0, values.size(), [&](std::size_t i) { values[i] = i * i; }, state.range(1));
+        benchmark::DoNotOptimize(values.data());
+    }
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BMparallelFor)
+    ->ArgsProduct({{1 << 20}, {0, 64, 4096, 1 << 20}})
+    ->ArgNames({"n", "grain"})
+    ->UseRealTime();
@@ -0,0 +1,332 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include <libfoundation/core/parallel.hpp>
+#include <functional>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace foundation {
+namespace core {
+
+namespace internal {
+
+WorkDeque::WorkDeque(std::size_t capacity) {
+    std::size_t size = 1;
+    while (size < capacity) {
+        size *= 2;
+    }
+    rings_.push_back(std::make_unique<Ring>(size));
+    ring_.store(rings_.back().get(), std::memory_order_relaxed);
+}
+
+WorkDeque::~WorkDeque() = default;
+
+// The orderings follow Lê et al., with the fences folded into sequentially
+// consistent accesses of top and bottom, which thread sanitizers understand.
+
+void WorkDeque::push(Task* task) {
+    std::int64_t b    = bottom_.load(std::memory_order_relaxed);
+    std::int64_t t    = top_.load(std::memory_order_acquire);
+    Ring*        ring = ring_.load(std::memory_order_relaxed);
+    if (b - t > static_cast<std::int64_t>(ring->mask_)) {
+        ring = grow(ring, t, b);
+    }
+    (*ring)[b].store(task, std::memory_order_relaxed);
+    bottom_.store(b + 1, std::memory_order_seq_cst);
+}
+
+Task* WorkDeque::take() {
+    std::int64_t b    = bottom_.load(std::memory_order_relaxed) - 1;
+    Ring*        ring = ring_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_seq_cst);
+    std::int64_t t = top_.load(std::memory_order_seq_cst);
+    if (t > b) {
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Task* task = (*ring)[b].load(std::memory_order_relaxed);
+    if (t == b) {
+        // the last task, thieves may race for it
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            task = nullptr;
+        }
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return task;
+}
+
+Task* WorkDeque::steal() {
+    std::int64_t t = top_.load(std::memory_order_seq_cst);
+    std::int64_t b = bottom_.load(std::memory_order_seq_cst);
+    if (t >= b) {
+        return nullptr;
+    }
+    Task* task = (*ring_.load(std::memory_order_acquire))[t].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return task;
+}
+
+std::size_t WorkDeque::size() const {
+    std::int64_t b = bottom_.load(std::memory_order_relaxed);
+    std::int64_t t = top_.load(std::memory_order_relaxed);
+    return b > t ? static_cast<std::size_t>(b - t) : 0;
+}
+
+WorkDeque::Ring* WorkDeque::grow(Ring* ring, std::int64_t top, std::int64_t bottom) {
+    rings_.push_back(std::make_unique<Ring>(2 * (ring->mask_ + 1)));
+    Ring* bigger = rings_.back().get();
+    for (std::int64_t i = top; i < bottom; ++i) {
+        (*bigger)[i].store((*ring)[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    ring_.store(bigger, std::memory_order_release);
+    return bigger;
+}
+
+}  // namespace internal
+
+struct ThreadPool::Worker {
+    internal::WorkDeque      deque_;
+    std::atomic<std::size_t> num_executed_{0};
+    std::thread              thread_;
+};
+
+namespace {
+
+/* the pool and worker index of the calling thread */
+struct CurrentWorker {
+    const ThreadPool* pool_{nullptr};
+    int               index_{-1};
+};
+
+thread_local CurrentWorker current_worker;
+
+/* rounds an idle thread yields, watching for work, before it sleeps */
+constexpr int SPIN_ROUNDS = 64;
+
+/* a cheap per thread random number for picking victims */
+unsigned nextRandom() {
+    thread_local std::uint32_t state =
+        static_cast<std::uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id())) | 1;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+void pinToCore(unsigned index) {
+#ifdef __linux__
+    unsigned  num_cores = std::max(1u, std::thread::hardware_concurrency());
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(index % num_cores, &cpus);
+    ::pthread_setaffinity_np(::pthread_self(), sizeof(cpus), &cpus);
+#else
+    (void)index;
+#endif
+}
+
+}  // namespace
+
+ThreadPool::ThreadPool(unsigned num_threads, bool pin) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < num_threads; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    // the workers steal from each other, so all deques exist before any
+    // thread starts
+    for (unsigned i = 0; i < num_threads; ++i) {
+        workers_[i]->thread_ = std::thread([this, i, pin] { run(i, pin); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    stop_.store(true);
+    wake(true);
+    for (auto& worker : workers_) {
+        worker->thread_.join();
+    }
+}
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool pool;
+    return pool;
+}
+
+int ThreadPool::workerIndex() const {
+    return current_worker.pool_ == this ? current_worker.index_ : -1;
+}
+
+std::size_t ThreadPool::numExecuted(unsigned i) const {
+    return workers_[i]->num_executed_.load(std::memory_order_relaxed);
+}
+
+void ThreadPool::submit(internal::Task* task) {
+    int index = workerIndex();
+    if (index >= 0) {
+        workers_[index]->deque_.push(task);
+    } else {
+        std::lock_guard lock(injected_mutex_);
+        injected_.push_back(task);
+        num_injected_.fetch_add(1);
+    }
+    wake(false);
+}
+
+internal::Task* ThreadPool::find() {
+    int index = workerIndex();
+    if (index >= 0) {
+        if (internal::Task* task = workers_[index]->deque_.take()) {
+            return task;
+        }
+    }
+    if (num_injected_.load() > 0) {
+        std::lock_guard lock(injected_mutex_);
+        if (!injected_.empty()) {
+            internal::Task* task = injected_.back();
+            injected_.pop_back();
+            num_injected_.fetch_sub(1);
+            return task;
+        }
+    }
+    // one round over the other workers from a random start
+    std::size_t num_workers = workers_.size();
+    std::size_t start       = nextRandom() % num_workers;
+    for (std::size_t k = 0; k < num_workers; ++k) {
+        std::size_t victim = (start + k) % num_workers;
+        if (static_cast<int>(victim) == index) {
+            continue;
+        }
+        if (internal::Task* task = workers_[victim]->deque_.steal()) {
+            num_stolen_.fetch_add(1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+bool ThreadPool::runOne() {
+    internal::Task* task = find();
+    if (task == nullptr) {
+        return false;
+    }
+    workers_[workerIndex()]->num_executed_.fetch_add(1, std::memory_order_relaxed);
+    task->execute();
+    return true;
+}
+
+void ThreadPool::idle(std::uint32_t epoch) {
+    // a while awake first, so that a burst of small tasks does not wake a
+    // sleeper for each
+    num_searching_.fetch_add(1);
+    for (int i = 0; i < SPIN_ROUNDS; ++i) {
+        std::this_thread::yield();
+        if (epoch_.load() != epoch) {
+            num_searching_.fetch_sub(1);
+            return;
+        }
+    }
+    num_searching_.fetch_sub(1);
+
+    // a wake() after epoch was read either sees the sleeper, or changed the
+    // epoch before it is compared here
+    num_sleeping_.fetch_add(1);
+    if (epoch_.load() == epoch && !stop_.load()) {
+        epoch_.wait(epoch);
+    }
+    num_sleeping_.fetch_sub(1);
+}
+
+void ThreadPool::wake(bool all) {
+    epoch_.fetch_add(1);
+    if (num_sleeping_.load() > 0) {
+        if (all) {
+            epoch_.notify_all();
+        } else if (num_searching_.load() == 0) {
+            epoch_.notify_one();
+        }
+    }
+}
+
+void ThreadPool::run(unsigned index, bool pin) {
+    current_worker = {this, static_cast<int>(index)};
+    if (pin) {
+        pinToCore(index);
+    }
+    while (true) {
+        std::uint32_t epoch = epoch_.load();
+        if (runOne()) {
+            continue;
+        }
+        if (stop_.load()) {
+            return;
+        }
+        idle(epoch);
+    }
+}
+
+TaskGroup::~TaskGroup() {
+    try {
+        sync();
+    } catch (...) {
+    }
+}
+
+void TaskGroup::sync() {
+    // tasks run by a thread outside the pool would spawn through the shared
+    // queue, so only workers help while they wait
+    bool helping = pool_->workerIndex() >= 0;
+    while (pending_.load() != 0) {
+        std::uint32_t epoch = pool_->epoch_.load();
+        if (helping && pool_->runOne()) {
+            continue;
+        }
+        // either finish() sees waiting_ and wakes us, or we see its decrement
+        waiting_.store(true);
+        if (pending_.load() == 0) {
+            break;
+        }
+        pool_->idle(epoch);
+    }
+    // the last tasks may still be leaving finish(), the group must outlive them
+    while (num_finished_.load(std::memory_order_acquire) != num_spawned_.load(std::memory_order_relaxed)) {
+        std::this_thread::yield();
+    }
+    waiting_.store(false, std::memory_order_relaxed);
+
+    std::exception_ptr error;
+    {
+        std::lock_guard lock(error_mutex_);
+        error = std::exchange(error_, nullptr);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void TaskGroup::fail(std::exception_ptr error) {
+    std::lock_guard lock(error_mutex_);
+    if (!error_) {
+        error_ = error;
+    }
+}
+
+void TaskGroup::finish() {
+    // only a waiting owner is woken, idle workers are left asleep
+    if (pending_.fetch_sub(1) == 1 && waiting_.load()) {
+        pool_->wake(true);
+    }
+    num_finished_.fetch_add(1, std::memory_order_release);
+}
+
+}  // namespace core
+}  // namespace foundation
@@ -0,0 +1,291 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#ifndef PARALLEL_HPP_
+#define PARALLEL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace foundation {
+namespace core {
+
+class TaskGroup;
+
+namespace internal {
+
+/** @brief A unit of work run once by a ThreadPool */
+class Task
+{
+ public:
+    virtual ~Task()        = default;
+    virtual void execute() = 0;
+};
+
+/** @brief The work-stealing deque of Chase and Lev, in the C11 formulation of
+           Lê, Pop, Cohen and Zappa Nardelli.
+
+    The owning thread pushes and takes tasks at the bottom, like a stack, and
+    other threads steal from the top, so the owner works on the most recent,
+    smallest tasks while thieves take the oldest, largest ones. Only a take of
+    the last task and steals synchronize with each other. The ring grows when
+    full; retired rings are kept until the deque is destroyed, as a thief may
+    still read from them.
+*/
+class WorkDeque
+{
+ public:
+    explicit WorkDeque(std::size_t capacity = 256);
+    WorkDeque(const WorkDeque&)            = delete;
+    WorkDeque& operator=(const WorkDeque&) = delete;
+    ~WorkDeque();
+
+    /** @brief Pushes a task, owner only */
+    void push(Task* task);
+
+    /** @brief Takes the newest task, owner only
+        @return The task, or nullptr if the deque is empty
+    */
+    Task* take();
+
+    /** @brief Steals the oldest task, any thread
+        @return The task, or nullptr if the deque is empty or another thread
+                took the task first
+    */
+    Task* steal();
+
+    /** @brief The number of tasks, exact only when no thread is using the deque */
+    std::size_t size() const;
+
+ private:
+    struct Ring
+    {
+        explicit Ring(std::size_t capacity)
+            : mask_{capacity - 1}, slots_{std::make_unique<std::atomic<Task*>[]>(capacity)}
+        {
+        }
+
+        std::atomic<Task*>& operator[](std::int64_t i) const { return slots_[i & mask_]; }
+
+        std::size_t                           mask_;
+        std::unique_ptr<std::atomic<Task*>[]> slots_;
+    };
+
+    Ring* grow(Ring* ring, std::int64_t top, std::int64_t bottom);
+
+    // top and bottom on their own cache lines, thieves hammer top
+    alignas(64) std::atomic<std::int64_t> top_{0};
+    alignas(64) std::atomic<std::int64_t> bottom_{0};
+    alignas(64) std::atomic<Ring*> ring_;
+    std::vector<std::unique_ptr<Ring>> rings_;
+};
+
+}  // namespace internal
+
+/** @brief A fixed set of worker threads scheduling tasks by work stealing.
+
+    Each worker owns a WorkDeque: tasks spawned on a worker go onto its own
+    deque, and a worker without work steals from the others, so the work of a
+    recursive divide and conquer spreads over the workers in few, large
+    pieces. Tasks spawned by other threads go through a shared queue.
+
+    A worker waiting for tasks in TaskGroup::sync() runs other tasks in the
+    meantime, so nested parallelism does not need more threads than workers
+    and cannot deadlock on them; threads outside the pool block in sync().
+    Idle workers look for tasks a little while, then sleep until tasks are
+    spawned.
+*/
+class ThreadPool
+{
+ public:
+    /** @brief Starts the workers
+        @param num_threads Number of workers, 0 selects
+               std::thread::hardware_concurrency()
+        @param pin Whether to pin worker i to core i modulo the number of
+               cores, where the platform supports it
+    */
+    explicit ThreadPool(unsigned num_threads = 0, bool pin = false);
+    ThreadPool(const ThreadPool&)            = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /** @brief Stops the workers, after every TaskGroup using the pool has synced */
+    ~ThreadPool();
+
+    /** @brief The pool used by default, with one worker per core */
+    static ThreadPool& global();
+
+    unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+
+    /** @brief The index of the calling thread among the workers, or -1 */
+    int workerIndex() const;
+
+    /** @brief Number of tasks run by worker i */
+    std::size_t numExecuted(unsigned i) const;
+
+    /** @brief Number of tasks stolen from another worker's deque */
+    std::size_t numStolen() const { return num_stolen_.load(std::memory_order_relaxed); }
+
+ private:
+    friend class TaskGroup;
+
+    struct Worker;
+
+    void submit(internal::Task* task);
+    internal::Task* find();
+    bool runOne();
+    void idle(std::uint32_t epoch);
+    void wake(bool all);
+    void run(unsigned index, bool pin);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::mutex                           injected_mutex_;
+    std::vector<internal::Task*>         injected_;
+    std::atomic<std::size_t>             num_injected_{0};
+    std::atomic<std::uint32_t>           epoch_{0};
+    std::atomic<unsigned>                num_sleeping_{0};
+    std::atomic<unsigned>                num_searching_{0};
+    std::atomic<bool>                    stop_{false};
+    std::atomic<std::size_t>             num_stolen_{0};
+};
+
+/** @brief Fork/join: tasks spawned into a group are waited for by sync().
+
+    The first exception thrown by a task is rethrown by sync(), the others
+    are dropped. The destructor syncs as well, without rethrowing.
+*/
+class TaskGroup
+{
+ public:
+    explicit TaskGroup(ThreadPool& pool = ThreadPool::global()) : pool_{&pool} {}
+    TaskGroup(const TaskGroup&)            = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+    ~TaskGroup();
+
+    /** @brief Schedules f() to run on the pool, f is copied or moved */
+    template <typename F>
+    void spawn(F&& f)
+    {
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        num_spawned_.fetch_add(1, std::memory_order_relaxed);
+        pool_->submit(new FunctionTask<std::decay_t<F>>(std::forward<F>(f), this));
+    }
+
+    /** @brief Waits until every task spawned into the group ran, running
+               other tasks meanwhile when called on a worker
+        @throw The first exception thrown by one of them
+    */
+    void sync();
+
+ private:
+    template <typename F>
+    class FunctionTask : public internal::Task
+    {
+     public:
+        FunctionTask(F f, TaskGroup* group) : f_{std::move(f)}, group_{group} {}
+
+        void execute() override
+        {
+            try {
+                f_();
+            } catch (...) {
+                group_->fail(std::current_exception());
+            }
+            TaskGroup* group = group_;
+            delete this;
+            group->finish();
+        }
+
+     private:
+        F          f_;
+        TaskGroup* group_;
+    };
+
+    void fail(std::exception_ptr error);
+    void finish();
+
+    ThreadPool*              pool_;
+    std::atomic<std::size_t> pending_{0};
+    std::atomic<std::size_t> num_spawned_{0};
+    std::atomic<std::size_t> num_finished_{0};
+    std::atomic<bool>        waiting_{false};
+    std::mutex               error_mutex_;
+    std::exception_ptr       error_;
+};
+
+/** @brief Runs every function, in parallel where workers are free, and
+           returns when all returned
+    @throw The first exception thrown by one of them
+*/
+template <typename... F>
+void parallelInvoke(F&&... f)
+{
+    static_assert(sizeof...(F) > 0);
+    TaskGroup group;
+    auto run = [&](auto&& first, auto&&... rest) {
+        // the first function runs on the calling thread
+        (group.spawn(std::ref(rest)), ...);
+        first();
+    };
+    run(std::forward<F>(f)...);
+    group.sync();
+}
+
+namespace internal {
+
+template <typename F>
+void parallelFor(TaskGroup& group, std::size_t first, std::size_t last, std::size_t grain, const F& f)
+{
+    // halves are spawned until a piece is no larger than grain, the last half
+    // stays here
+    while (last - first > grain) {
+        std::size_t mid = first + (last - first) / 2;
+        group.spawn([&group, mid, last, grain, &f] { parallelFor(group, mid, last, grain, f); });
+        last = mid;
+    }
+    for (std::size_t i = first; i < last; ++i) {
+        f(i);
+    }
+}
+
+}  // namespace internal
+
+/** @brief Calls f(i) for every i in [first, last), in parallel
+    @param first The first index
+    @param last One past the last index
+    @param f The function, called concurrently from several threads
+    @param grain Largest number of indices run as one task, 0 picks enough
+           tasks for about eight per worker
+    @param pool The pool to run on
+    @throw The first exception thrown by f
+*/
+template <typename F>
+void parallelFor(std::size_t first, std::size_t last, const F& f, std::size_t grain = 0,
+                 ThreadPool& pool = ThreadPool::global())
+{
+    if (first >= last) {
+        return;
+    }
+    if (grain == 0) {
+        grain = std::max<std::size_t>(1, (last - first) / (8 * pool.size()));
+    }
+    TaskGroup group(pool);
+    internal::parallelFor(group, first, last, grain, f);
+    group.sync();
+}
+
+}  // namespace core
+}  // namespace foundation
+
+#endif  // PARALLEL_HPP_
@@ -0,0 +1,154 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include <atomic>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <libfoundation/core/parallel.hpp>
+
+#include <gtest/gtest.h>
+
+namespace foundation {
+namespace core {
+
+/* a task which counts its runs */
+struct CountingTask : public internal::Task
+{
+    std::atomic<int> num_runs_{0};
+
+    void execute() override { ++num_runs_; }
+};
+
+TEST(ParallelTests, workDeque)
+{
+    std::vector<CountingTask> tasks(1000);
+    internal::WorkDeque deque(4);
+    ASSERT_EQ(deque.take(), nullptr);
+    ASSERT_EQ(deque.steal(), nullptr);
+
+    // the owner takes the newest, thieves steal the oldest, across growing the ring
+    for (auto& task : tasks)
+        deque.push(&task);
+    ASSERT_EQ(deque.size(), tasks.size());
+    ASSERT_EQ(deque.take(), &tasks.back());
+    ASSERT_EQ(deque.steal(), &tasks.front());
+    ASSERT_EQ(deque.size(), tasks.size() - 2);
+
+    // every task is taken or stolen exactly once while thieves race the owner
+    internal::WorkDeque shared;
+    std::atomic<bool> done{false};
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < 3; ++i)
+    {
+        thieves.emplace_back([&] {
+            while (!done.load() || shared.size() > 0)
+            {
+                if (internal::Task* task = shared.steal())
+                    task->execute();
+            }
+        });
+    }
+    for (std::size_t i = 0; i < tasks.size(); ++i)
+    {
+        shared.push(&tasks[i]);
+        if (i % 3 == 0)
+        {
+            if (internal::Task* task = shared.take())
+                task->execute();
+        }
+    }
+    while (internal::Task* task = shared.take())
+        task->execute();
+    done = true;
+    for (auto& thief : thieves)
+        thief.join();
+    for (auto& task : tasks)
+        ASSERT_EQ(task.num_runs_, 1);
+}
+
+static std::int64_t fib(ThreadPool& pool, int n)
+{
+    if (n < 12)
+        return n < 2 ? n : fib(pool, n - 1) + fib(pool, n - 2);
+    std::int64_t a{0};
+    TaskGroup group(pool);
+    group.spawn([&] { a = fib(pool, n - 1); });
+    std::int64_t b = fib(pool, n - 2);
+    group.sync();
+    return a + b;
+}
+
+TEST(ParallelTests, forkJoin)
+{
+    for (unsigned num_threads : {1u, 2u, 4u})
+    {
+        ThreadPool pool(num_threads, num_threads == 2);
+        ASSERT_EQ(pool.size(), num_threads);
+        ASSERT_EQ(pool.workerIndex(), -1);
+        ASSERT_EQ(fib(pool, 24), 46368);
+
+        std::size_t num_executed{0};
+        for (unsigned i = 0; i < pool.size(); ++i)
+            num_executed += pool.numExecuted(i);
+        ASSERT_GT(num_executed, 0);
+
+        // tasks spawned from outside the pool
+        std::atomic<int> num_runs{0};
+        TaskGroup group(pool);
+        for (int i = 0; i < 100; ++i)
+            group.spawn([&] { ++num_runs; });
+        group.sync();
+        ASSERT_EQ(num_runs, 100);
+    }
+}
+
+TEST(ParallelTests, parallelFor)
+{
+    ThreadPool pool(4);
+    std::vector<std::int64_t> values(100000);
+    for (std::size_t grain : {0, 1, 1000, 1000000})
+    {
+        std::fill(values.begin(), values.end(), 0);
+        parallelFor(0, values.size(), [&](std::size_t i) { values[i] += i; }, grain, pool);
+        for (std::size_t i = 0; i < values.size(); ++i)
+            ASSERT_EQ(values[i], i);
+    }
+    parallelFor(5, 5, [](std::size_t) { FAIL(); }, 0, pool);
+
+    // nested loops share the workers
+    std::vector<std::atomic<int>> counts(64);
+    parallelFor(0, 64, [&](std::size_t i) {
+        parallelFor(0, 64, [&](std::size_t) { ++counts[i]; }, 4, pool);
+    }, 1, pool);
+    for (auto& count : counts)
+        ASSERT_EQ(count, 64);
+}
+
+TEST(ParallelTests, parallelInvoke)
+{
+    int a{0}, b{0}, c{0};
+    parallelInvoke([&] { a = 1; }, [&] { b = 2; }, [&] { c = 3; });
+    ASSERT_EQ(a + b + c, 6);
+
+    ASSERT_THROW(parallelInvoke([] {}, [] { throw std::runtime_error("task"); }), std::runtime_error);
+    ASSERT_THROW(parallelFor(0, 1000, [](std::size_t i) {
+        if (i == 777)
+            throw std::out_of_range("index");
+    }), std::out_of_range);
+
+    // the group is usable after an exception
+    TaskGroup group;
+    group.spawn([] { throw std::runtime_error("first"); });
+    ASSERT_THROW(group.sync(), std::runtime_error);
+    group.spawn([&] { a = 10; });
+    group.sync();
+    ASSERT_EQ(a, 10);
+}
+
+}
+}
@@ -0,0 +1,50 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include "libfoundation/heaps/external.hpp"
+
+#include <cstdint>
+
+#include <benchmark/benchmark.h>
+
+/* doc
+Pushes state.range(0) elements into a queue with a 1 MiB budget and then pops
+them all.  The counters report the amortized I/O volume in bytes per
+push/pop pair, which grows by one element size per level of run merges.
+*/
+static void BMexternalQueuePushPop(benchmark::State& state)
+{
+    foundation::heaps::ExternalQueueOptions options;
+    options.memory_budget_ = std::size_t{1} << 20;
+    options.block_size_    = std::size_t{16} << 10;
+
+    std::size_t bytes_written{0};
+    std::size_t bytes_read{0};
+    for (auto _ : state)
+    {
+        foundation::heaps::ExternalQueue<std::uint64_t> queue(options);
+        for (std::int64_t i = 0; i < state.range(0); ++i)
+        {
+            queue.push(std::rand());
+        }
+        while (!queue.empty())
+        {
+            benchmark::DoNotOptimize(queue.pop());
+        }
+        bytes_written += queue.stats().bytes_written_;
+        bytes_read += queue.stats().bytes_read_;
+    }
+
+    double num_ops = static_cast<double>(state.iterations() * state.range(0));
+    state.counters["written/op"] = bytes_written / num_ops;
+    state.counters["read/op"]    = bytes_read / num_ops;
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BMexternalQueuePushPop)
+    ->RangeMultiplier(4)
+    ->Range(1 << 16, 1 << 22)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity(benchmark::oNLogN);
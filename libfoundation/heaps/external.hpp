@@ -0,0 +1,425 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#ifndef EXTERNAL_HPP_
+#define EXTERNAL_HPP_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <libfoundation/core/assertions.hpp>
+#include <libfoundation/core/memory.hpp>
+#include <libfoundation/heaps/heaps.hpp>
+
+namespace foundation
+{
+namespace heaps
+{
+
+/**
+ * @brief Memory budget and spill location of an ``ExternalQueue``
+ */
+struct ExternalQueueOptions
+{
+    /** Bytes available for the insertion heap and the run buffers */
+    std::size_t memory_budget_{std::size_t{64} << 20};
+    /** Bytes transferred by a single read or write of a run */
+    std::size_t block_size_{std::size_t{1} << 20};
+    /** Directory in which the run files are created */
+    std::filesystem::path directory_{std::filesystem::temp_directory_path()};
+};
+
+/**
+ * @brief I/O counters of an ``ExternalQueue``
+ */
+struct ExternalQueueStats
+{
+    std::size_t bytes_written_{0};
+    std::size_t bytes_read_{0};
+    std::size_t runs_written_{0};
+};
+
+/**
+ * @brief A priority queue holding more elements than fit in memory.
+ *
+ * New elements go to an in-memory insertion heap.  When the heap reaches
+ * half of the memory budget it is sorted and written sequentially to a run
+ * file on disk.  Popping takes the larger of the insertion heap top and the
+ * top of a merge heap over the fronts of all runs.  Each run is read in
+ * blocks of ``block_size_`` bytes, and the next block of a run is read in
+ * the background while the current one is consumed.
+ *
+ * The other half of the budget holds two blocks per run.  When there are
+ * more runs than fit, the smaller half of them is merged into a single run,
+ * so memory stays bounded and each spilled element is rewritten a
+ * logarithmic number of times.
+ *
+ * @tparam T Value type, must be trivially copyable
+ * @tparam Compare Strict weak ordering, larger elements are popped first
+ */
+template <typename T, typename Compare = std::less<T>>
+    requires std::is_trivially_copyable_v<T>
+class ExternalQueue
+{
+ private:
+    /**
+     * @brief Sequential reader over a run file sorted largest first
+     */
+    class Run
+    {
+     private:
+        std::filesystem::path    path_;
+        std::FILE*               file_{nullptr};
+        std::vector<T>           cur_;
+        std::vector<T>           next_;
+        std::size_t              pos_{0};
+        std::size_t              block_len_;
+        std::size_t              remaining_;
+        std::future<std::size_t> pending_;
+        ExternalQueueStats*      stats_;
+
+        void prefetch()
+        {
+            next_.resize(block_len_);
+            T*          buf  = next_.data();
+            std::FILE*  file = file_;
+            std::size_t len  = block_len_;
+
+            pending_ = std::async(
+                std::launch::async,
+                [=] { return std::fread(buf, sizeof(T), len, file); });
+        }
+
+        void swapBlocks()
+        {
+            std::size_t num_read = pending_.get();
+            next_.resize(num_read);
+            stats_->bytes_read_ += num_read * sizeof(T);
+
+            std::swap(cur_, next_);
+            pos_ = 0;
+            if (!cur_.empty())
+            {
+                prefetch();
+            }
+        }
+
+     public:
+        Run(std::filesystem::path path,
+            std::size_t           block_len,
+            ExternalQueueStats*   stats)
+            : path_{std::move(path)},
+              block_len_{block_len},
+              remaining_{std::filesystem::file_size(path_) / sizeof(T)},
+              stats_{stats}
+        {
+            file_ = std::fopen(path_.c_str(), "rb");
+            ERR_ASSERT_THROW_m(file_ != nullptr, std::runtime_error,
+                               "cannot open run file " + path_.string());
+            cur_.reserve(block_len_);
+            prefetch();
+            swapBlocks();
+        }
+
+        Run(const Run&)            = delete;
+        Run& operator=(const Run&) = delete;
+
+        ~Run()
+        {
+            if (pending_.valid())
+            {
+                pending_.wait();
+            }
+            std::fclose(file_);
+            std::error_code ec;
+            std::filesystem::remove(path_, ec);
+        }
+
+        const T& front() const { return cur_[pos_]; }
+
+        bool exhausted() const { return pos_ == cur_.size(); }
+
+        /** @brief Number of elements not yet consumed */
+        std::size_t remaining() const { return remaining_; }
+
+        void advance()
+        {
+            ++pos_;
+            --remaining_;
+            if (pos_ == cur_.size())
+            {
+                swapBlocks();
+            }
+        }
+    };
+
+    using RunPtr = std::unique_ptr<Run>;
+
+    ExternalQueueOptions options_;
+    Compare              cmp_;
+    std::vector<T>       insertion_;
+    std::size_t          insertion_capacity_;
+    std::size_t          block_len_;
+    std::size_t          max_runs_;
+    std::vector<RunPtr>  runs_;
+    std::size_t          size_{0};
+    std::uint64_t        token_{newToken()};
+    std::size_t          next_run_id_{0};
+    ExternalQueueStats   stats_;
+
+    auto runCmp() const
+    {
+        return [this](const RunPtr& a, const RunPtr& b)
+        { return cmp_(a->front(), b->front()); };
+    }
+
+    static std::uint64_t newToken()
+    {
+        std::random_device device;
+        return (std::uint64_t{device()} << 32) ^ device();
+    }
+
+    /**
+     * @brief Creates a new run file for writing
+     *
+     * The directory may be shared with other queues and processes, so run
+     * names carry a random token and files are created exclusively: a name
+     * already taken gets a new token rather than truncating someone else's
+     * run.
+     */
+    std::pair<std::filesystem::path, std::FILE*> createRunFile()
+    {
+        for (int attempt = 0; attempt < 16; ++attempt)
+        {
+            auto name = "foundation-epq-" + std::to_string(token_) + "-" +
+                        std::to_string(next_run_id_++) + ".run";
+            auto       path = options_.directory_ / name;
+            std::FILE* file = std::fopen(path.c_str(), "wbx");
+            if (file != nullptr)
+            {
+                return {std::move(path), file};
+            }
+            ERR_ASSERT_THROW_m(errno == EEXIST, std::runtime_error,
+                               "cannot create run file " + path.string());
+            token_ = newToken();
+        }
+        ERR_ASSERT_THROW_m(false, std::runtime_error,
+                           "cannot find a free run file name in " +
+                               options_.directory_.string());
+    }
+
+    /**
+     * @brief Writes ``data`` to a run file with a single sequential write
+     */
+    void writeBlock(std::FILE* file, const T* data, std::size_t len)
+    {
+        std::size_t num_written = std::fwrite(data, sizeof(T), len, file);
+        ERR_ASSERT_THROW_m(num_written == len, std::runtime_error,
+                           "failed to write run file");
+        stats_.bytes_written_ += len * sizeof(T);
+    }
+
+    void addRun(const std::filesystem::path& path)
+    {
+        ++stats_.runs_written_;
+        runs_.push_back(std::make_unique<Run>(path, block_len_, &stats_));
+        pushHeap(runs_.begin(), runs_.end(), runCmp());
+    }
+
+    /**
+     * @brief Merges the smaller half of the runs, at least two, into one
+     *        new run
+     *
+     * Always merging the runs with the fewest remaining elements keeps the
+     * run sizes geometric, so every element is rewritten ``O(log(n / M))``
+     * times, like in a tiered LSM tree.
+     */
+    void compact()
+    {
+        auto [path, file] = createRunFile();
+
+        std::size_t num_merged = std::max<std::size_t>(2, runs_.size() / 2);
+        auto mid = std::next(runs_.begin(), runs_.size() - num_merged);
+        std::nth_element(runs_.begin(), mid, runs_.end(),
+                         [](const RunPtr& a, const RunPtr& b)
+                         { return a->remaining() > b->remaining(); });
+
+        // the merge buffers are scratch memory of the thread's arena
+        core::ScratchScope scratch;
+        auto merged = scratch.vector<RunPtr>(num_merged);
+        merged.assign(std::make_move_iterator(mid), std::make_move_iterator(runs_.end()));
+        runs_.erase(mid, runs_.end());
+        makeHeap(runs_.begin(), runs_.end(), runCmp());
+        makeHeap(merged.begin(), merged.end(), runCmp());
+
+        auto out = scratch.vector<T>(block_len_);
+        while (!merged.empty())
+        {
+            popHeap(merged.begin(), merged.end(), runCmp());
+            Run& run = *merged.back();
+            out.push_back(run.front());
+            run.advance();
+
+            if (run.exhausted())
+            {
+                merged.pop_back();
+            }
+            else
+            {
+                pushHeap(merged.begin(), merged.end(), runCmp());
+            }
+
+            if (out.size() == block_len_)
+            {
+                writeBlock(file, out.data(), out.size());
+                out.clear();
+            }
+        }
+        writeBlock(file, out.data(), out.size());
+        std::fclose(file);
+        addRun(path);
+    }
+
+    /**
+     * @brief Sorts the insertion heap largest first and writes it as a run
+     */
+    void spill()
+    {
+        std::sort(insertion_.begin(), insertion_.end(),
+                  [this](const T& a, const T& b) { return cmp_(b, a); });
+
+        auto [path, file] = createRunFile();
+        writeBlock(file, insertion_.data(), insertion_.size());
+        std::fclose(file);
+        insertion_.clear();
+
+        if (runs_.size() == max_runs_)
+        {
+            compact();
+        }
+        addRun(path);
+    }
+
+    bool topInRuns() const
+    {
+        return !runs_.empty() &&
+               (insertion_.empty() ||
+                cmp_(insertion_.front(), runs_.front()->front()));
+    }
+
+ public:
+    /**
+     * @brief Creates an empty queue
+     *
+     * @param options Memory budget and spill location
+     * @param cmp Comparison object
+     */
+    explicit ExternalQueue(ExternalQueueOptions options = {},
+                           Compare              cmp     = Compare{})
+        : options_{std::move(options)}, cmp_{cmp}
+    {
+        ERR_ASSERT_THROW_INVARG_m(
+            options_.memory_budget_ >= 4 * options_.block_size_,
+            "memory budget must hold at least four blocks");
+        ERR_ASSERT_THROW_INVARG_m(options_.block_size_ >= sizeof(T),
+                                  "block size must hold one element");
+
+        insertion_capacity_ = options_.memory_budget_ / 2 / sizeof(T);
+        block_len_          = options_.block_size_ / sizeof(T);
+        max_runs_ = std::max<std::size_t>(
+            2, options_.memory_budget_ / 2 / (2 * options_.block_size_));
+        insertion_.reserve(insertion_capacity_);
+    }
+
+    ExternalQueue(const ExternalQueue&)            = delete;
+    ExternalQueue& operator=(const ExternalQueue&) = delete;
+
+    std::size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    const ExternalQueueStats& stats() const { return stats_; }
+
+    const ExternalQueueOptions& options() const { return options_; }
+
+    /**
+     * @brief Number of runs currently on disk
+     */
+    std::size_t numRuns() const { return runs_.size(); }
+
+    /**
+     * @brief Inserts ``value``, spilling the insertion heap first if it is
+     *        full
+     */
+    void push(const T& value)
+    {
+        if (insertion_.size() == insertion_capacity_)
+        {
+            spill();
+        }
+        insertion_.push_back(value);
+        pushHeap(insertion_.begin(), insertion_.end(), cmp_);
+        ++size_;
+    }
+
+    /**
+     * @brief Returns the largest element
+     */
+    const T& top() const
+    {
+        ERR_ASSERT_THROW_RANGE_m(size_ > 0, "top() on an empty queue");
+        return topInRuns() ? runs_.front()->front() : insertion_.front();
+    }
+
+    /**
+     * @brief Removes and returns the largest element
+     */
+    T pop()
+    {
+        ERR_ASSERT_THROW_RANGE_m(size_ > 0, "pop() on an empty queue");
+
+        --size_;
+        if (topInRuns())
+        {
+            popHeap(runs_.begin(), runs_.end(), runCmp());
+            Run& run = *runs_.back();
+            T    out = run.front();
+            run.advance();
+
+            if (run.exhausted())
+            {
+                runs_.pop_back();
+            }
+            else
+            {
+                pushHeap(runs_.begin(), runs_.end(), runCmp());
+            }
+            return out;
+        }
+
+        popHeap(insertion_.begin(), insertion_.end(), cmp_);
+        T out = insertion_.back();
+        insertion_.pop_back();
+        return out;
+    }
+};
+
+}  // namespace heaps
+}  // namespace foundation
+
+#endif  // EXTERNAL_HPP_
@@ -0,0 +1,98 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include <libfoundation/heaps/external.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace foundation
+{
+namespace heaps
+{
+
+/* doc
+A tiny budget forces many spills and run compactions on small inputs.
+*/
+static ExternalQueueOptions smallOptions()
+{
+    ExternalQueueOptions options;
+    options.memory_budget_ = 4096;
+    options.block_size_    = 256;
+    return options;
+}
+
+TEST(ExternalQueue, pushThenPop)
+{
+    ExternalQueue<int> queue(smallOptions());
+
+    std::vector<int> data(20000);
+    std::generate(data.begin(), data.end(), std::rand);
+    for (int val : data)
+    {
+        queue.push(val);
+    }
+    ASSERT_EQ(queue.size(), data.size());
+    ASSERT_GT(queue.stats().runs_written_, 0);
+    ASSERT_GT(queue.stats().bytes_written_, 0);
+
+    std::sort(data.begin(), data.end(), std::greater<>{});
+    for (int val : data)
+    {
+        ASSERT_EQ(queue.top(), val);
+        ASSERT_EQ(queue.pop(), val);
+    }
+    ASSERT_TRUE(queue.empty());
+    ASSERT_EQ(queue.numRuns(), 0);
+    ASSERT_THROW(queue.pop(), std::out_of_range);
+}
+
+/**
+ * @brief Interleaved pushes and pops match ``std::priority_queue`` with a
+ *        reversed comparison, i.e. a min-queue.
+ */
+TEST(ExternalQueue, interleaved)
+{
+    ExternalQueue<long, std::greater<long>> queue(smallOptions());
+    std::priority_queue<long, std::vector<long>, std::greater<long>> reference;
+
+    for (int i = 0; i < 50000; ++i)
+    {
+        if (reference.empty() || std::rand() % 3 != 0)
+        {
+            long val = std::rand();
+            queue.push(val);
+            reference.push(val);
+        }
+        else
+        {
+            ASSERT_EQ(queue.pop(), reference.top());
+            reference.pop();
+        }
+    }
+
+    while (!reference.empty())
+    {
+        ASSERT_EQ(queue.pop(), reference.top());
+        reference.pop();
+    }
+    ASSERT_TRUE(queue.empty());
+}
+
+TEST(ExternalQueue, invalidOptions)
+{
+    ExternalQueueOptions options;
+    options.memory_budget_ = 1024;
+    options.block_size_    = 1024;
+    ASSERT_THROW(ExternalQueue<int>{options}, std::invalid_argument);
+}
+
+}  // namespace heaps
+}  // namespace foundation
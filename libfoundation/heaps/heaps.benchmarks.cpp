@@ -0,0 +1,215 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include "libfoundation/heaps/heaps.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <numeric>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+/* doc
+Element types: 4-byte and 8-byte scalars, and a 64-byte record which only
+fits one element per cache line.
+*/
+struct Payload64
+{
+    std::int64_t                key_{0};
+    std::array<std::int64_t, 7> pad_{};
+
+    Payload64() = default;
+    Payload64(std::int64_t key) : key_{key} {}
+
+    bool operator<(const Payload64& other) const { return key_ < other.key_; }
+};
+
+static_assert(sizeof(Payload64) == 64);
+
+/* doc
+Access patterns of the input: already a heap (descending), the worst case for
+building a max-heap (ascending), and uniformly random.
+*/
+enum class Pattern
+{
+    Ascending,
+    Descending,
+    Random
+};
+
+template <typename T>
+static std::vector<T> makeData(std::int64_t n, Pattern pattern)
+{
+    std::vector<std::int64_t> keys(n);
+    std::iota(keys.begin(), keys.end(), 0);
+    if (pattern == Pattern::Descending)
+    {
+        std::reverse(keys.begin(), keys.end());
+    }
+    else if (pattern == Pattern::Random)
+    {
+        std::generate(keys.begin(), keys.end(), std::rand);
+    }
+    return std::vector<T>(keys.begin(), keys.end());
+}
+
+/* doc
+Sizes run from 256 elements, which fit in L1 for the scalars, to 4M
+elements, which are well beyond the last level cache.  The 64-byte record
+stops at 1M elements (64 MiB).
+*/
+template <typename T>
+static void sizeRange(benchmark::internal::Benchmark* bench)
+{
+    std::int64_t max_size = sizeof(T) > 8 ? (1 << 20) : (1 << 22);
+    bench->RangeMultiplier(4)->Range(1 << 8, max_size);
+}
+
+#define HEAP_BENCHMARK_m(func, complexity)                                    \
+    BENCHMARK_TEMPLATE(func, int, Pattern::Random)                            \
+        ->Apply(sizeRange<int>)                                               \
+        ->Complexity(complexity);                                             \
+    BENCHMARK_TEMPLATE(func, int, Pattern::Ascending)                         \
+        ->Apply(sizeRange<int>)                                               \
+        ->Complexity(complexity);                                             \
+    BENCHMARK_TEMPLATE(func, int, Pattern::Descending)                        \
+        ->Apply(sizeRange<int>)                                               \
+        ->Complexity(complexity);                                             \
+    BENCHMARK_TEMPLATE(func, double, Pattern::Random)                         \
+        ->Apply(sizeRange<double>)                                            \
+        ->Complexity(complexity);                                             \
+    BENCHMARK_TEMPLATE(func, Payload64, Pattern::Random)                      \
+        ->Apply(sizeRange<Payload64>)                                         \
+        ->Complexity(complexity)
+
+template <typename T, Pattern pattern>
+static void BMmakeHeap(benchmark::State& state)
+{
+    const std::vector<T> input = makeData<T>(state.range(0), pattern);
+    std::vector<T>       data(input.size());
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        std::copy(input.begin(), input.end(), data.begin());
+        state.ResumeTiming();
+
+        foundation::heaps::makeHeap(data.begin(), data.end());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetComplexityN(state.range(0));
+}
+HEAP_BENCHMARK_m(BMmakeHeap, benchmark::oN);
+
+template <typename T, Pattern pattern>
+static void BMmakeHeapParallel(benchmark::State& state)
+{
+    const std::vector<T> input = makeData<T>(state.range(0), pattern);
+    std::vector<T>       data(input.size());
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        std::copy(input.begin(), input.end(), data.begin());
+        state.ResumeTiming();
+
+        foundation::heaps::makeHeapParallel(data.begin(), data.end());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetComplexityN(state.range(0));
+}
+HEAP_BENCHMARK_m(BMmakeHeapParallel, benchmark::oN);
+
+/* doc
+Replaces the root by the smallest key, which has to travel the full height of
+the heap, and heapifies it.  The heap property holds again after every
+iteration, so the measurement is a steady state.
+*/
+template <typename T, Pattern pattern>
+static void BMheapify(benchmark::State& state)
+{
+    std::vector<T> data = makeData<T>(state.range(0), pattern);
+    foundation::heaps::makeHeap(data.begin(), data.end());
+
+    const T smallest{-1};
+    for (auto _ : state)
+    {
+        data.front() = smallest;
+        foundation::heaps::internal::heapify(data.begin(), data.size(), 0);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetComplexityN(state.range(0));
+}
+HEAP_BENCHMARK_m(BMheapify, benchmark::oLogN);
+
+/* doc
+A valid heap is the worst case for ``isHeap`` as the whole range is scanned.
+*/
+template <typename T, Pattern pattern>
+static void BMisHeap(benchmark::State& state)
+{
+    std::vector<T> data = makeData<T>(state.range(0), pattern);
+    foundation::heaps::makeHeap(data.begin(), data.end());
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(
+            foundation::heaps::isHeap(data.begin(), data.end()));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetComplexityN(state.range(0));
+}
+HEAP_BENCHMARK_m(BMisHeap, benchmark::oN);
+
+/* doc
+Steady state push/pop mix on a heap of state.range(0) random keys in
+[0, 2^30).  The pushed keys follow the access pattern: ascending keys are
+all larger than the heap contents and rise to the root, descending keys are
+all smaller and stay at the leaves.
+*/
+template <typename T, Pattern pattern>
+static void BMpushPop(benchmark::State& state)
+{
+    std::vector<T> data(state.range(0));
+    std::generate(data.begin(), data.end(), [] { return std::rand() >> 1; });
+    foundation::heaps::makeHeap(data.begin(), data.end());
+    data.reserve(data.size() + 1);
+
+    std::vector<T> keys(1 << 12);
+    for (int i = 0; i < static_cast<int>(keys.size()); ++i)
+    {
+        switch (pattern)
+        {
+            case Pattern::Ascending:
+                keys[i] = (1 << 30) + i;
+                break;
+            case Pattern::Descending:
+                keys[i] = -i;
+                break;
+            case Pattern::Random:
+                keys[i] = std::rand() >> 1;
+                break;
+        }
+    }
+
+    std::size_t k{0};
+    for (auto _ : state)
+    {
+        data.push_back(keys[k]);
+        foundation::heaps::pushHeap(data.begin(), data.end());
+        foundation::heaps::popHeap(data.begin(), data.end());
+        data.pop_back();
+        k = (k + 1) % keys.size();
+    }
+    state.SetItemsProcessed(2 * state.iterations());
+    state.SetComplexityN(state.range(0));
+}
+HEAP_BENCHMARK_m(BMpushPop, benchmark::oLogN);
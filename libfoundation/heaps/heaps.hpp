@@ -3,7 +3,14 @@
 
 #include <algorithm>
 #include <cstdio>
+#include <functional>
 #include <iterator>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <libfoundation/core/assertions.hpp>
 
 namespace foundation
 {
@@ -65,42 +72,59 @@ inline DiffType<Iterator> right(DiffType<Iterator> i)
  *              max-heaps.
  *
  * @tparam BidirIt Iterator of type LegacyBidirectionalIterator
+ * @tparam Compare Strict weak ordering, the heap top is the largest element
  * @param begin Start of range
  * @param heap_size Size of sequence, so ``std::distance(begin, end)``
- * @param i Index  
- * @return requires
+ * @param i Index
+ * @param cmp Comparison object
  */
-template <typename BidirIt>
+template <typename BidirIt, typename Compare>
     requires std::bidirectional_iterator<BidirIt>
-void heapify(BidirIt begin, DiffType<BidirIt> heap_size, DiffType<BidirIt> i)
+void heapify(BidirIt           begin,
+             DiffType<BidirIt> heap_size,
+             DiffType<BidirIt> i,
+             Compare           cmp)
 {
     using Diff = DiffType<BidirIt>;
 
+    ERR_ASSERT_CHEAP_m(i >= 0 && i <= heap_size, "heapify() index out of range");
     auto i_iter = std::next(begin, i);
 
     while (true)
     {
-        Diff l            = left<BidirIt>(i);
-        Diff r            = right<BidirIt>(i);
+        Diff l = left<BidirIt>(i);
+        Diff r = right<BidirIt>(i);
+
+        if (l >= heap_size)
+        {
+            break;
+        }
+
         auto l_iter       = std::next(i_iter, l - i);
-        auto r_iter       = std::next(l_iter, 1);
         auto largest_iter = i_iter;
+        Diff largest      = i;
 
-        if ((l < heap_size) && (*largest_iter < *l_iter))
+        if (cmp(*largest_iter, *l_iter))
         {
             largest_iter = l_iter;
+            largest      = l;
         }
 
-        if ((r < heap_size) && (*largest_iter < *r_iter))
+        if (r < heap_size)
         {
-            largest_iter = r_iter;
+            auto r_iter = std::next(l_iter, 1);
+            if (cmp(*largest_iter, *r_iter))
+            {
+                largest_iter = r_iter;
+                largest      = r;
+            }
         }
 
-        if (largest_iter != i_iter)
+        if (largest != i)
         {
             std::iter_swap(i_iter, largest_iter);
             i_iter = largest_iter;
-            i      = std::distance(begin, i_iter);
+            i      = largest;
         }
         else
         {
@@ -109,83 +133,308 @@ void heapify(BidirIt begin, DiffType<BidirIt> heap_size, DiffType<BidirIt> i)
     }
 }
 
-}  // namespace internal
-
+/**
+ * @brief Max-heapifies a given range ``[begin, end)`` using ``operator<``
+ *
+ * @tparam BidirIt Iterator of type LegacyBidirectionalIterator
+ * @param begin Start of range
+ * @param heap_size Size of sequence, so ``std::distance(begin, end)``
+ * @param i Index
+ */
 template <typename BidirIt>
-    requires std::bidirectional_iterator<BidirIt> 
-bool isHeap(BidirIt first, BidirIt last)
+    requires std::bidirectional_iterator<BidirIt>
+void heapify(BidirIt begin, DiffType<BidirIt> heap_size, DiffType<BidirIt> i)
 {
-    using Diff = DiffType<BidirIt>;
-    Diff heap_size{std::distance(first, last)};
-    Diff heap_size_half{internal::parent<BidirIt>(heap_size)};
-    bool is_heap{true};
+    heapify(begin, heap_size, i, std::less<>{});
+}
 
-    // if heap_size is odd all non-leaf nodes have 2 children
-    bool all_two_children{(heap_size % 2) == 1};
-    Diff lim = all_two_children ? heap_size_half : heap_size_half - 1;
+/**
+ * @brief Moves the element at index ``i`` up towards the root until its
+ *        parent is no smaller than it.
+ *
+ * Assumptions: ``[begin, begin + i)`` is a max-heap.
+ *
+ * @tparam BidirIt Iterator of type LegacyBidirectionalIterator
+ * @tparam Compare Strict weak ordering
+ * @param begin Start of range
+ * @param i Index of the element to sift up
+ * @param cmp Comparison object
+ */
+template <typename BidirIt, typename Compare>
+    requires std::bidirectional_iterator<BidirIt>
+void siftUp(BidirIt begin, DiffType<BidirIt> i, Compare cmp)
+{
+    using Diff = DiffType<BidirIt>;
 
-    /* First, we shall look at all the non-leaf nodes which are guaranteed to
-       have two children */
-    auto i_iter = first;
-    for (Diff i = 0; i < lim; ++i)
+    ERR_ASSERT_CHEAP_m(i >= 0, "siftUp() index out of range");
+    auto i_iter = std::next(begin, i);
+    while (i > 0)
     {
-        Diff l      = internal::left<BidirIt>(i);
-        auto l_iter = std::next(i_iter, l - i);
+        Diff p      = parent<BidirIt>(i - 1);
+        auto p_iter = std::prev(i_iter, i - p);
 
-        if (*i_iter < *l_iter)
+        if (!cmp(*p_iter, *i_iter))
         {
-            is_heap = false;
             break;
         }
+        std::iter_swap(p_iter, i_iter);
+        i_iter = p_iter;
+        i      = p;
+    }
+}
 
-        Diff r      = internal::right<BidirIt>(i);
-        auto r_iter = std::next(l_iter, 1);
+/**
+ * @brief Returns the first child in ``[first, last)`` that is larger than
+ *        its parent, walking parent and child iterators in lock step.
+ *
+ * Each element is visited once, so the cost is linear also for
+ * bidirectional iterators.
+ *
+ * @tparam BidirIt Iterator of type LegacyBidirectionalIterator
+ * @tparam Compare Strict weak ordering
+ * @param first Start of range
+ * @param last One-past-end of range
+ * @param cmp Comparison object
+ * @return Iterator to the first violating child, or ``last``
+ */
+template <typename BidirIt, typename Compare>
+    requires std::bidirectional_iterator<BidirIt>
+BidirIt isHeapUntilSerial(BidirIt first, BidirIt last, Compare cmp)
+{
+    if (first == last)
+    {
+        return last;
+    }
+
+    auto p_iter   = first;
+    auto c_iter   = std::next(first);
+    bool is_right = false;
 
-        if (*i_iter < *r_iter)
+    for (; c_iter != last; ++c_iter)
+    {
+        if (cmp(*p_iter, *c_iter))
         {
-            is_heap = false;
-            break;
+            return c_iter;
+        }
+        if (is_right)
+        {
+            ++p_iter;
         }
+        is_right = !is_right;
+    }
+    return last;
+}
 
-        std::advance(i_iter, 1);
+/**
+ * @brief Block-wise ``isHeapUntil`` for contiguous ranges of arithmetic
+ *        values.
+ *
+ * Parents ``[i, i + B)`` have their children in the contiguous range
+ * ``[2i + 1, 2i + 2B + 1)``, so a block of parents is compared against the
+ * interleaved left and right child vectors without branches, which the
+ * compiler turns into SIMD compares.  The violation flag is tested once per
+ * block, and the first violating block is rescanned with the scalar loop to
+ * find the exact position.
+ *
+ * @tparam RandomIt Iterator of type ContiguousIterator
+ * @tparam Compare Strict weak ordering
+ * @param first Start of range
+ * @param last One-past-end of range
+ * @param cmp Comparison object
+ * @return Iterator to the first violating child, or ``last``
+ */
+template <typename RandomIt, typename Compare>
+    requires std::contiguous_iterator<RandomIt>
+RandomIt isHeapUntilBlocked(RandomIt first, RandomIt last, Compare cmp)
+{
+    using Diff = DiffType<RandomIt>;
+
+    constexpr Diff block = 32;
+
+    const auto* data = std::to_address(first);
+    Diff        n    = std::distance(first, last);
+
+    if (n < 2)
+    {
+        return last;
     }
 
-    /* Second we look at the non-leaf node which may have only one child
-     */
-    if (!all_two_children)
+    // parents with two children are [0, (n - 1) / 2)
+    Diff num_full = (n - 1) / 2;
+    Diff i        = 0;
+
+    for (; i + block <= num_full; i += block)
     {
-        Diff i      = heap_size_half - 1;
-        Diff l      = internal::left<BidirIt>(i);
-        auto l_iter = std::next(i_iter, l - i);
+        const auto* parents  = data + i;
+        const auto* children = data + 2 * i + 1;
 
-        if (*i_iter < *l_iter)
+        unsigned bad{0};
+        for (Diff j = 0; j < block; ++j)
+        {
+            bad |= static_cast<unsigned>(cmp(parents[j], children[2 * j])) |
+                   static_cast<unsigned>(cmp(parents[j], children[2 * j + 1]));
+        }
+        if (bad != 0)
         {
-            is_heap = false;
+            break;
         }
+    }
 
-        Diff r = internal::right<BidirIt>(i);
-        if (r < heap_size)
+    for (Diff c = 2 * i + 1; c < n; ++c)
+    {
+        if (cmp(data[(c - 1) / 2], data[c]))
         {
-            auto r_iter = std::next(l_iter, 1);
-            if (*i_iter < *r_iter)
-            {
-                is_heap = false;
-            }
+            return std::next(first, c);
         }
     }
-    return is_heap;
+    return last;
+}
+
+/**
+ * @brief Heapifies every node of the subtrees rooted at the consecutive
+ *        indices ``[r0, r1)``, deepest nodes first.
+ *
+ * The descendants of ``[r0, r1)`` at depth ``d`` below them occupy the
+ * contiguous index range ``[(r0 + 1) 2^d - 1, (r1 + 1) 2^d - 1)``, so the
+ * subtrees are processed level by level with sequential memory access.
+ *
+ * @tparam RandomIt Iterator of type LegacyRandomAccessIterator
+ * @tparam Compare Strict weak ordering
+ * @param first Start of range
+ * @param heap_size Size of the heap
+ * @param r0 First subtree root
+ * @param r1 One-past-last subtree root
+ * @param cmp Comparison object
+ */
+template <typename RandomIt, typename Compare>
+    requires std::random_access_iterator<RandomIt>
+void heapifySubtrees(RandomIt           first,
+                     DiffType<RandomIt> heap_size,
+                     DiffType<RandomIt> r0,
+                     DiffType<RandomIt> r1,
+                     Compare            cmp)
+{
+    using Diff = DiffType<RandomIt>;
+
+    // only nodes below last_parent have children
+    Diff last_parent = parent<RandomIt>(heap_size);
+
+    Diff scale = 1;
+    while ((r0 + 1) * scale * 2 - 1 <= last_parent)
+    {
+        scale *= 2;
+    }
+
+    for (; scale > 0; scale /= 2)
+    {
+        Diff lo = (r0 + 1) * scale - 1;
+        Diff hi = std::min((r1 + 1) * scale - 1, last_parent + 1);
+        for (Diff i = hi - 1; i >= lo; --i)
+        {
+            heapify(first, heap_size, i, cmp);
+        }
+    }
+}
+
+}  // namespace internal
+
+/**
+ * @brief Returns the end of the largest prefix of ``[first, last)`` that is
+ *        a max-heap with respect to ``cmp``
+ *
+ * Contiguous ranges of arithmetic values are checked block-wise, see
+ * ``internal::isHeapUntilBlocked``.  Both paths stop at the first violation.
+ *
+ * @tparam BidirIt Iterator of type LegacyBidirectionalIterator
+ * @tparam Compare Strict weak ordering
+ * @param first Start of range
+ * @param last One-past-end of range
+ * @param cmp Comparison object
+ * @return Iterator to the first element violating the heap property, or
+ *         ``last``
+ */
+template <typename BidirIt, typename Compare>
+    requires std::bidirectional_iterator<BidirIt>
+BidirIt isHeapUntil(BidirIt first, BidirIt last, Compare cmp)
+{
+    using Value = ValueType<BidirIt>;
+
+    if constexpr (std::contiguous_iterator<BidirIt> &&
+                  std::is_arithmetic_v<Value>)
+    {
+        return internal::isHeapUntilBlocked(first, last, cmp);
+    }
+    else
+    {
+        return internal::isHeapUntilSerial(first, last, cmp);
+    }
+}
+
+/**
+ * @brief Returns the end of the largest prefix of ``[first, last)`` that is
+ *        a max-heap
+ *
+ * @tparam BidirIt Iterator of type LegacyBidirectionalIterator
+ * @param first Start of range
+ * @param last One-past-end of range
+ * @return Iterator to the first element violating the heap property, or
+ *         ``last``
+ */
+template <typename BidirIt>
+    requires std::bidirectional_iterator<BidirIt>
+BidirIt isHeapUntil(BidirIt first, BidirIt last)
+{
+    return isHeapUntil(first, last, std::less<>{});
+}
+
+/**
+ * @brief Checks whether the range ``[first, last)`` is a max-heap with
+ *        respect to ``cmp``
+ *
+ * The scan stops at the first violation.
+ *
+ * @tparam BidirIt Iterator of type LegacyBidirectionalIterator
+ * @tparam Compare Strict weak ordering
+ * @param first Start of range
+ * @param last One-past-end of range
+ * @param cmp Comparison object
+ * @return ``true`` if the range is a heap
+ */
+template <typename BidirIt, typename Compare>
+    requires std::bidirectional_iterator<BidirIt>
+bool isHeap(BidirIt first, BidirIt last, Compare cmp)
+{
+    return isHeapUntil(first, last, cmp) == last;
+}
+
+/**
+ * @brief Checks whether the range ``[first, last)`` is a max-heap
+ *
+ * @tparam BidirIt Iterator of type LegacyBidirectionalIterator
+ * @param first Start of range
+ * @param last One-past-end of range
+ * @return ``true`` if the range is a heap
+ */
+template <typename BidirIt>
+    requires std::bidirectional_iterator<BidirIt>
+bool isHeap(BidirIt first, BidirIt last)
+{
+    return isHeap(first, last, std::less<>{});
 }
 
 /**
  * @brief Makes the range of values in range ``[start, end)`` a max-heap
+ *        with respect to ``cmp``
  *
  * @tparam BidirIt Iteraotr of type LegacyBidirectionalIterator
+ * @tparam Compare Strict weak ordering
  * @param begin Start of range
  * @param end On-past-end of range
+ * @param cmp Comparison object
  */
-template <typename BidirIt>
+template <typename BidirIt, typename Compare>
     requires std::bidirectional_iterator<BidirIt>
-void makeHeap(BidirIt begin, BidirIt end)
+void makeHeap(BidirIt begin, BidirIt end, Compare cmp)
 {
     using Diff     = DiffType<BidirIt>;
     Diff heap_size = std::distance(begin, end);
@@ -194,7 +443,146 @@ void makeHeap(BidirIt begin, BidirIt end)
 
     for (Diff i = start; i >= 0; --i)
     {
-        internal::heapify(begin, heap_size, i);
+        internal::heapify(begin, heap_size, i, cmp);
+    }
+    ERR_ASSERT_EXPENSIVE_m(isHeap(begin, end, cmp), "makeHeap() did not build a heap");
+}
+
+/**
+ * @brief Makes the range of values in range ``[start, end)`` a max-heap
+ *        using ``operator<``
+ *
+ * @tparam BidirIt Iterator of type LegacyBidirectionalIterator
+ * @param begin Start of range
+ * @param end On-past-end of range
+ */
+template <typename BidirIt>
+    requires std::bidirectional_iterator<BidirIt>
+void makeHeap(BidirIt begin, BidirIt end)
+{
+    makeHeap(begin, end, std::less<>{});
+}
+
+/**
+ * @brief Makes the range ``[begin, end)`` a max-heap using several threads
+ *
+ * The nodes at the first level with at least ``4 * num_threads`` nodes are
+ * roots of independent subtrees.  Each thread builds a contiguous slice of
+ * these subtrees bottom-up, level by level, after which the few levels
+ * above are heapified serially.  Ranges too small to amortise starting
+ * threads are handled by the serial ``makeHeap``.
+ *
+ * @tparam RandomIt Iterator of type LegacyRandomAccessIterator
+ * @tparam Compare Strict weak ordering
+ * @param begin Start of range
+ * @param end One-past-end of range
+ * @param cmp Comparison object
+ * @param num_threads Number of threads, ``0`` selects
+ *        ``std::thread::hardware_concurrency()``
+ */
+template <typename RandomIt, typename Compare = std::less<>>
+    requires std::random_access_iterator<RandomIt>
+void makeHeapParallel(RandomIt    begin,
+                      RandomIt    end,
+                      Compare     cmp         = Compare{},
+                      std::size_t num_threads = 0)
+{
+    using Diff = DiffType<RandomIt>;
+
+    constexpr Diff min_parallel_size = Diff{1} << 16;
+
+    Diff heap_size = std::distance(begin, end);
+    if (num_threads == 0)
+    {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    if (num_threads == 1 || heap_size < min_parallel_size)
+    {
+        makeHeap(begin, end, cmp);
+        return;
+    }
+
+    // first level holding at least 4 subtrees per thread
+    Diff split = 0;
+    Diff width = 1;
+    while (width < static_cast<Diff>(4 * num_threads))
+    {
+        split = internal::left<RandomIt>(split);
+        width *= 2;
+    }
+    width = std::min(width, internal::parent<RandomIt>(heap_size) - split + 1);
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+
+    Diff chunk = (width + static_cast<Diff>(num_threads) - 1) /
+                 static_cast<Diff>(num_threads);
+    for (Diff r0 = split; r0 < split + width; r0 += chunk)
+    {
+        Diff r1 = std::min(r0 + chunk, split + width);
+        threads.emplace_back(
+            [=] { internal::heapifySubtrees(begin, heap_size, r0, r1, cmp); });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    for (Diff i = split - 1; i >= 0; --i)
+    {
+        internal::heapify(begin, heap_size, i, cmp);
+    }
+    ERR_ASSERT_EXPENSIVE_m(isHeap(begin, end, cmp), "makeHeapParallel() did not build a heap");
+}
+
+/**
+ * @brief Inserts the element at ``end - 1`` into the max-heap
+ *        ``[begin, end - 1)``
+ *
+ * @tparam BidirIt Iterator of type LegacyBidirectionalIterator
+ * @tparam Compare Strict weak ordering
+ * @param begin Start of range
+ * @param end One-past-end of range, the new element is at ``end - 1``
+ * @param cmp Comparison object
+ */
+template <typename BidirIt, typename Compare = std::less<>>
+    requires std::bidirectional_iterator<BidirIt>
+void pushHeap(BidirIt begin, BidirIt end, Compare cmp = Compare{})
+{
+    using Diff     = DiffType<BidirIt>;
+    Diff heap_size = std::distance(begin, end);
+
+    if (heap_size > 1)
+    {
+        internal::siftUp(begin, heap_size - 1, cmp);
+    }
+    ERR_ASSERT_EXPENSIVE_m(isHeap(begin, end, cmp), "pushHeap() requires [begin, end - 1) to be a heap");
+}
+
+/**
+ * @brief Moves the largest element of the max-heap ``[begin, end)`` to
+ *        ``end - 1`` and restores the heap property on ``[begin, end - 1)``
+ *
+ * @tparam BidirIt Iterator of type LegacyBidirectionalIterator
+ * @tparam Compare Strict weak ordering
+ * @param begin Start of range
+ * @param end One-past-end of range
+ * @param cmp Comparison object
+ */
+template <typename BidirIt, typename Compare = std::less<>>
+    requires std::bidirectional_iterator<BidirIt>
+void popHeap(BidirIt begin, BidirIt end, Compare cmp = Compare{})
+{
+    using Diff     = DiffType<BidirIt>;
+    Diff heap_size = std::distance(begin, end);
+
+    if (heap_size > 1)
+    {
+        std::iter_swap(begin, std::prev(end));
+        internal::heapify(begin, heap_size - 1, 0, cmp);
+        ERR_ASSERT_EXPENSIVE_m(isHeap(begin, std::prev(end), cmp),
+                               "popHeap() requires [begin, end) to be a heap");
     }
 }
 }  // namespace heaps
@@ -146,6 +146,70 @@ TEST(heaps, makeHeap1)
     }
 }
 
+/**
+ * @brief Verifies that ``isHeap()`` handles empty and single element ranges
+ */
+TEST(heaps, isHeap4)
+{
+    std::list<int> empty;
+    ASSERT_TRUE(foundation::heaps::isHeap(empty.begin(), empty.end()));
+
+    std::vector<int> single{1};
+    ASSERT_TRUE(foundation::heaps::isHeap(single.begin(), single.end()));
+}
+
+/**
+ * @brief Verifies that ``isHeapUntil()`` returns the first violating child
+ *        for both the serial and the block-wise path
+ */
+TEST(heaps, isHeapUntil)
+{
+    std::vector<int> data(1000);
+    std::iota(data.begin(), data.end(), 0);
+    std::reverse(data.begin(), data.end());
+
+    std::list<int> list(data.begin(), data.end());
+    ASSERT_EQ(foundation::heaps::isHeapUntil(data.begin(), data.end()),
+              data.end());
+    ASSERT_EQ(foundation::heaps::isHeapUntil(list.begin(), list.end()),
+              list.end());
+
+    for (int pos : {1, 2, 77, 500, 998, 999})
+    {
+        std::vector<int> broken{data};
+        broken[pos] = 2000;
+        std::list<int> broken_list(broken.begin(), broken.end());
+
+        auto until = foundation::heaps::isHeapUntil(broken.begin(),
+                                                    broken.end());
+        ASSERT_EQ(until, std::is_heap_until(broken.begin(), broken.end()));
+        ASSERT_EQ(std::distance(broken.begin(), until), pos);
+
+        auto list_until = foundation::heaps::isHeapUntil(broken_list.begin(),
+                                                         broken_list.end());
+        ASSERT_EQ(std::distance(broken_list.begin(), list_until), pos);
+    }
+}
+
+TEST(heaps, makeHeapParallel)
+{
+    std::vector<int> data(1 << 18);
+    std::generate(data.begin(), data.end(), std::rand);
+
+    std::vector<int> expected{data};
+    foundation::heaps::makeHeap(expected.begin(), expected.end());
+
+    for (std::size_t num_threads : {1, 3, 4})
+    {
+        std::vector<int> heap{data};
+        foundation::heaps::makeHeapParallel(heap.begin(), heap.end(),
+                                            std::less<>{}, num_threads);
+        ASSERT_TRUE(foundation::heaps::isHeap(heap.begin(), heap.end()));
+        ASSERT_TRUE(std::is_heap(heap.begin(), heap.end()));
+        ASSERT_EQ(heap, expected);
+    }
+}
+
 TEST(heaps, makeHeap2)
 {
     std::list<int> data1 = {8, 10, 11, 2, 3, 15, 16, 1, 20};
@@ -161,5 +225,31 @@ TEST(heaps, makeHeap2)
     }
 }
 
+TEST(heaps, pushHeap)
+{
+    std::vector<int> data;
+    for (int i = 0; i < 100; ++i)
+    {
+        data.push_back((i * 37) % 101);
+        pushHeap(data.begin(), data.end());
+        ASSERT_TRUE(isHeap(data.begin(), data.end()));
+    }
+}
+
+TEST(heaps, popHeap)
+{
+    std::vector<int> data(100);
+    std::iota(data.begin(), data.end(), 0);
+    makeHeap(data.begin(), data.end(), std::greater<>{});
+
+    for (int i = 0; i < 100; ++i)
+    {
+        popHeap(data.begin(), data.end(), std::greater<>{});
+        ASSERT_EQ(data.back(), i);
+        data.pop_back();
+        ASSERT_TRUE(isHeap(data.begin(), data.end(), std::greater<>{}));
+    }
+}
+
 }  // namespace heaps
 }  // namespace foundation
\ No newline at end of file
@@ -0,0 +1,94 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include "libfoundation/heaps/multiqueue.hpp"
+
+#include <memory>
+#include <mutex>
+#include <queue>
+
+#include <benchmark/benchmark.h>
+
+/* doc
+Each thread performs alternating push and pop operations on a queue that is
+shared between all threads and pre-filled so that pops rarely find it empty.
+The reported items/sec is the aggregate throughput of push and pop
+operations over all threads.
+*/
+
+static constexpr int kPrefill = 1 << 16;
+
+using IntMultiQueue = foundation::heaps::MultiQueue<int>;
+
+static std::unique_ptr<IntMultiQueue> multi_queue;
+
+template <IntMultiQueue::Choice choice>
+static void BMmultiQueuePushPop(benchmark::State& state)
+{
+    if (state.thread_index() == 0)
+    {
+        multi_queue =
+            std::make_unique<IntMultiQueue>(state.threads(), 2, choice);
+        for (int i = 0; i < kPrefill; ++i)
+        {
+            multi_queue->push(std::rand());
+        }
+    }
+
+    int value = state.thread_index();
+    for (auto _ : state)
+    {
+        multi_queue->push(value);
+        benchmark::DoNotOptimize(multi_queue->tryPop());
+        value += state.threads();
+    }
+    state.SetItemsProcessed(2 * state.iterations());
+
+    if (state.thread_index() == 0)
+    {
+        multi_queue.reset();
+    }
+}
+BENCHMARK_TEMPLATE(BMmultiQueuePushPop, IntMultiQueue::Choice::Random)
+    ->ThreadRange(1, 64)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BMmultiQueuePushPop, IntMultiQueue::Choice::TwoChoice)
+    ->ThreadRange(1, 64)
+    ->UseRealTime();
+
+/* doc
+Baseline: a single ``std::priority_queue`` behind a mutex.
+*/
+static std::mutex              locked_queue_mutex;
+static std::priority_queue<int> locked_queue;
+
+static void BMlockedQueuePushPop(benchmark::State& state)
+{
+    if (state.thread_index() == 0)
+    {
+        locked_queue = {};
+        for (int i = 0; i < kPrefill; ++i)
+        {
+            locked_queue.push(std::rand());
+        }
+    }
+
+    int value = state.thread_index();
+    for (auto _ : state)
+    {
+        {
+            std::lock_guard<std::mutex> lock(locked_queue_mutex);
+            locked_queue.push(value);
+        }
+        {
+            std::lock_guard<std::mutex> lock(locked_queue_mutex);
+            benchmark::DoNotOptimize(locked_queue.top());
+            locked_queue.pop();
+        }
+        value += state.threads();
+    }
+    state.SetItemsProcessed(2 * state.iterations());
+}
+BENCHMARK(BMlockedQueuePushPop)->ThreadRange(1, 64)->UseRealTime();
@@ -0,0 +1,278 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#ifndef MULTIQUEUE_HPP_
+#define MULTIQUEUE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <libfoundation/heaps/heaps.hpp>
+
+namespace foundation
+{
+namespace heaps
+{
+
+namespace internal
+{
+
+/**
+ * @brief Returns a pseudo random number from a per-thread xorshift
+ *        generator.
+ *
+ * The generator is seeded from the thread id so that threads do not pick
+ * the same sequence of sub-queues.
+ */
+inline std::uint64_t threadRandom()
+{
+    thread_local std::uint64_t state =
+        std::hash<std::thread::id>{}(std::this_thread::get_id()) |
+        std::uint64_t{1};
+
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+}  // namespace internal
+
+/**
+ * @brief A relaxed concurrent priority queue following the MultiQueue design.
+ *
+ * The queue is made of ``c * num_threads`` sequential max-heaps, each
+ * guarded by its own try-lock.  ``push`` inserts into a randomly chosen
+ * sub-queue, ``tryPop`` removes the top of a randomly chosen sub-queue, or
+ * with ``Choice::TwoChoice`` the larger of the tops of two randomly chosen
+ * sub-queues.  A thread never blocks on a busy sub-queue, it simply picks
+ * another one.
+ *
+ * Relaxed ordering guarantees:
+ *  - ``tryPop`` is not guaranteed to return the largest element in the
+ *    queue.  With ``Choice::TwoChoice`` the expected rank of the returned
+ *    element is ``O(num_queues())`` and its tail is exponentially small,
+ *    with ``Choice::Random`` the rank is only bounded by the size of the
+ *    sub-queues.
+ *  - Elements within one sub-queue are returned in heap order.  There is
+ *    no bound on how long an element waits: each ``tryPop`` samples its
+ *    sub-queue with probability about ``1 / num_queues()`` (``2 /
+ *    num_queues()`` with ``Choice::TwoChoice``), so the number of calls
+ *    until it is sampled is only geometrically distributed, and with
+ *    ``Choice::TwoChoice`` a sampled top may still lose to the other one.
+ *  - ``tryPop`` returns ``std::nullopt`` only after a sweep over all
+ *    sub-queues found them empty.  The sweep skips, without locking, every
+ *    sub-queue whose size reads 0 in a relaxed load, and locks the others
+ *    to check them.  A concurrent ``push`` may land behind the sweep or
+ *    in a sub-queue whose size was read before it, so an empty result is
+ *    not linearizable with concurrent pushes.
+ *  - ``size()`` and ``empty()`` are approximate while other threads are
+ *    modifying the queue.
+ *
+ * @tparam T Value type
+ * @tparam Compare Strict weak ordering, larger elements are popped first
+ */
+template <typename T, typename Compare = std::less<T>>
+class MultiQueue
+{
+ public:
+    /** @brief How ``tryPop`` selects the sub-queue to pop from */
+    enum class Choice
+    {
+        Random,
+        TwoChoice
+    };
+
+ private:
+    struct alignas(64) SubQueue
+    {
+        std::atomic_flag         lock_;
+        std::atomic<std::size_t> size_{0};
+        std::vector<T>           heap_;
+
+        bool tryLock()
+        {
+            return !lock_.test_and_set(std::memory_order_acquire);
+        }
+
+        void lock()
+        {
+            while (!tryLock())
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        void unlock() { lock_.clear(std::memory_order_release); }
+    };
+
+    std::size_t                 num_queues_;
+    std::unique_ptr<SubQueue[]> queues_;
+    Compare                     cmp_;
+    Choice                      choice_;
+
+    SubQueue& randomQueue()
+    {
+        return queues_[internal::threadRandom() % num_queues_];
+    }
+
+    T popLocked(SubQueue& q)
+    {
+        popHeap(q.heap_.begin(), q.heap_.end(), cmp_);
+        T out{std::move(q.heap_.back())};
+        q.heap_.pop_back();
+        q.size_.store(q.heap_.size(), std::memory_order_relaxed);
+        return out;
+    }
+
+ public:
+    /**
+     * @brief Creates an empty queue
+     *
+     * @param num_threads Number of threads expected to use the queue
+     * @param c Number of sub-queues per thread, must be at least 1
+     * @param choice Sub-queue selection policy for ``tryPop``
+     * @param cmp Comparison object
+     */
+    explicit MultiQueue(std::size_t num_threads,
+                        std::size_t c      = 2,
+                        Choice      choice = Choice::TwoChoice,
+                        Compare     cmp    = Compare{})
+        : num_queues_{std::max<std::size_t>(1, c * num_threads)},
+          queues_{std::make_unique<SubQueue[]>(num_queues_)},
+          cmp_{cmp},
+          choice_{choice}
+    {
+    }
+
+    MultiQueue(const MultiQueue&)            = delete;
+    MultiQueue& operator=(const MultiQueue&) = delete;
+
+    std::size_t numQueues() const { return num_queues_; }
+
+    Choice choice() const { return choice_; }
+
+    const Compare& cmp() const { return cmp_; }
+
+    /**
+     * @brief Inserts ``value`` into a randomly chosen sub-queue
+     */
+    void push(T value)
+    {
+        while (true)
+        {
+            SubQueue& q = randomQueue();
+            if (q.tryLock())
+            {
+                q.heap_.push_back(std::move(value));
+                pushHeap(q.heap_.begin(), q.heap_.end(), cmp_);
+                q.size_.store(q.heap_.size(), std::memory_order_relaxed);
+                q.unlock();
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief Removes an element close to the top of the queue
+     *
+     * @return The removed element, or ``std::nullopt`` if the queue was
+     *         found empty
+     */
+    std::optional<T> tryPop()
+    {
+        for (std::size_t attempt = 0; attempt < num_queues_; ++attempt)
+        {
+            SubQueue* qi = &randomQueue();
+            if (qi->size_.load(std::memory_order_relaxed) == 0)
+            {
+                continue;
+            }
+
+            SubQueue* qj = choice_ == Choice::TwoChoice ? &randomQueue() : qi;
+            if (qj != qi && qj->size_.load(std::memory_order_relaxed) == 0)
+            {
+                qj = qi;
+            }
+
+            if (!qi->tryLock())
+            {
+                continue;
+            }
+
+            if (qj != qi && !qj->tryLock())
+            {
+                qj = qi;
+            }
+
+            SubQueue* best = qi;
+            if (qj != qi)
+            {
+                if (qi->heap_.empty() ||
+                    (!qj->heap_.empty() &&
+                     cmp_(qi->heap_.front(), qj->heap_.front())))
+                {
+                    best = qj;
+                }
+                (best == qi ? qj : qi)->unlock();
+            }
+
+            if (!best->heap_.empty())
+            {
+                T out = popLocked(*best);
+                best->unlock();
+                return out;
+            }
+            best->unlock();
+        }
+
+        /* Random probing failed, sweep the sub-queues which do not read as empty */
+        for (std::size_t i = 0; i < num_queues_; ++i)
+        {
+            SubQueue& q = queues_[i];
+            if (q.size_.load(std::memory_order_relaxed) == 0)
+            {
+                continue;
+            }
+
+            q.lock();
+            if (!q.heap_.empty())
+            {
+                T out = popLocked(q);
+                q.unlock();
+                return out;
+            }
+            q.unlock();
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Approximate number of elements in the queue
+     */
+    std::size_t size() const
+    {
+        std::size_t out{0};
+        for (std::size_t i = 0; i < num_queues_; ++i)
+        {
+            out += queues_[i].size_.load(std::memory_order_relaxed);
+        }
+        return out;
+    }
+
+    bool empty() const { return size() == 0; }
+};
+
+}  // namespace heaps
+}  // namespace foundation
+
+#endif  // MULTIQUEUE_HPP_
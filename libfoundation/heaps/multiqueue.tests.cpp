@@ -0,0 +1,146 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include <libfoundation/heaps/multiqueue.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace foundation
+{
+namespace heaps
+{
+
+/**
+ * @brief With a single sub-queue the MultiQueue is an exact priority queue.
+ */
+TEST(MultiQueue, singleQueueIsExact)
+{
+    MultiQueue<int> queue(1, 1);
+    for (int i = 0; i < 100; ++i)
+    {
+        queue.push((i * 37) % 100);
+    }
+    ASSERT_EQ(queue.size(), 100);
+
+    for (int i = 99; i >= 0; --i)
+    {
+        auto val = queue.tryPop();
+        ASSERT_TRUE(val.has_value());
+        ASSERT_EQ(*val, i);
+    }
+    ASSERT_FALSE(queue.tryPop().has_value());
+    ASSERT_TRUE(queue.empty());
+}
+
+/**
+ * @brief Every pushed element is popped exactly once, for both policies.
+ */
+TEST(MultiQueue, drain)
+{
+    using Queue = MultiQueue<int>;
+    for (auto choice : {Queue::Choice::Random, Queue::Choice::TwoChoice})
+    {
+        Queue queue(4, 2, choice);
+        for (int i = 0; i < 1000; ++i)
+        {
+            queue.push(i);
+        }
+
+        std::vector<int> popped;
+        while (auto val = queue.tryPop())
+        {
+            popped.push_back(*val);
+        }
+        std::sort(popped.begin(), popped.end());
+
+        ASSERT_EQ(popped.size(), 1000);
+        for (int i = 0; i < 1000; ++i)
+        {
+            ASSERT_EQ(popped[i], i);
+        }
+    }
+}
+
+/**
+ * @brief Concurrent producers and consumers neither lose nor duplicate
+ *        elements.
+ */
+TEST(MultiQueue, concurrent)
+{
+    constexpr int num_threads = 4;
+    constexpr int per_thread  = 2000;
+
+    MultiQueue<int>   queue(num_threads);
+    std::atomic<int>  num_popped{0};
+    std::vector<int>  counts(num_threads * per_thread, 0);
+    std::atomic<bool> done_pushing{false};
+
+    std::vector<std::thread> producers;
+    for (int t = 0; t < num_threads; ++t)
+    {
+        producers.emplace_back(
+            [&, t]
+            {
+                for (int i = 0; i < per_thread; ++i)
+                {
+                    queue.push(t * per_thread + i);
+                }
+            });
+    }
+
+    std::vector<std::vector<int>> results(num_threads);
+    std::vector<std::thread>      consumers;
+    for (int t = 0; t < num_threads; ++t)
+    {
+        consumers.emplace_back(
+            [&, t]
+            {
+                while (true)
+                {
+                    auto val = queue.tryPop();
+                    if (val)
+                    {
+                        results[t].push_back(*val);
+                        ++num_popped;
+                    }
+                    else if (done_pushing.load())
+                    {
+                        break;
+                    }
+                }
+            });
+    }
+
+    for (auto& thread : producers) thread.join();
+    done_pushing.store(true);
+    for (auto& thread : consumers) thread.join();
+
+    while (auto val = queue.tryPop())
+    {
+        results[0].push_back(*val);
+        ++num_popped;
+    }
+
+    ASSERT_EQ(num_popped.load(), num_threads * per_thread);
+    for (const auto& result : results)
+    {
+        for (int val : result)
+        {
+            ++counts[val];
+        }
+    }
+    for (int count : counts)
+    {
+        ASSERT_EQ(count, 1);
+    }
+}
+
+}  // namespace heaps
+}  // namespace foundation
@@ -0,0 +1,255 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#ifndef TOPK_HPP_
+#define TOPK_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <libfoundation/core/assertions.hpp>
+#include <libfoundation/heaps/heaps.hpp>
+
+namespace foundation
+{
+namespace heaps
+{
+
+/**
+ * @brief Value of the ``K`` template parameter of ``TopK`` selecting a ``k``
+ *        given at runtime.
+ */
+inline constexpr std::size_t dynamicK =
+    std::numeric_limits<std::size_t>::max();
+
+/**
+ * @brief Keeps the ``k`` largest elements, with respect to ``Compare``, of an
+ *        unbounded stream.
+ *
+ * Two strategies are available:
+ *  - ``Strategy::Heap`` keeps a bounded heap whose root is the smallest of
+ *    the retained elements.  Once ``k`` elements are held, an element that
+ *    cannot enter is rejected with a single comparison against the root.
+ *  - ``Strategy::Select`` appends to a buffer of up to ``2k`` elements.  When
+ *    the buffer is full a linear time selection keeps the best ``k`` and
+ *    their smallest element becomes the rejection threshold.  The amortized
+ *    cost per accepted element is ``O(1)`` rather than ``O(log k)``.
+ *
+ * In both cases memory is ``O(k)`` and the cost per rejected element is one
+ * comparison.
+ *
+ * @tparam T Value type
+ * @tparam K Number of elements to keep, or ``dynamicK`` for a runtime ``k``
+ * @tparam Compare Strict weak ordering, larger elements are kept
+ */
+template <typename T,
+          std::size_t K    = dynamicK,
+          typename Compare = std::less<T>>
+class TopK
+{
+ public:
+    enum class Strategy
+    {
+        Heap,
+        Select
+    };
+
+ private:
+    /* doc
+    Reversing the comparison turns the max-heap primitives of heaps.hpp into
+    a min-heap, so that the root is the weakest retained element.
+    */
+    struct Reversed
+    {
+        Compare cmp_;
+        bool    operator()(const T& a, const T& b) const { return cmp_(b, a); }
+    };
+
+    std::size_t    k_;
+    Strategy       strategy_;
+    Compare        cmp_;
+    std::vector<T> buffer_;
+    bool           has_threshold_{false};
+
+    /* doc
+    Keeps the best k elements of the buffer in [0, k), the weakest of which
+    ends up at k - 1 and becomes the threshold.
+    */
+    void select()
+    {
+        auto kth = std::next(buffer_.begin(), k_ - 1);
+        std::nth_element(buffer_.begin(), kth, buffer_.end(), Reversed{cmp_});
+        buffer_.resize(k_);
+        has_threshold_ = true;
+    }
+
+    void insertHeap(const T& value)
+    {
+        if (buffer_.size() < k_)
+        {
+            buffer_.push_back(value);
+            pushHeap(buffer_.begin(), buffer_.end(), Reversed{cmp_});
+        }
+        else if (cmp_(buffer_.front(), value))
+        {
+            buffer_.front() = value;
+            internal::heapify(buffer_.begin(), buffer_.size(), 0,
+                              Reversed{cmp_});
+        }
+    }
+
+    void insertSelect(const T& value)
+    {
+        if (has_threshold_ && !cmp_(buffer_[k_ - 1], value))
+        {
+            return;
+        }
+
+        buffer_.push_back(value);
+        if (buffer_.size() == 2 * k_)
+        {
+            select();
+        }
+    }
+
+ public:
+    /**
+     * @brief Creates an empty selector with a compile time ``k``
+     */
+    explicit TopK(Strategy strategy = Strategy::Heap, Compare cmp = Compare{})
+        requires(K != dynamicK)
+        : k_{K}, strategy_{strategy}, cmp_{cmp}
+    {
+        static_assert(K > 0, "TopK requires K > 0");
+        buffer_.reserve(strategy_ == Strategy::Heap ? k_ : 2 * k_);
+    }
+
+    /**
+     * @brief Creates an empty selector with a runtime ``k``
+     *
+     * @param k Number of elements to keep, must be positive
+     * @param strategy Selection strategy
+     * @param cmp Comparison object
+     */
+    explicit TopK(std::size_t k,
+                  Strategy    strategy = Strategy::Heap,
+                  Compare     cmp      = Compare{})
+        requires(K == dynamicK)
+        : k_{k}, strategy_{strategy}, cmp_{cmp}
+    {
+        ERR_ASSERT_THROW_INVARG_m(k > 0, "TopK requires k > 0");
+        buffer_.reserve(strategy_ == Strategy::Heap ? k_ : 2 * k_);
+    }
+
+    std::size_t k() const
+    {
+        if constexpr (K == dynamicK)
+        {
+            return k_;
+        }
+        else
+        {
+            return K;
+        }
+    }
+
+    Strategy strategy() const { return strategy_; }
+
+    const Compare& cmp() const { return cmp_; }
+
+    /**
+     * @brief Number of retained elements, at most ``k()``
+     */
+    std::size_t size() const { return std::min(buffer_.size(), k()); }
+
+    /**
+     * @brief Offers a single element
+     */
+    void insert(const T& value)
+    {
+        if (strategy_ == Strategy::Heap)
+        {
+            insertHeap(value);
+        }
+        else
+        {
+            insertSelect(value);
+        }
+    }
+
+    /**
+     * @brief Offers every element of ``[first, last)``
+     *
+     * The strategy is dispatched once per batch rather than once per element.
+     */
+    template <typename InputIt>
+        requires std::input_iterator<InputIt>
+    void insert(InputIt first, InputIt last)
+    {
+        if (strategy_ == Strategy::Heap)
+        {
+            for (; first != last; ++first) insertHeap(*first);
+        }
+        else
+        {
+            for (; first != last; ++first) insertSelect(*first);
+        }
+    }
+
+    /**
+     * @brief Removes all retained elements
+     */
+    void clear()
+    {
+        buffer_.clear();
+        has_threshold_ = false;
+    }
+
+    /**
+     * @brief Returns the retained elements, largest first, and clears the
+     *        selector.
+     */
+    std::vector<T> finish()
+    {
+        if (strategy_ == Strategy::Select && buffer_.size() > k_)
+        {
+            select();
+        }
+
+        if (strategy_ == Strategy::Heap)
+        {
+            /* doc
+            Repeatedly popping the min-heap moves the weakest element to the
+            back, which leaves the range sorted largest first.
+            */
+            for (auto last = buffer_.end(); last != buffer_.begin(); --last)
+            {
+                popHeap(buffer_.begin(), last, Reversed{cmp_});
+            }
+        }
+        else
+        {
+            std::sort(buffer_.begin(), buffer_.end(), Reversed{cmp_});
+        }
+
+        std::vector<T> out;
+        out.swap(buffer_);
+        clear();
+        buffer_.reserve(strategy_ == Strategy::Heap ? k_ : 2 * k_);
+        return out;
+    }
+};
+
+}  // namespace heaps
+}  // namespace foundation
+
+#endif  // TOPK_HPP_
@@ -0,0 +1,107 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include <libfoundation/heaps/topk.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <numeric>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace foundation
+{
+namespace heaps
+{
+
+/**
+ * @brief Both strategies agree with a full sort of the stream.
+ */
+TEST(TopK, matchesSort)
+{
+    std::vector<int> stream(10000);
+    std::generate(stream.begin(), stream.end(), std::rand);
+
+    std::vector<int> expected{stream};
+    std::sort(expected.begin(), expected.end(), std::greater<>{});
+    expected.resize(25);
+
+    using Top = TopK<int>;
+    for (auto strategy : {Top::Strategy::Heap, Top::Strategy::Select})
+    {
+        Top top(25, strategy);
+        for (int val : stream)
+        {
+            top.insert(val);
+        }
+        ASSERT_EQ(top.size(), 25);
+        ASSERT_EQ(top.finish(), expected);
+        ASSERT_EQ(top.size(), 0);
+    }
+}
+
+/**
+ * @brief A compile time ``K``, a custom comparison and a batched insert.
+ */
+TEST(TopK, staticK)
+{
+    std::vector<int> stream(100);
+    std::iota(stream.begin(), stream.end(), 0);
+    std::reverse(stream.begin(), stream.end());
+
+    TopK<int, 5, std::greater<int>> top(
+        TopK<int, 5, std::greater<int>>::Strategy::Select);
+    top.insert(stream.begin(), stream.end());
+
+    std::vector<int> expected{0, 1, 2, 3, 4};
+    ASSERT_EQ(top.k(), 5);
+    ASSERT_EQ(top.finish(), expected);
+}
+
+/**
+ * @brief Fewer elements than ``k`` are all retained.
+ */
+TEST(TopK, short)
+{
+    TopK<int> top(10);
+    top.insert(3);
+    top.insert(1);
+    top.insert(2);
+
+    std::vector<int> expected{3, 2, 1};
+    ASSERT_EQ(top.finish(), expected);
+}
+
+TEST(TopK, invalidK)
+{
+    ASSERT_THROW(TopK<int>(0), std::invalid_argument);
+}
+
+/**
+ * @brief On a random stream the heap strategy costs close to one comparison
+ *        per element.
+ */
+TEST(TopK, comparisons)
+{
+    std::size_t num_cmp{0};
+    auto        cmp = [&num_cmp](int a, int b)
+    {
+        ++num_cmp;
+        return a < b;
+    };
+
+    std::vector<int> stream(100000);
+    std::generate(stream.begin(), stream.end(), std::rand);
+
+    TopK<int, dynamicK, decltype(cmp)> top(10, decltype(top)::Strategy::Heap,
+                                           cmp);
+    top.insert(stream.begin(), stream.end());
+    ASSERT_LT(num_cmp, stream.size() * 11 / 10);
+}
+
+}  // namespace heaps
+}  // namespace foundation
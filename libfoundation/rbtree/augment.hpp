@@ -0,0 +1,86 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#ifndef AUGMENT_HPP_
+#define AUGMENT_HPP_
+
+#include <concepts>
+#include <cstddef>
+
+namespace foundation {
+namespace rbree {
+
+    //--------------------------------------------------------------------------------------------//
+    //                                    Augmentation policies                                   //
+    //--------------------------------------------------------------------------------------------//
+    /*
+        An augmentation policy tells RBtree what to store in every node on top of
+        the value. The stored value of a node is the fold of its subtree,
+
+            combine(combine(left, lift(value)), right),
+
+        where combine is associative with identity() as its neutral element, so it
+        can be kept up to date by recomputing a node from its two children. The tree
+        does that on the way back up after insert and erase and for the two nodes
+        of every rotation.
+
+        A policy which also provides count() turns the subtree folds into subtree
+        sizes, and enables rank() and select() on the tree.
+    */
+    template <typename Policy, typename T>
+    concept AugmentPolicy = requires(const T& value, const typename Policy::value_type& a)
+    {
+        {Policy::enabled} -> std::convertible_to<bool>;
+        {Policy::identity()} -> std::convertible_to<typename Policy::value_type>;
+        {Policy::lift(value)} -> std::convertible_to<typename Policy::value_type>;
+        {Policy::combine(a, a)} -> std::convertible_to<typename Policy::value_type>;
+    };
+
+    template <typename Policy>
+    concept CountingPolicy = requires(const typename Policy::value_type& a)
+    {
+        {Policy::count(a)} -> std::convertible_to<std::size_t>;
+    };
+
+    /*
+        The default policy, nodes carry nothing and no work is done.
+    */
+    struct NoAugment
+    {
+        struct value_type {};
+
+        static constexpr bool enabled = false;
+
+        static value_type identity() {return {};};
+
+        template <typename T>
+        static value_type lift(const T&) {return {};};
+
+        static value_type combine(value_type, value_type) {return {};};
+    };
+
+    /*
+        Keeps the number of values in every subtree, for order statistics.
+    */
+    struct SubtreeSize
+    {
+        using value_type = std::size_t;
+
+        static constexpr bool enabled = true;
+
+        static value_type identity() {return 0;};
+
+        template <typename T>
+        static value_type lift(const T&) {return 1;};
+
+        static value_type combine(value_type a, value_type b) {return a + b;};
+
+        static std::size_t count(value_type a) {return a;};
+    };
+
+}
+}
+
+#endif  // AUGMENT_HPP_
@@ -0,0 +1,295 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#ifndef FROZEN_HPP_
+#define FROZEN_HPP_
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <libfoundation/core/assertions.hpp>
+
+namespace foundation {
+namespace rbree {
+
+    //--------------------------------------------------------------------------------------------//
+    //                                      class FrozenTree                                      //
+    //--------------------------------------------------------------------------------------------//
+    /*
+        An immutable ordered set in Eytzinger layout, as returned by RBtree::freeze().
+
+        The values are stored in one array in the breadth first order of a complete
+        binary search tree: the root at index 1 and the children of k at 2k and
+        2k + 1. A search only does arithmetic on indices, the comparison result is
+        added to the index rather than branched on, and the top levels share a few
+        cache lines which stay hot across searches.
+
+        The descendants of k four levels down are contiguous, 16 values starting at
+        16k, so the search prefetches the cache line holding them while it works
+        its way down the four levels in between.
+
+        Iterators are array indices with 0 as end(), in order traversal steps
+        through the implicit tree with a few shifts.
+    */
+    template <typename T, typename Compare = std::less<T>>
+    class FrozenTree
+    {
+        private:
+
+        /* index distance of the descendants prefetched ahead of the search */
+        static constexpr std::size_t PREFETCH_STRIDE = 16;
+
+        std::vector<T> data_;
+        std::size_t size_{0};
+        Compare cmp_;
+
+        template <typename ForwardIt>
+        void fill(ForwardIt& first, std::size_t k)
+        {
+            if (k > size_)
+                return;
+            fill(first, 2 * k);
+            data_[k] = *first;
+            ++first;
+            fill(first, 2 * k + 1);
+        }
+
+        void prefetchAhead(std::size_t k) const
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            __builtin_prefetch(data_.data() + std::min(k * PREFETCH_STRIDE, size_));
+#endif
+        }
+
+        /* the index after k in order, or 0 */
+        std::size_t next(std::size_t k) const
+        {
+            if (2 * k + 1 <= size_)
+            {
+                k = 2 * k + 1;
+                while (2 * k <= size_)
+                    k = 2 * k;
+                return k;
+            }
+            // climb while k is a right child, then once more
+            return k >> (std::countr_one(k) + 1);
+        }
+
+        /* the index before k in order, or 0; the index before 0 is the last one */
+        std::size_t prev(std::size_t k) const
+        {
+            if (k == 0)
+            {
+                k = size_ == 0 ? 0 : 1;
+                while (k && 2 * k + 1 <= size_)
+                    k = 2 * k + 1;
+                return k;
+            }
+            if (2 * k <= size_)
+            {
+                k = 2 * k;
+                while (2 * k + 1 <= size_)
+                    k = 2 * k + 1;
+                return k;
+            }
+            return k >> (std::countr_zero(k) + 1);
+        }
+
+        public:
+
+        /*
+            A bidirectional iterator over the values in order.
+        */
+        class Iterator
+        {
+            private:
+
+            const FrozenTree* tree_{nullptr};
+            std::size_t k_{0};
+
+            public:
+
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const T*;
+            using reference = const T&;
+
+            Iterator() = default;
+
+            Iterator(const FrozenTree* tree, std::size_t k) : tree_{tree}, k_{k} {}
+
+            /* position in the Eytzinger array */
+            std::size_t index() const {return k_;};
+
+            reference operator*() const {return tree_->data_[k_];};
+
+            pointer operator->() const {return &tree_->data_[k_];};
+
+            Iterator& operator++()
+            {
+                k_ = tree_->next(k_);
+                return *this;
+            }
+
+            Iterator operator++(int)
+            {
+                Iterator out = *this;
+                ++*this;
+                return out;
+            }
+
+            Iterator& operator--()
+            {
+                k_ = tree_->prev(k_);
+                return *this;
+            }
+
+            Iterator operator--(int)
+            {
+                Iterator out = *this;
+                --*this;
+                return out;
+            }
+
+            bool operator==(const Iterator& other) const {return k_ == other.k_;};
+        };
+
+        using iterator = Iterator;
+        using const_iterator = Iterator;
+
+        FrozenTree() : data_(1) {}
+
+        /*
+            Builds the layout from [first, last), which must be strictly
+            increasing, in linear time.
+        */
+        template <std::forward_iterator ForwardIt>
+        FrozenTree(ForwardIt first, ForwardIt last, Compare cmp = Compare{}) : cmp_{cmp}
+        {
+            ERR_ASSERT_THROW_INVARG_m(
+                std::adjacent_find(first, last, [&](const T& a, const T& b) {return !cmp_(a, b);}) == last,
+                "FrozenTree requires strictly increasing values");
+
+            size_ = std::distance(first, last);
+            data_.resize(size_ + 1);
+            fill(first, 1);
+        }
+
+        std::size_t size() const {return size_;};
+
+        bool empty() const {return size_ == 0;};
+
+        const Compare& cmp() const {return cmp_;};
+
+        /* the values in Eytzinger order, index 0 is unused */
+        const std::vector<T>& data() const {return data_;};
+
+        Iterator begin() const
+        {
+            std::size_t k = size_ == 0 ? 0 : 1;
+            while (k && 2 * k <= size_)
+                k = 2 * k;
+            return {this, k};
+        }
+
+        Iterator end() const {return {this, 0};};
+
+        /*
+            Returns the first value not less than value, or end().
+        */
+        Iterator lowerBound(const T& value) const
+        {
+            std::size_t k = 1;
+            while (k <= size_)
+            {
+                prefetchAhead(k);
+                k = 2 * k + static_cast<std::size_t>(cmp_(data_[k], value));
+            }
+            // undo the right turns taken after the last left turn, and that one
+            return {this, k >> (std::countr_one(k) + 1)};
+        }
+
+        /*
+            Returns the first value greater than value, or end().
+        */
+        Iterator upperBound(const T& value) const
+        {
+            std::size_t k = 1;
+            while (k <= size_)
+            {
+                prefetchAhead(k);
+                k = 2 * k + static_cast<std::size_t>(!cmp_(value, data_[k]));
+            }
+            return {this, k >> (std::countr_one(k) + 1)};
+        }
+
+        std::pair<Iterator, Iterator> equalRange(const T& value) const
+        {
+            Iterator first = lowerBound(value);
+            Iterator last = first;
+            if (last != end() && !cmp_(value, *last))
+                ++last;
+            return {first, last};
+        }
+
+        /*
+            Returns the value equivalent to value, or nullptr.
+        */
+        const T* search(const T& value) const
+        {
+            Iterator it = lowerBound(value);
+            if (it == end() || cmp_(value, *it))
+                return nullptr;
+            return &*it;
+        }
+
+        Iterator find(const T& value) const
+        {
+            Iterator it = lowerBound(value);
+            return it == end() || cmp_(value, *it) ? end() : it;
+        }
+
+        bool contains(const T& value) const
+        {
+            return search(value) != nullptr;
+        }
+
+        /*
+            Calls visitor on every value in [lo, hi) in order and returns the number
+            of values visited. If the visitor returns bool, the scan stops after it
+            returns false.
+        */
+        template <typename Visitor>
+        std::size_t rangeScan(const T& lo, const T& hi, Visitor&& visitor) const
+        {
+            std::size_t num_visited{0};
+            for (std::size_t k = lowerBound(lo).index(); k != 0 && cmp_(data_[k], hi); k = next(k))
+            {
+                ++num_visited;
+                if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, const T&>, bool>)
+                {
+                    if (!visitor(std::as_const(data_[k])))
+                        break;
+                }
+                else
+                {
+                    visitor(std::as_const(data_[k]));
+                }
+            }
+            return num_visited;
+        }
+    };
+
+}
+}
+
+#endif  // FROZEN_HPP_
@@ -0,0 +1,133 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <set>
+#include <stdexcept>
+#include <vector>
+#include <libfoundation/rbtree/rbtree.hpp>
+
+#include <gtest/gtest.h>
+
+namespace foundation {
+namespace rbree {
+
+/* the values of a frozen tree, walked forward and backward */
+template <typename T, typename Compare>
+static void checkOrder(const FrozenTree<T, Compare>& frozen, const std::vector<T>& expected)
+{
+    ASSERT_EQ(frozen.size(), expected.size());
+    ASSERT_EQ(std::vector<T>(frozen.begin(), frozen.end()), expected);
+
+    std::vector<T> backward;
+    for (auto it = frozen.end(); it != frozen.begin();)
+        backward.push_back(*--it);
+    ASSERT_EQ(std::vector<T>(backward.rbegin(), backward.rend()), expected);
+}
+
+TEST(FrozenTreeTests, layout)
+{
+    // every size up to a few complete levels, so that all shapes of the last level occur
+    for (int n = 0; n < 70; ++n)
+    {
+        RBtree<int> tree;
+        std::vector<int> expected;
+        for (int i = 0; i < n; ++i)
+        {
+            tree.insert(2 * i);
+            expected.push_back(2 * i);
+        }
+
+        auto frozen = tree.freeze();
+        checkOrder(frozen, expected);
+        ASSERT_EQ(frozen.empty(), n == 0);
+
+        for (int i = -1; i <= 2 * n; ++i)
+        {
+            auto lower = std::lower_bound(expected.begin(), expected.end(), i);
+            auto upper = std::upper_bound(expected.begin(), expected.end(), i);
+            auto it = frozen.lowerBound(i);
+            if (lower == expected.end())
+                ASSERT_EQ(it, frozen.end());
+            else
+                ASSERT_EQ(*it, *lower);
+            it = frozen.upperBound(i);
+            if (upper == expected.end())
+                ASSERT_EQ(it, frozen.end());
+            else
+                ASSERT_EQ(*it, *upper);
+
+            ASSERT_EQ(frozen.contains(i), i % 2 == 0 && i < 2 * n);
+            ASSERT_EQ(frozen.find(i) != frozen.end(), frozen.contains(i));
+            auto [first, last] = frozen.equalRange(i);
+            ASSERT_EQ(std::distance(first, last), frozen.contains(i) ? 1 : 0);
+        }
+    }
+}
+
+TEST(FrozenTreeTests, matchesTree)
+{
+    RBtree<int, std::greater<int>> tree;
+    std::set<int, std::greater<int>> reference;
+    for (int i = 0; i < 5000; ++i)
+    {
+        int value = std::rand() % 20000;
+        tree.insert(value);
+        reference.insert(value);
+    }
+    auto frozen = tree.freeze();
+    checkOrder(frozen, std::vector<int>(reference.begin(), reference.end()));
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        int value = std::rand() % 20100 - 50;
+        const int* found = frozen.search(value);
+        ASSERT_EQ(found != nullptr, reference.contains(value));
+        if (found)
+        {
+            ASSERT_EQ(*found, value);
+        }
+        ASSERT_EQ(frozen.search(value) != nullptr, tree.search(value) != tree.nil());
+    }
+}
+
+TEST(FrozenTreeTests, rangeScan)
+{
+    RBtree<int> tree;
+    for (int i = 0; i < 1000; ++i)
+        tree.insert(std::rand() % 5000);
+    auto frozen = tree.freeze();
+
+    for (int i = 0; i < 200; ++i)
+    {
+        int lo = std::rand() % 5100 - 50;
+        int hi = lo + std::rand() % 300;
+
+        std::vector<int> expected;
+        tree.rangeScan(lo, hi, [&](int value) {expected.push_back(value);});
+
+        std::vector<int> found;
+        ASSERT_EQ(frozen.rangeScan(lo, hi, [&](int value) {found.push_back(value);}), expected.size());
+        ASSERT_EQ(found, expected);
+    }
+
+    // a visitor returning false stops the scan
+    std::vector<int> found;
+    frozen.rangeScan(0, 5000, [&](int value) {found.push_back(value); return found.size() < 3;});
+    ASSERT_EQ(found, std::vector<int>(tree.begin(), std::next(tree.begin(), 3)));
+}
+
+TEST(FrozenTreeTests, unsorted)
+{
+    std::vector<int> values{1, 3, 2};
+    ASSERT_THROW((FrozenTree<int>(values.begin(), values.end())), std::invalid_argument);
+    values = {1, 1};
+    ASSERT_THROW((FrozenTree<int>(values.begin(), values.end())), std::invalid_argument);
+}
+
+}
+}
@@ -0,0 +1,234 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#ifndef INTERVAL_HPP_
+#define INTERVAL_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include <libfoundation/core/assertions.hpp>
+#include <libfoundation/rbtree/rbtree.hpp>
+
+namespace foundation {
+namespace rbree {
+
+    /*
+        The half-open interval [lo_, hi_). An empty query interval overlaps
+        nothing.
+    */
+    template <typename T>
+    struct Interval
+    {
+        T lo_;
+        T hi_;
+
+        bool overlaps(const T& lo, const T& hi) const
+        {
+            return lo < hi && lo_ < hi && lo < hi_;
+        }
+
+        bool contains(const T& point) const
+        {
+            return !(point < lo_) && point < hi_;
+        }
+
+        bool operator==(const Interval&) const = default;
+    };
+
+    /* orders intervals by their lower, then their upper end */
+    struct IntervalLess
+    {
+        template <typename T>
+        bool operator()(const Interval<T>& a, const Interval<T>& b) const
+        {
+            return a.lo_ < b.lo_ || (!(b.lo_ < a.lo_) && a.hi_ < b.hi_);
+        }
+    };
+
+    /*
+        Augmentation keeping the largest upper end in every subtree.
+    */
+    template <typename T>
+    struct MaxEnd
+    {
+        using value_type = T;
+
+        static constexpr bool enabled = true;
+
+        static value_type identity() {return std::numeric_limits<T>::lowest();};
+
+        static value_type lift(const Interval<T>& interval) {return interval.hi_;};
+
+        static value_type combine(const value_type& a, const value_type& b) {return std::max(a, b);};
+    };
+
+    //--------------------------------------------------------------------------------------------//
+    //                                     class IntervalTree                                     //
+    //--------------------------------------------------------------------------------------------//
+    /*
+        A set of half-open intervals answering overlap queries (CLRS, chapter 14.3).
+
+        The intervals are kept in an RBtree ordered by their lower end, augmented
+        with the largest upper end of every subtree, which the tree maintains
+        through rotations and rebalancing. A subtree whose largest upper end is
+        not past the lower end of a query cannot hold an overlap and is skipped,
+        as is everything right of a node starting after the query. A query
+        reporting k intervals visits O(log n) nodes when k is 0 and at most
+        O(log n) nodes per reported interval otherwise, typically much less.
+
+        Stored intervals must not be empty, equal intervals are stored once.
+    */
+    template <typename T>
+    class IntervalTree
+    {
+        public:
+
+        using Tree = RBtree<Interval<T>, IntervalLess, MaxEnd<T>>;
+        using node_type = typename Tree::node_type;
+
+        private:
+
+        Tree tree_;
+
+        /*
+            Reports the intervals in the subtree of x for which starts_before holds
+            and whose upper end is past lo. Returns false once the visitor asked to
+            stop.
+        */
+        template <typename StartsBefore, typename Visitor>
+        bool visit(node_type* x, const T& lo, StartsBefore&& starts_before,
+                   Visitor& visitor, std::size_t& num_visited) const
+        {
+            while (x != tree_.nil() && lo < x->aug_)
+            {
+                if (!visit(x->l_, lo, starts_before, visitor, num_visited))
+                    return false;
+                if (!starts_before(x->data_))
+                    return true;
+                if (lo < x->data_.hi_)
+                {
+                    ++num_visited;
+                    if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, const Interval<T>&>, bool>)
+                    {
+                        if (!visitor(std::as_const(x->data_)))
+                            return false;
+                    }
+                    else
+                    {
+                        visitor(std::as_const(x->data_));
+                    }
+                }
+                x = x->r_;
+            }
+            return true;
+        }
+
+        public:
+
+        IntervalTree() = default;
+
+        explicit IntervalTree(std::pmr::memory_resource* resource) : tree_(resource) {}
+
+        const Tree& tree() const {return tree_;};
+
+        std::size_t size() const {return tree_.size();};
+
+        bool empty() const {return tree_.empty();};
+
+        auto begin() const {return tree_.begin();};
+
+        auto end() const {return tree_.end();};
+
+        /*
+            Inserts [lo, hi), returns false if it was already present.
+        */
+        bool insert(const T& lo, const T& hi)
+        {
+            ERR_ASSERT_THROW_INVARG_m(lo < hi, "interval must not be empty");
+            return tree_.insert({lo, hi}).second;
+        }
+
+        /*
+            Removes [lo, hi), returns the number of removed intervals.
+        */
+        std::size_t erase(const T& lo, const T& hi)
+        {
+            return tree_.erase({lo, hi});
+        }
+
+        void clear()
+        {
+            tree_.clear();
+        }
+
+        /*
+            Returns an interval overlapping [lo, hi) if there is one, in O(log n).
+        */
+        std::optional<Interval<T>> findAnyOverlap(const T& lo, const T& hi) const
+        {
+            if (!(lo < hi))
+                return std::nullopt;
+
+            node_type* x = tree_.root();
+            while (x != tree_.nil() && !x->data_.overlaps(lo, hi))
+            {
+                if (x->l_ != tree_.nil() && lo < x->l_->aug_)
+                    x = x->l_;
+                else
+                    x = x->r_;
+            }
+            if (x == tree_.nil())
+                return std::nullopt;
+            return x->data_;
+        }
+
+        /*
+            Calls visitor on every interval overlapping [lo, hi), ordered by lower
+            end, and returns the number of intervals visited. If the visitor returns
+            bool, the query stops after it returns false.
+        */
+        template <typename Visitor>
+        std::size_t forEachOverlap(const T& lo, const T& hi, Visitor&& visitor) const
+        {
+            std::size_t num_visited{0};
+            if (lo < hi)
+            {
+                visit(tree_.root(), lo,
+                      [&](const Interval<T>& x) {return x.lo_ < hi;},
+                      visitor, num_visited);
+            }
+            return num_visited;
+        }
+
+        /*
+            Calls visitor on every interval containing point, ordered by lower end,
+            and returns the number of intervals visited.
+        */
+        template <typename Visitor>
+        std::size_t forEachContaining(const T& point, Visitor&& visitor) const
+        {
+            std::size_t num_visited{0};
+            visit(tree_.root(), point,
+                  [&](const Interval<T>& x) {return !(point < x.lo_);},
+                  visitor, num_visited);
+            return num_visited;
+        }
+
+        /* number of intervals containing point */
+        std::size_t countContaining(const T& point) const
+        {
+            return forEachContaining(point, [](const Interval<T>&) {});
+        }
+    };
+
+}
+}
+
+#endif  // INTERVAL_HPP_
@@ -0,0 +1,115 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+#include <utility>
+#include <vector>
+#include <libfoundation/rbtree/interval.hpp>
+
+#include <gtest/gtest.h>
+
+namespace foundation {
+namespace rbree {
+
+using Reference = std::set<std::pair<int, int>>;
+
+static std::vector<Interval<int>> overlapping(const Reference& reference, int lo, int hi)
+{
+    std::vector<Interval<int>> out;
+    for (auto [l, h] : reference)
+        if (Interval<int>{l, h}.overlaps(lo, hi))
+            out.push_back({l, h});
+    return out;
+}
+
+/* random intervals of length up to 50 in [0, 10000) */
+static void fill(IntervalTree<int>& tree, Reference& reference, int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        int lo = std::rand() % 10000;
+        int hi = lo + 1 + std::rand() % 50;
+        ASSERT_EQ(tree.insert(lo, hi), reference.insert({lo, hi}).second);
+    }
+}
+
+TEST(IntervalTreeTests, forEachOverlap)
+{
+    IntervalTree<int> tree;
+    Reference reference;
+    fill(tree, reference, 5000);
+
+    // erase a third so that rebalancing after erase is covered as well
+    for (int i = 0; i < 1500; ++i)
+    {
+        auto it = std::next(reference.begin(), std::rand() % reference.size());
+        ASSERT_EQ(tree.erase(it->first, it->second), 1);
+        reference.erase(it);
+    }
+    ASSERT_EQ(tree.size(), reference.size());
+
+    for (int i = 0; i < 500; ++i)
+    {
+        int lo = std::rand() % 10100 - 50;
+        int hi = lo + std::rand() % 200;
+
+        std::vector<Interval<int>> found;
+        std::size_t num_found = tree.forEachOverlap(lo, hi, [&](const Interval<int>& x) {found.push_back(x);});
+
+        auto expected = overlapping(reference, lo, hi);
+        ASSERT_EQ(found, expected);
+        ASSERT_EQ(num_found, expected.size());
+
+        auto any = tree.findAnyOverlap(lo, hi);
+        ASSERT_EQ(any.has_value(), !expected.empty());
+        if (any)
+        {
+            ASSERT_TRUE(any->overlaps(lo, hi));
+        }
+    }
+}
+
+TEST(IntervalTreeTests, stabbing)
+{
+    IntervalTree<int> tree;
+    Reference reference;
+    fill(tree, reference, 3000);
+
+    for (int point = -10; point < 10060; point += 7)
+    {
+        std::vector<Interval<int>> found;
+        tree.forEachContaining(point, [&](const Interval<int>& x) {found.push_back(x);});
+        ASSERT_EQ(found, overlapping(reference, point, point + 1));
+        ASSERT_EQ(tree.countContaining(point), found.size());
+    }
+}
+
+TEST(IntervalTreeTests, edges)
+{
+    IntervalTree<int> tree;
+    ASSERT_FALSE(tree.findAnyOverlap(0, 10).has_value());
+    ASSERT_THROW(tree.insert(5, 4), std::invalid_argument);
+    ASSERT_THROW(tree.insert(5, 5), std::invalid_argument);
+
+    tree.insert(0, 10);
+    tree.insert(20, 30);
+    ASSERT_FALSE(tree.insert(0, 10));
+
+    // half-open: touching intervals do not overlap
+    ASSERT_FALSE(tree.findAnyOverlap(10, 20).has_value());
+    ASSERT_EQ(tree.countContaining(10), 0);
+    ASSERT_EQ(tree.countContaining(20), 1);
+    ASSERT_EQ(tree.forEachOverlap(5, 5, [](const Interval<int>&) {}), 0);
+    ASSERT_FALSE(tree.findAnyOverlap(5, 5).has_value());
+
+    // a bool returning visitor stops the query
+    std::size_t num_visited = tree.forEachOverlap(0, 100, [](const Interval<int>&) {return false;});
+    ASSERT_EQ(num_visited, 1);
+}
+
+}
+}
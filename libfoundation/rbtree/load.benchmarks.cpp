@@ -0,0 +1,165 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include "libfoundation/rbtree/rbtree.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+using Tree = foundation::rbree::RBtree<std::int64_t>;
+
+/* doc
+Heap usage is measured by a counting ``operator new``, which only counts while
+a benchmark has started it.  A ``core::Json`` document cannot allocate from a
+memory resource, so this is the only way to see the peak memory of a load;
+replacing ``operator new`` affects every allocation of the executable, which
+is why these benchmarks are built apart from ``foundation-benchmarks``.
+*/
+namespace {
+
+struct HeapCounter
+{
+    std::atomic<bool> tracking_{false};
+    std::atomic<std::int64_t> in_use_{0};
+    std::atomic<std::int64_t> peak_{0};
+
+    void add(std::int64_t bytes)
+    {
+        if (!tracking_.load(std::memory_order_relaxed))
+            return;
+        std::int64_t in_use = in_use_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        std::int64_t peak = peak_.load(std::memory_order_relaxed);
+        while (in_use > peak && !peak_.compare_exchange_weak(peak, in_use, std::memory_order_relaxed)) {}
+    }
+
+    void start()
+    {
+        in_use_ = 0;
+        peak_ = 0;
+        tracking_ = true;
+    }
+
+    std::int64_t stop()
+    {
+        tracking_ = false;
+        return peak_;
+    }
+};
+
+HeapCounter heap_counter;
+
+}
+
+#if defined(__GLIBC__)
+void* operator new(std::size_t bytes)
+{
+    void* ptr = std::malloc(bytes == 0 ? 1 : bytes);
+    if (!ptr)
+        throw std::bad_alloc();
+    heap_counter.add(malloc_usable_size(ptr));
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (ptr)
+        heap_counter.add(-static_cast<std::int64_t>(malloc_usable_size(ptr)));
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+void* operator new(std::size_t bytes, std::align_val_t align)
+{
+    std::size_t alignment = std::max(static_cast<std::size_t>(align), sizeof(void*));
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, alignment, bytes == 0 ? 1 : bytes) != 0)
+        throw std::bad_alloc();
+    heap_counter.add(malloc_usable_size(ptr));
+    return ptr;
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    operator delete(ptr);
+}
+#endif
+
+/* doc
+Trees of state.range(0) random keys, written to a temporary file which stays
+in the page cache.
+*/
+static void fillTree(Tree& tree, std::int64_t n)
+{
+    while (static_cast<std::int64_t>(tree.size()) < n)
+        tree.insert((static_cast<std::int64_t>(std::rand()) << 16) ^ std::rand());
+}
+
+static std::string loadPath()
+{
+    return (std::filesystem::temp_directory_path() / "foundation-load-bench.json").string();
+}
+
+/* doc
+Loading a JSON file written by ``toJson``: parsing it into a ``core::Json``
+document for ``fromJson``, against the single pass SAX loader
+``fromJsonFile``.  The counter ``peak_bytes`` is the largest amount of heap
+memory in use during a load, beyond what was in use before it, as seen by a
+counting ``operator new``.
+*/
+template <typename Load>
+static void jsonLoads(benchmark::State& state, Load load)
+{
+    Tree tree;
+    fillTree(tree, state.range(0));
+    auto path = loadPath();
+    foundation::core::saveJson(tree.toJson(), path);
+
+    std::int64_t peak_bytes{0};
+    for (auto _ : state)
+    {
+        Tree loaded;
+        heap_counter.start();
+        load(loaded, path);
+        peak_bytes = heap_counter.stop();
+        benchmark::DoNotOptimize(loaded.root());
+    }
+    std::filesystem::remove(path);
+    state.counters["peak_bytes"] = peak_bytes;
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetComplexityN(state.range(0));
+}
+
+static void BMloadJsonDom(benchmark::State& state)
+{
+    jsonLoads(state, [](Tree& tree, const std::string& path) {tree.fromJson(foundation::core::loadJson(path));});
+}
+BENCHMARK(BMloadJsonDom)->RangeMultiplier(8)->Range(1 << 10, 1 << 19)->Unit(benchmark::kMillisecond);
+
+static void BMloadJsonSax(benchmark::State& state)
+{
+    jsonLoads(state, [](Tree& tree, const std::string& path) {tree.fromJsonFile(path);});
+}
+BENCHMARK(BMloadJsonSax)->RangeMultiplier(8)->Range(1 << 10, 1 << 19)->Unit(benchmark::kMillisecond);
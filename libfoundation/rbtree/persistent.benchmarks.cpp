@@ -0,0 +1,151 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include "libfoundation/rbtree/persistent.hpp"
+#include "libfoundation/rbtree/rbtree.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+
+/* doc
+Read scalability with a concurrent writer.  The benchmark threads are
+readers performing lookups of random keys in a set of kKeys keys, while one
+extra thread keeps inserting and erasing random keys for the whole run.  The
+reported items/sec is the aggregate lookup throughput of all readers.
+*/
+
+static constexpr int kKeys = 1 << 16;
+
+/* the writer thread alternates inserts and erases of random keys */
+class Writer
+{
+    private:
+
+    std::atomic<bool> done_{false};
+    std::thread thread_;
+
+    public:
+
+    template <typename Update>
+    explicit Writer(Update update)
+        : thread_([this, update]() mutable
+                  {
+                      unsigned seed = 12345;
+                      while (!done_.load(std::memory_order_relaxed))
+                      {
+                          seed = seed * 1103515245 + 12345;
+                          update(static_cast<int>(seed >> 8) % (2 * kKeys), seed & 1);
+                      }
+                  })
+    {
+    }
+
+    ~Writer()
+    {
+        done_ = true;
+        thread_.join();
+    }
+};
+
+/* doc
+Readers take a new snapshot every 64 lookups, so they keep up with the
+writer while the reference count of the current version is touched rarely.
+*/
+static std::unique_ptr<foundation::rbree::PersistentRBtree<int>> persistent_tree;
+static std::unique_ptr<Writer>                                      persistent_writer;
+
+static void BMpersistentReads(benchmark::State& state)
+{
+    if (state.thread_index() == 0)
+    {
+        persistent_tree = std::make_unique<foundation::rbree::PersistentRBtree<int>>();
+        for (int i = 0; i < kKeys; ++i)
+        {
+            persistent_tree->insert(2 * i);
+        }
+        persistent_writer = std::make_unique<Writer>(
+            [](int key, bool insert)
+            {
+                if (insert)
+                    persistent_tree->insert(key);
+                else
+                    persistent_tree->erase(key);
+            });
+    }
+
+    // the tree only exists once the benchmark loop has started
+    unsigned seed = state.thread_index() + 1;
+    int      i{0};
+    std::optional<foundation::rbree::PersistentRBtree<int>::Snapshot> snapshot;
+    for (auto _ : state)
+    {
+        if (i++ % 64 == 0)
+        {
+            snapshot = persistent_tree->snapshot();
+        }
+        seed = seed * 1103515245 + 12345;
+        benchmark::DoNotOptimize(snapshot->contains(static_cast<int>(seed >> 8) % (2 * kKeys)));
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    if (state.thread_index() == 0)
+    {
+        persistent_writer.reset();
+        state.counters["versions"] = snapshot->version();
+        persistent_tree.reset();
+    }
+}
+BENCHMARK(BMpersistentReads)->ThreadRange(1, 64)->UseRealTime();
+
+/* doc
+Baseline: an ``RBtree`` behind a reader-writer lock, readers take the shared
+lock for every lookup.
+*/
+static foundation::rbree::RBtree<int> locked_tree;
+static std::shared_mutex              locked_tree_mutex;
+static std::unique_ptr<Writer>        locked_writer;
+
+static void BMlockedReads(benchmark::State& state)
+{
+    if (state.thread_index() == 0)
+    {
+        locked_tree.clear();
+        for (int i = 0; i < kKeys; ++i)
+        {
+            locked_tree.insert(2 * i);
+        }
+        locked_writer = std::make_unique<Writer>(
+            [](int key, bool insert)
+            {
+                std::unique_lock<std::shared_mutex> lock(locked_tree_mutex);
+                if (insert)
+                    locked_tree.insert(key);
+                else
+                    locked_tree.erase(key);
+            });
+    }
+
+    unsigned seed = state.thread_index() + 1;
+    for (auto _ : state)
+    {
+        seed = seed * 1103515245 + 12345;
+        std::shared_lock<std::shared_mutex> lock(locked_tree_mutex);
+        benchmark::DoNotOptimize(locked_tree.contains(static_cast<int>(seed >> 8) % (2 * kKeys)));
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    if (state.thread_index() == 0)
+    {
+        locked_writer.reset();
+    }
+}
+BENCHMARK(BMlockedReads)->ThreadRange(1, 64)->UseRealTime();
@@ -0,0 +1,495 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#ifndef PERSISTENT_HPP_
+#define PERSISTENT_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace foundation {
+namespace rbree {
+
+    //--------------------------------------------------------------------------------------------//
+    //                                  struct PersistentNode                                     //
+    //--------------------------------------------------------------------------------------------//
+    /*
+        A node of a PersistentRBtree. Nodes have no parent link, a node reachable
+        from a published version is never modified again, it can be shared by any
+        number of versions.
+    */
+    template <typename T>
+    struct PersistentNode
+    {
+        T data_;
+        PersistentNode* l_{nullptr};
+        PersistentNode* r_{nullptr};
+
+        /* the update which created the node */
+        std::uint64_t stamp_ : 56 {0};
+        /* number of black nodes down to a leaf, this one included */
+        std::uint64_t bh_ : 7 {0};
+        std::uint64_t red_ : 1 {0};
+    };
+
+    //--------------------------------------------------------------------------------------------//
+    //                                 class PersistentRBtree                                     //
+    //--------------------------------------------------------------------------------------------//
+    /*
+        An ordered set with point-in-time snapshots for concurrent readers.
+
+        Updates never modify a published node. They copy the O(log n) nodes on the
+        path they change, using the join based insert and erase of Blelloch,
+        Ferizovic and Sun, and publish the new root as a new version. Nodes created
+        earlier in the same update are still private and are modified in place.
+
+        snapshot() hands out the latest version. Readers take no lock, a snapshot
+        stays valid and unchanged for as long as it is held, whatever the writer
+        does. Updates are serialised by a mutex which readers never touch.
+
+        Versions are reference counted, only the roots are counted and not the
+        nodes. The nodes replaced when version v + 1 is created are listed in v,
+        and each version holds a reference to the next one, so those nodes are
+        freed once no snapshot of v or of any older version is left. Nodes come
+        from a synchronized pool resource, as the last reader of a version may
+        free its nodes while the writer allocates.
+    */
+    template <typename T, typename Compare = std::less<T>>
+    class PersistentRBtree
+    {
+        public:
+
+        using node_type = PersistentNode<T>;
+
+        private:
+
+        static void freeNode(std::pmr::memory_resource* resource, node_type* x)
+        {
+            x->~node_type();
+            resource->deallocate(x, sizeof(node_type), alignof(node_type));
+        }
+
+        struct Version
+        {
+            node_type* root_{nullptr};
+            std::size_t size_{0};
+            std::uint64_t stamp_{0};
+            std::shared_ptr<std::pmr::memory_resource> resource_;
+
+            /* nodes of this version replaced by the next one */
+            std::vector<node_type*> retired_;
+            std::shared_ptr<Version> next_;
+
+            ~Version()
+            {
+                for (node_type* x : retired_)
+                    freeNode(resource_.get(), x);
+
+                // the newer versions are released one by one rather than
+                // recursively: the outermost destructor on a thread drains a
+                // list which the nested ones only append their next_ to. Only
+                // the version being destroyed is read, which the release of
+                // its last reference orders after the writer's updates.
+                static thread_local std::vector<std::shared_ptr<Version>>* pending = nullptr;
+                if (pending)
+                {
+                    pending->push_back(std::move(next_));
+                    return;
+                }
+                std::vector<std::shared_ptr<Version>> released;
+                released.push_back(std::move(next_));
+                pending = &released;
+                while (!released.empty())
+                {
+                    std::shared_ptr<Version> next = std::move(released.back());
+                    released.pop_back();
+                    next.reset();
+                }
+                pending = nullptr;
+            }
+        };
+
+        Compare cmp_;
+        std::shared_ptr<std::pmr::memory_resource> resource_;
+        std::atomic<std::shared_ptr<Version>> current_;
+
+        // owned by the writer, under writer_mutex_
+        std::mutex writer_mutex_;
+        std::shared_ptr<Version> head_;
+        std::uint64_t stamp_{0};
+        std::vector<node_type*> retired_;
+
+        struct Split
+        {
+            node_type* l_;
+            node_type* m_;
+            node_type* r_;
+        };
+
+        static bool isRed(const node_type* x) {return x && x->red_;};
+
+        static std::size_t blackHeight(const node_type* x) {return x ? x->bh_ : 0;};
+
+        node_type* newNode(const T& value)
+        {
+            void* mem = resource_->allocate(sizeof(node_type), alignof(node_type));
+            return ::new (mem) node_type{value, nullptr, nullptr, stamp_};
+        }
+
+        /* hands x to the reclamation of the version it was published in */
+        void retire(node_type* x)
+        {
+            if (x->stamp_ == stamp_)
+                freeNode(resource_.get(), x);
+            else
+                retired_.push_back(x);
+        }
+
+        /*
+            Returns x with new children and color. A node created by the current
+            update is changed in place, a published one is copied and retired.
+        */
+        node_type* modify(node_type* x, node_type* l, node_type* r, bool red)
+        {
+            if (x->stamp_ != stamp_)
+            {
+                node_type* copy = newNode(x->data_);
+                retire(x);
+                x = copy;
+            }
+            x->l_ = l;
+            x->r_ = r;
+            x->red_ = red;
+            x->bh_ = blackHeight(l) + (red ? 0 : 1);
+            return x;
+        }
+
+        node_type* joinRight(node_type* tl, node_type* k, node_type* tr)
+        {
+            if (!isRed(tl) && blackHeight(tl) == blackHeight(tr))
+                return modify(k, tl, tr, true);
+
+            node_type* r = joinRight(tl->r_, k, tr);
+            node_type* t = modify(tl, tl->l_, r, tl->red_);
+            if (!t->red_ && r->red_ && isRed(r->r_))
+            {
+                node_type* rr = modify(r->r_, r->r_->l_, r->r_->r_, false);
+                node_type* l = modify(t, t->l_, r->l_, t->red_);
+                return modify(r, l, rr, r->red_);
+            }
+            return t;
+        }
+
+        node_type* joinLeft(node_type* tl, node_type* k, node_type* tr)
+        {
+            if (!isRed(tr) && blackHeight(tl) == blackHeight(tr))
+                return modify(k, tl, tr, true);
+
+            node_type* l = joinLeft(tl, k, tr->l_);
+            node_type* t = modify(tr, l, tr->r_, tr->red_);
+            if (!t->red_ && l->red_ && isRed(l->l_))
+            {
+                node_type* ll = modify(l->l_, l->l_->l_, l->l_->r_, false);
+                node_type* r = modify(t, l->r_, t->r_, t->red_);
+                return modify(l, ll, r, l->red_);
+            }
+            return t;
+        }
+
+        node_type* join(node_type* tl, node_type* k, node_type* tr)
+        {
+            if (isRed(tl))
+                tl = modify(tl, tl->l_, tl->r_, false);
+            if (isRed(tr))
+                tr = modify(tr, tr->l_, tr->r_, false);
+
+            if (blackHeight(tl) > blackHeight(tr))
+            {
+                node_type* t = joinRight(tl, k, tr);
+                if (t->red_ && isRed(t->r_))
+                    t = modify(t, t->l_, t->r_, false);
+                return t;
+            }
+            if (blackHeight(tr) > blackHeight(tl))
+            {
+                node_type* t = joinLeft(tl, k, tr);
+                if (t->red_ && isRed(t->l_))
+                    t = modify(t, t->l_, t->r_, false);
+                return t;
+            }
+            return modify(k, tl, tr, true);
+        }
+
+        std::pair<node_type*, node_type*> splitLast(node_type* t)
+        {
+            if (!t->r_)
+                return {t->l_, t};
+            auto [rest, last] = splitLast(t->r_);
+            return {join(t->l_, t, rest), last};
+        }
+
+        node_type* join(node_type* tl, node_type* tr)
+        {
+            if (!tl)
+                return tr;
+            auto [rest, last] = splitLast(tl);
+            return join(rest, last, tr);
+        }
+
+        Split split(node_type* t, const T& value)
+        {
+            if (!t)
+                return {nullptr, nullptr, nullptr};
+            if (cmp_(value, t->data_))
+            {
+                Split s = split(t->l_, value);
+                return {s.l_, s.m_, join(s.r_, t, t->r_)};
+            }
+            if (cmp_(t->data_, value))
+            {
+                Split s = split(t->r_, value);
+                return {join(t->l_, t, s.l_), s.m_, s.r_};
+            }
+            return {t->l_, t, t->r_};
+        }
+
+        static const node_type* search(const node_type* x, const T& value, const Compare& cmp)
+        {
+            while (x)
+            {
+                if (cmp(value, x->data_))
+                    x = x->l_;
+                else if (cmp(x->data_, value))
+                    x = x->r_;
+                else
+                    return x;
+            }
+            return nullptr;
+        }
+
+        /* makes root, with size values, the latest version */
+        void publish(node_type* root, std::size_t size)
+        {
+            if (isRed(root))
+                root = modify(root, root->l_, root->r_, false);
+
+            auto next = std::make_shared<Version>();
+            next->root_ = root;
+            next->size_ = size;
+            next->stamp_ = stamp_;
+            next->resource_ = resource_;
+
+            head_->retired_ = std::move(retired_);
+            retired_.clear();
+            head_->next_ = next;
+            current_.store(next, std::memory_order_release);
+            head_ = std::move(next);
+        }
+
+        public:
+
+        //----------------------------------------------------------------------------------------//
+        //                                       Snapshot                                         //
+        //----------------------------------------------------------------------------------------//
+        /*
+            An immutable view of one version of the tree.
+        */
+        class Snapshot
+        {
+            private:
+
+            std::shared_ptr<const Version> version_;
+            Compare cmp_;
+
+            public:
+
+            Snapshot(std::shared_ptr<const Version> version, Compare cmp)
+                : version_{std::move(version)}, cmp_{cmp}
+            {
+            }
+
+            const node_type* root() const {return version_->root_;};
+
+            std::size_t size() const {return version_->size_;};
+
+            bool empty() const {return version_->size_ == 0;};
+
+            /* number of updates before this version */
+            std::uint64_t version() const {return version_->stamp_;};
+
+            /* returns the value equivalent to value, or nullptr */
+            const T* find(const T& value) const
+            {
+                const node_type* x = search(version_->root_, value, cmp_);
+                return x ? &x->data_ : nullptr;
+            }
+
+            bool contains(const T& value) const
+            {
+                return search(version_->root_, value, cmp_) != nullptr;
+            }
+
+            /*
+                Calls visitor on every value in [lo, hi) in order and returns the
+                number of values visited. If the visitor returns bool, the scan
+                stops after it returns false. The path is kept on a fixed size
+                stack, as a red-black tree is at most 2 log2(n + 1) high.
+            */
+            template <typename Visitor>
+            std::size_t rangeScan(const T& lo, const T& hi, Visitor&& visitor) const
+            {
+                const node_type* path[2 * 64];
+                std::size_t depth{0};
+                std::size_t num_visited{0};
+
+                // the ancestors of the first value >= lo which are >= lo themselves
+                for (const node_type* x = version_->root_; x;)
+                {
+                    if (cmp_(x->data_, lo))
+                    {
+                        x = x->r_;
+                    }
+                    else
+                    {
+                        path[depth++] = x;
+                        x = x->l_;
+                    }
+                }
+
+                while (depth > 0)
+                {
+                    const node_type* x = path[--depth];
+                    if (!cmp_(x->data_, hi))
+                        break;
+                    ++num_visited;
+                    if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, const T&>, bool>)
+                    {
+                        if (!visitor(std::as_const(x->data_)))
+                            break;
+                    }
+                    else
+                    {
+                        visitor(std::as_const(x->data_));
+                    }
+                    for (x = x->r_; x; x = x->l_)
+                        path[depth++] = x;
+                }
+                return num_visited;
+            }
+
+            /* calls visitor on every value in order */
+            template <typename Visitor>
+            void forEach(Visitor&& visitor) const
+            {
+                const node_type* path[2 * 64];
+                std::size_t depth{0};
+                for (const node_type* x = version_->root_; x; x = x->l_)
+                    path[depth++] = x;
+                while (depth > 0)
+                {
+                    const node_type* x = path[--depth];
+                    visitor(std::as_const(x->data_));
+                    for (x = x->r_; x; x = x->l_)
+                        path[depth++] = x;
+                }
+            }
+        };
+
+        explicit PersistentRBtree(std::pmr::memory_resource* upstream = std::pmr::get_default_resource(),
+                                  Compare cmp = Compare{})
+            : cmp_{cmp},
+              resource_{std::make_shared<std::pmr::synchronized_pool_resource>(upstream)}
+        {
+            head_ = std::make_shared<Version>();
+            head_->resource_ = resource_;
+            current_.store(head_);
+        }
+
+        PersistentRBtree(const PersistentRBtree&) = delete;
+        PersistentRBtree& operator=(const PersistentRBtree&) = delete;
+
+        /*
+            The nodes of the latest version are handed to it, they are freed with
+            the last snapshot still referring to it.
+        */
+        ~PersistentRBtree()
+        {
+            std::vector<node_type*> node_stack;
+            if (head_->root_)
+                node_stack.push_back(head_->root_);
+            while (!node_stack.empty())
+            {
+                node_type* x = node_stack.back();
+                node_stack.pop_back();
+                head_->retired_.push_back(x);
+                if (x->l_)
+                    node_stack.push_back(x->l_);
+                if (x->r_)
+                    node_stack.push_back(x->r_);
+            }
+            current_.store(nullptr);
+        }
+
+        /*
+            Returns the latest version, without taking a lock.
+        */
+        Snapshot snapshot() const
+        {
+            return Snapshot(current_.load(std::memory_order_acquire), cmp_);
+        }
+
+        std::size_t size() const
+        {
+            return current_.load(std::memory_order_acquire)->size_;
+        }
+
+        /*
+            Inserts value unless an equivalent value is present, returns whether
+            a new version was published.
+        */
+        bool insert(const T& value)
+        {
+            std::lock_guard<std::mutex> lock(writer_mutex_);
+            if (search(head_->root_, value, cmp_))
+                return false;
+
+            ++stamp_;
+            Split s = split(head_->root_, value);
+            node_type* root = join(s.l_, newNode(value), s.r_);
+            publish(root, head_->size_ + 1);
+            return true;
+        }
+
+        /*
+            Removes the value equivalent to value, if any, and returns the number
+            of removed values.
+        */
+        std::size_t erase(const T& value)
+        {
+            std::lock_guard<std::mutex> lock(writer_mutex_);
+            if (!search(head_->root_, value, cmp_))
+                return 0;
+
+            ++stamp_;
+            Split s = split(head_->root_, value);
+            retire(s.m_);
+            publish(join(s.l_, s.r_), head_->size_ - 1);
+            return 1;
+        }
+    };
+
+}
+}
+
+#endif  // PERSISTENT_HPP_
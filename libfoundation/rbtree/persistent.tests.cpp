@@ -0,0 +1,194 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include <atomic>
+#include <cstdlib>
+#include <set>
+#include <thread>
+#include <vector>
+#include <libfoundation/rbtree/persistent.hpp>
+
+#include <gtest/gtest.h>
+
+namespace foundation {
+namespace rbree {
+
+/*
+    Checks the order, the colors and the stored black heights of a snapshot,
+    returns the black height or -1.
+*/
+template <typename T>
+int checkNode(const PersistentNode<T>* x, const T* lo, const T* hi)
+{
+    if (!x)
+        return 0;
+    if ((lo && !(*lo < x->data_)) || (hi && !(x->data_ < *hi)))
+        return -1;
+    if (x->red_ && ((x->l_ && x->l_->red_) || (x->r_ && x->r_->red_)))
+        return -1;
+
+    int lh = checkNode<T>(x->l_, lo, &x->data_);
+    int rh = checkNode<T>(x->r_, &x->data_, hi);
+    if (lh < 0 || lh != rh)
+        return -1;
+    int bh = lh + (x->red_ ? 0 : 1);
+    return static_cast<int>(x->bh_) == bh ? bh : -1;
+}
+
+static bool isValid(const PersistentRBtree<int>::Snapshot& snapshot)
+{
+    return (!snapshot.root() || !snapshot.root()->red_) && checkNode<int>(snapshot.root(), nullptr, nullptr) >= 0;
+}
+
+static std::vector<int> values(const PersistentRBtree<int>::Snapshot& snapshot)
+{
+    std::vector<int> out;
+    snapshot.forEach([&](int v) {out.push_back(v);});
+    return out;
+}
+
+/* an int counting the live instances */
+struct Counted
+{
+    static inline std::atomic<long> live_{0};
+
+    int value_{0};
+
+    Counted(int value = 0) : value_{value} {++live_;}
+    Counted(const Counted& other) : value_{other.value_} {++live_;}
+    ~Counted() {--live_;}
+
+    bool operator<(const Counted& other) const {return value_ < other.value_;}
+};
+
+TEST(PersistentTests, updates)
+{
+    PersistentRBtree<int> tree;
+    std::set<int> reference;
+
+    for (int i = 0; i < 5000; ++i)
+    {
+        int value = std::rand() % 1000;
+        if (i % 3 == 2)
+            ASSERT_EQ(tree.erase(value), reference.erase(value));
+        else
+            ASSERT_EQ(tree.insert(value), reference.insert(value).second);
+    }
+
+    auto snapshot = tree.snapshot();
+    ASSERT_TRUE(isValid(snapshot));
+    ASSERT_EQ(snapshot.size(), reference.size());
+    ASSERT_EQ(values(snapshot), std::vector<int>(reference.begin(), reference.end()));
+    for (int value = 0; value < 1000; ++value)
+        ASSERT_EQ(snapshot.contains(value), reference.count(value) == 1);
+
+    std::vector<int> scanned;
+    snapshot.rangeScan(100, 200, [&](int v) {scanned.push_back(v);});
+    ASSERT_EQ(scanned, std::vector<int>(reference.lower_bound(100), reference.lower_bound(200)));
+}
+
+TEST(PersistentTests, snapshotsAreImmutable)
+{
+    PersistentRBtree<int> tree;
+    std::set<int> reference;
+    std::vector<std::pair<PersistentRBtree<int>::Snapshot, std::vector<int>>> history;
+
+    for (int i = 0; i < 2000; ++i)
+    {
+        int value = std::rand() % 300;
+        if (i % 2)
+        {
+            tree.erase(value);
+            reference.erase(value);
+        }
+        else
+        {
+            tree.insert(value);
+            reference.insert(value);
+        }
+        if (i % 50 == 0)
+            history.push_back({tree.snapshot(), std::vector<int>(reference.begin(), reference.end())});
+    }
+
+    for (auto& [snapshot, expected] : history)
+    {
+        ASSERT_TRUE(isValid(snapshot));
+        ASSERT_EQ(values(snapshot), expected);
+    }
+}
+
+TEST(PersistentTests, reclamation)
+{
+    {
+        PersistentRBtree<Counted> tree;
+        for (int i = 0; i < 1000; ++i)
+            tree.insert(i);
+
+        auto old = tree.snapshot();
+        for (int i = 0; i < 1000; i += 2)
+            tree.erase(i);
+
+        // the old version keeps its values alive
+        ASSERT_GE(Counted::live_, 1000);
+        ASSERT_EQ(old.size(), 1000);
+
+        old = tree.snapshot();
+        ASSERT_EQ(Counted::live_, 500);
+
+        // a snapshot outlives the tree
+        auto last = tree.snapshot();
+        tree.insert(5000);
+        ASSERT_EQ(last.size(), 500);
+    }
+    ASSERT_EQ(Counted::live_, 0);
+}
+
+TEST(PersistentTests, concurrentReaders)
+{
+    PersistentRBtree<int> tree;
+    for (int i = 0; i < 1000; ++i)
+        tree.insert(2 * i);
+
+    std::atomic<bool> done{false};
+    std::atomic<int> num_errors{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t)
+    {
+        readers.emplace_back([&]
+        {
+            while (!done)
+            {
+                auto snapshot = tree.snapshot();
+                std::size_t count{0};
+                int previous{-1};
+                snapshot.forEach([&](int v)
+                {
+                    num_errors += v <= previous;
+                    previous = v;
+                    ++count;
+                });
+                num_errors += count != snapshot.size();
+            }
+        });
+    }
+
+    for (int i = 0; i < 20000; ++i)
+    {
+        int value = std::rand() % 4000;
+        if (i % 2)
+            tree.erase(value);
+        else
+            tree.insert(value);
+    }
+    done = true;
+    for (auto& reader : readers)
+        reader.join();
+
+    ASSERT_EQ(num_errors, 0);
+    ASSERT_TRUE(isValid(tree.snapshot()));
+}
+
+}
+}
@@ -0,0 +1,219 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#ifndef POOL_HPP_
+#define POOL_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <utility>
+
+namespace foundation {
+namespace rbree {
+
+    static constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+    //--------------------------------------------------------------------------------------------//
+    //                                       class NodePool                                       //
+    //--------------------------------------------------------------------------------------------//
+    /*
+        A fixed size object pool for tree nodes.
+
+        Storage is requested from an upstream std::pmr::memory_resource in chunks
+        aligned to a cache line, and slots are bump allocated from the current chunk.
+        Freed slots go onto an intrusive free list and are reused before the chunk is
+        bumped further. Chunks grow geometrically from min_chunk_bytes up to
+        max_chunk_bytes, so the number of upstream calls is logarithmic in the number
+        of nodes until the maximum is reached.
+
+        release() hands every chunk back to the upstream resource at once without
+        touching the slots, it is up to the owner to destroy live objects first.
+    */
+    template <typename T>
+    class NodePool
+    {
+        private:
+
+        struct Chunk
+        {
+            Chunk* next_;
+            std::size_t bytes_;
+        };
+
+        struct FreeSlot
+        {
+            FreeSlot* next_;
+        };
+
+        static constexpr std::size_t SLOT_ALIGN = std::max(alignof(T), alignof(FreeSlot));
+        static constexpr std::size_t SLOT_SIZE =
+            (std::max(sizeof(T), sizeof(FreeSlot)) + SLOT_ALIGN - 1) / SLOT_ALIGN * SLOT_ALIGN;
+        static constexpr std::size_t HEADER_SIZE =
+            (sizeof(Chunk) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+        static constexpr std::size_t CHUNK_ALIGN = std::max(CACHE_LINE_SIZE, SLOT_ALIGN);
+
+        std::pmr::memory_resource* upstream_;
+        Chunk* chunks_{nullptr};
+        std::byte* cur_{nullptr};
+        std::byte* end_{nullptr};
+        FreeSlot* free_{nullptr};
+        std::size_t next_chunk_bytes_;
+        std::size_t max_chunk_bytes_;
+        std::size_t num_chunks_{0};
+        std::size_t bytes_reserved_{0};
+        std::size_t in_use_{0};
+
+        void grow()
+        {
+            std::size_t bytes = next_chunk_bytes_;
+            void* mem = upstream_->allocate(bytes, CHUNK_ALIGN);
+
+            auto chunk = static_cast<Chunk*>(mem);
+            chunk->next_ = chunks_;
+            chunk->bytes_ = bytes;
+            chunks_ = chunk;
+
+            cur_ = static_cast<std::byte*>(mem) + HEADER_SIZE;
+            end_ = static_cast<std::byte*>(mem) + bytes;
+
+            ++num_chunks_;
+            bytes_reserved_ += bytes;
+            next_chunk_bytes_ = std::min(2 * next_chunk_bytes_, max_chunk_bytes_);
+        }
+
+        public:
+
+        static constexpr std::size_t MIN_CHUNK_BYTES = 4096;
+        static constexpr std::size_t MAX_CHUNK_BYTES = std::size_t{1} << 20;
+
+        explicit NodePool(std::pmr::memory_resource* upstream = std::pmr::get_default_resource(),
+                          std::size_t min_chunk_bytes = MIN_CHUNK_BYTES,
+                          std::size_t max_chunk_bytes = MAX_CHUNK_BYTES)
+            : upstream_{upstream},
+              next_chunk_bytes_{std::max(min_chunk_bytes, HEADER_SIZE + SLOT_SIZE)},
+              max_chunk_bytes_{std::max(max_chunk_bytes, next_chunk_bytes_)}
+        {
+        }
+
+        NodePool(const NodePool&) = delete;
+        NodePool& operator=(const NodePool&) = delete;
+
+        NodePool(NodePool&& other) noexcept
+            : upstream_{other.upstream_},
+              next_chunk_bytes_{other.next_chunk_bytes_},
+              max_chunk_bytes_{other.max_chunk_bytes_}
+        {
+            swap(other);
+        }
+
+        NodePool& operator=(NodePool&& other) noexcept
+        {
+            release();
+            swap(other);
+            return *this;
+        }
+
+        ~NodePool()
+        {
+            release();
+        }
+
+        void swap(NodePool& other) noexcept
+        {
+            std::swap(upstream_, other.upstream_);
+            std::swap(chunks_, other.chunks_);
+            std::swap(cur_, other.cur_);
+            std::swap(end_, other.end_);
+            std::swap(free_, other.free_);
+            std::swap(next_chunk_bytes_, other.next_chunk_bytes_);
+            std::swap(max_chunk_bytes_, other.max_chunk_bytes_);
+            std::swap(num_chunks_, other.num_chunks_);
+            std::swap(bytes_reserved_, other.bytes_reserved_);
+            std::swap(in_use_, other.in_use_);
+        }
+
+        std::pmr::memory_resource* upstream() const {return upstream_;};
+
+        /* number of chunks obtained from the upstream resource */
+        std::size_t numChunks() const {return num_chunks_;};
+
+        /* bytes obtained from the upstream resource */
+        std::size_t bytesReserved() const {return bytes_reserved_;};
+
+        /* number of slots handed out and not yet deallocated */
+        std::size_t inUse() const {return in_use_;};
+
+        /*
+            Returns uninitialised storage for one T.
+        */
+        T* allocate()
+        {
+            void* out;
+            if (free_)
+            {
+                out = free_;
+                free_ = free_->next_;
+            }
+            else
+            {
+                if (end_ - cur_ < static_cast<std::ptrdiff_t>(SLOT_SIZE))
+                    grow();
+                out = cur_;
+                cur_ += SLOT_SIZE;
+            }
+            ++in_use_;
+            return static_cast<T*>(out);
+        }
+
+        /*
+            Returns the storage of an already destroyed T to the free list.
+        */
+        void deallocate(T* ptr)
+        {
+            auto slot = ::new (static_cast<void*>(ptr)) FreeSlot{free_};
+            free_ = slot;
+            --in_use_;
+        }
+
+        template <typename... Args>
+        T* create(Args&&... args)
+        {
+            T* out = allocate();
+            return ::new (static_cast<void*>(out)) T(std::forward<Args>(args)...);
+        }
+
+        void destroy(T* ptr)
+        {
+            ptr->~T();
+            deallocate(ptr);
+        }
+
+        /*
+            Returns every chunk to the upstream resource. Objects still living in the
+            pool are not destroyed.
+        */
+        void release()
+        {
+            while (chunks_)
+            {
+                Chunk* next = chunks_->next_;
+                upstream_->deallocate(chunks_, chunks_->bytes_, CHUNK_ALIGN);
+                chunks_ = next;
+            }
+            cur_ = nullptr;
+            end_ = nullptr;
+            free_ = nullptr;
+            num_chunks_ = 0;
+            bytes_reserved_ = 0;
+            in_use_ = 0;
+        }
+    };
+
+}
+}
+
+#endif  // POOL_HPP_
@@ -0,0 +1,123 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <vector>
+#include <libfoundation/rbtree/pool.hpp>
+#include <libfoundation/rbtree/rbtree.hpp>
+
+#include <gtest/gtest.h>
+
+namespace foundation {
+namespace rbree {
+
+/*
+    Forwards to the new/delete resource and counts calls and outstanding bytes.
+*/
+class CountingResource : public std::pmr::memory_resource
+{
+    public:
+
+    std::size_t num_allocations_{0};
+    std::size_t bytes_outstanding_{0};
+
+    private:
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        ++num_allocations_;
+        bytes_outstanding_ += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+    {
+        bytes_outstanding_ -= bytes;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+
+TEST(NodePoolTests, reuse)
+{
+    CountingResource resource;
+    NodePool<Node<long>> pool(&resource);
+
+    std::vector<Node<long>*> nodes;
+    for (int i = 0; i < 1000; ++i)
+    {
+        auto node = pool.create(i);
+        ASSERT_EQ(node->data_, i);
+        nodes.push_back(node);
+    }
+    ASSERT_EQ(pool.inUse(), 1000);
+    ASSERT_EQ(resource.num_allocations_, pool.numChunks());
+    ASSERT_LT(pool.numChunks(), 10);
+
+    // freed slots are handed out again before new chunks are requested
+    std::size_t num_chunks = pool.numChunks();
+    for (auto node : nodes)
+        pool.destroy(node);
+    for (int i = 0; i < 1000; ++i)
+        pool.create(i);
+    ASSERT_EQ(pool.numChunks(), num_chunks);
+
+    pool.release();
+    ASSERT_EQ(resource.bytes_outstanding_, 0);
+}
+
+TEST(NodePoolTests, alignment)
+{
+    NodePool<Node<double>> pool;
+    auto first = pool.allocate();
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(first) % CACHE_LINE_SIZE, 0);
+    for (int i = 0; i < 100; ++i)
+    {
+        auto node = pool.allocate();
+        ASSERT_EQ(reinterpret_cast<std::uintptr_t>(node) % alignof(Node<double>), 0);
+    }
+}
+
+TEST(NodePoolTests, treeResource)
+{
+    CountingResource resource;
+    {
+        RBtree<int> tree(&resource);
+        for (int i = 0; i < 10000; ++i)
+            tree.insert(i);
+        ASSERT_EQ(tree.resource(), &resource);
+        ASSERT_LT(resource.num_allocations_, 30);
+
+        tree.clear();
+        // only the sentinel is left
+        ASSERT_EQ(resource.bytes_outstanding_, sizeof(Node<int>));
+        ASSERT_TRUE(tree.empty());
+
+        tree.insert(1);
+        ASSERT_TRUE(tree.contains(1));
+    }
+    ASSERT_EQ(resource.bytes_outstanding_, 0);
+}
+
+TEST(NodePoolTests, nonTrivialValues)
+{
+    RBtree<std::string> tree;
+    for (int i = 0; i < 100; ++i)
+        tree.insert(std::string(40, 'a' + i % 26) + std::to_string(i));
+    tree.erase(std::string(40, 'a') + "0");
+    ASSERT_EQ(tree.size(), 99);
+    tree.clear();
+    ASSERT_EQ(tree.pool().inUse(), 0);
+}
+
+}
+}
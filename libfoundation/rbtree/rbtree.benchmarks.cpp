@@ -0,0 +1,568 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include "libfoundation/core/memory.hpp"
+#include "libfoundation/rbtree/rbtree.hpp"
+#include "libfoundation/rbtree/snapshot.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <memory_resource>
+#include <numeric>
+#include <random>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+using Tree = foundation::rbree::RBtree<std::int64_t>;
+
+/* doc
+Trees hold state.range(0) random keys, inserted in random order so that the
+nodes are scattered over the pool.  Sizes run from 1K keys, which fit in L1,
+to 4M keys (128 MiB of nodes), well beyond the last level cache.
+*/
+static void fillTree(Tree& tree, std::int64_t n, std::vector<std::int64_t>& keys)
+{
+    keys.clear();
+    while (static_cast<std::int64_t>(tree.size()) < n)
+    {
+        std::int64_t key = (static_cast<std::int64_t>(std::rand()) << 16) ^ std::rand();
+        if (tree.insert(key).second)
+            keys.push_back(key);
+    }
+}
+
+/* doc
+Lookups of kProbes random keys present in the tree, one at a time.
+*/
+static constexpr std::size_t kProbes = 4096;
+
+static std::vector<std::int64_t> makeProbes(const std::vector<std::int64_t>& keys)
+{
+    std::vector<std::int64_t> probes(kProbes);
+    for (auto& probe : probes)
+        probe = keys[std::rand() % keys.size()];
+    return probes;
+}
+
+static void BMsearch(benchmark::State& state)
+{
+    Tree                      tree;
+    std::vector<std::int64_t> keys;
+    fillTree(tree, state.range(0), keys);
+    auto probes = makeProbes(keys);
+
+    for (auto _ : state)
+    {
+        for (auto probe : probes)
+            benchmark::DoNotOptimize(tree.search(probe));
+    }
+    state.SetItemsProcessed(state.iterations() * probes.size());
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BMsearch)->RangeMultiplier(8)->Range(1 << 10, 1 << 22)->Complexity(benchmark::oLogN);
+
+/* doc
+The same lookups through ``searchBatch``, with and without sorting the keys
+first.
+*/
+static void BMsearchBatch(benchmark::State& state)
+{
+    Tree                      tree;
+    std::vector<std::int64_t> keys;
+    fillTree(tree, state.range(0), keys);
+    auto probes = makeProbes(keys);
+    std::vector<Tree::node_type*> out(probes.size());
+    bool sort_keys = state.range(1) != 0;
+
+    for (auto _ : state)
+    {
+        tree.searchBatch(probes, out, sort_keys);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * probes.size());
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BMsearchBatch)
+    ->ArgsProduct({benchmark::CreateRange(1 << 10, 1 << 22, 8), {0, 1}})
+    ->ArgNames({"n", "sorted"});
+
+/* doc
+The same lookups in a frozen copy of the tree, an Eytzinger layout searched
+without branches, and in a ``std::map`` filled in the same order.
+*/
+static void BMfrozenSearch(benchmark::State& state)
+{
+    Tree                      tree;
+    std::vector<std::int64_t> keys;
+    fillTree(tree, state.range(0), keys);
+    auto probes = makeProbes(keys);
+    auto frozen = tree.freeze();
+
+    for (auto _ : state)
+    {
+        for (auto probe : probes)
+            benchmark::DoNotOptimize(frozen.search(probe));
+    }
+    state.SetItemsProcessed(state.iterations() * probes.size());
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BMfrozenSearch)->RangeMultiplier(8)->Range(1 << 10, 1 << 22)->Complexity(benchmark::oLogN);
+
+static void BMmapSearch(benchmark::State& state)
+{
+    Tree                      tree;
+    std::vector<std::int64_t> keys;
+    fillTree(tree, state.range(0), keys);
+    auto probes = makeProbes(keys);
+    std::map<std::int64_t, std::int64_t> map;
+    for (auto key : keys)
+        map.emplace(key, key);
+
+    for (auto _ : state)
+    {
+        for (auto probe : probes)
+            benchmark::DoNotOptimize(map.find(probe));
+    }
+    state.SetItemsProcessed(state.iterations() * probes.size());
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BMmapSearch)->RangeMultiplier(8)->Range(1 << 10, 1 << 22)->Complexity(benchmark::oLogN);
+
+/* doc
+Range scans of state.range(1) consecutive keys from random start keys, in the
+pointer tree, its frozen copy and a ``std::map``.
+*/
+template <typename Scan>
+static void rangeScans(benchmark::State& state, const std::vector<std::int64_t>& probes, Scan scan)
+{
+    std::int64_t sum{0};
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < 256; ++i)
+            sum += scan(probes[i], state.range(1));
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * 256 * state.range(1));
+}
+
+static void BMrangeScan(benchmark::State& state)
+{
+    Tree                      tree;
+    std::vector<std::int64_t> keys;
+    fillTree(tree, state.range(0), keys);
+    auto probes = makeProbes(keys);
+
+    rangeScans(state, probes, [&](std::int64_t lo, std::int64_t length)
+    {
+        std::int64_t sum{0};
+        std::int64_t left{length};
+        tree.rangeScan(lo, std::numeric_limits<std::int64_t>::max(),
+                       [&](std::int64_t key) {sum += key; return --left > 0;});
+        return sum;
+    });
+}
+
+static void BMfrozenRangeScan(benchmark::State& state)
+{
+    Tree                      tree;
+    std::vector<std::int64_t> keys;
+    fillTree(tree, state.range(0), keys);
+    auto probes = makeProbes(keys);
+    auto frozen = tree.freeze();
+
+    rangeScans(state, probes, [&](std::int64_t lo, std::int64_t length)
+    {
+        std::int64_t sum{0};
+        std::int64_t left{length};
+        frozen.rangeScan(lo, std::numeric_limits<std::int64_t>::max(),
+                         [&](std::int64_t key) {sum += key; return --left > 0;});
+        return sum;
+    });
+}
+
+static void BMmapRangeScan(benchmark::State& state)
+{
+    Tree                      tree;
+    std::vector<std::int64_t> keys;
+    fillTree(tree, state.range(0), keys);
+    auto probes = makeProbes(keys);
+    std::map<std::int64_t, std::int64_t> map;
+    for (auto key : keys)
+        map.emplace(key, key);
+
+    rangeScans(state, probes, [&](std::int64_t lo, std::int64_t length)
+    {
+        std::int64_t sum{0};
+        auto it = map.lower_bound(lo);
+        for (std::int64_t i = 0; i < length && it != map.end(); ++i, ++it)
+            sum += it->first;
+        return sum;
+    });
+}
+BENCHMARK(BMrangeScan)->ArgsProduct({{1 << 16, 1 << 22}, {16, 256}})->ArgNames({"n", "length"});
+BENCHMARK(BMfrozenRangeScan)->ArgsProduct({{1 << 16, 1 << 22}, {16, 256}})->ArgNames({"n", "length"});
+BENCHMARK(BMmapRangeScan)->ArgsProduct({{1 << 16, 1 << 22}, {16, 256}})->ArgNames({"n", "length"});
+
+/* doc
+Restoring a tree of state.range(0) keys from disk: parsing the JSON file
+written by ``toJson`` and rebuilding the tree through ``fromJson``, against
+mapping a binary snapshot and bulk building from it.  The files are written
+once, outside the timed loop, and are in the page cache.
+*/
+static std::string restorePath(const char* ext)
+{
+    return (std::filesystem::temp_directory_path() / (std::string("foundation-bench.") + ext)).string();
+}
+
+static void BMrestoreJson(benchmark::State& state)
+{
+    Tree                      tree;
+    std::vector<std::int64_t> keys;
+    fillTree(tree, state.range(0), keys);
+    auto path = restorePath("json");
+    foundation::core::saveJson(tree.toJson(), path);
+
+    for (auto _ : state)
+    {
+        Tree restored;
+        restored.fromJson(foundation::core::loadJson(path));
+        benchmark::DoNotOptimize(restored.root());
+    }
+    std::filesystem::remove(path);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BMrestoreJson)->RangeMultiplier(8)->Range(1 << 10, 1 << 19)->Unit(benchmark::kMillisecond);
+
+static void BMrestoreSnapshot(benchmark::State& state)
+{
+    Tree                      tree;
+    std::vector<std::int64_t> keys;
+    fillTree(tree, state.range(0), keys);
+    auto path = restorePath("snap");
+    foundation::rbree::saveSnapshot(tree, path);
+
+    for (auto _ : state)
+    {
+        Tree restored;
+        foundation::rbree::loadSnapshot(restored, path);
+        benchmark::DoNotOptimize(restored.root());
+    }
+    std::filesystem::remove(path);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BMrestoreSnapshot)->RangeMultiplier(8)->Range(1 << 10, 1 << 22)->Unit(benchmark::kMillisecond);
+
+/* doc
+Opening a snapshot and serving kProbes lookups straight from the mapped file,
+without building a tree.
+*/
+static void BMmappedSearch(benchmark::State& state)
+{
+    Tree                      tree;
+    std::vector<std::int64_t> keys;
+    fillTree(tree, state.range(0), keys);
+    auto probes = makeProbes(keys);
+    auto path = restorePath("snap");
+    foundation::rbree::saveSnapshot(tree, path);
+
+    for (auto _ : state)
+    {
+        foundation::rbree::MappedSnapshot<std::int64_t> snapshot(path);
+        for (auto probe : probes)
+            benchmark::DoNotOptimize(snapshot.search(probe));
+    }
+    std::filesystem::remove(path);
+    state.SetItemsProcessed(state.iterations() * probes.size());
+}
+BENCHMARK(BMmappedSearch)->RangeMultiplier(8)->Range(1 << 10, 1 << 22);
+
+/* doc
+Workloads over three key streams, for the tree and for ``std::set``.  A
+workload is a universe of state.range(0) distinct keys, which search, erase,
+range and mixed benchmarks start from, and a stream of as many keys drawn
+from it:
+
+- uniform: random keys, drawn uniformly,
+- zipf: drawn with Zipf's law (s = 0.99), so a few hot keys make up most of
+  the stream; ranks are scrambled so hot keys are spread over the tree,
+- sequential: 0, 1, 2, ... in increasing order.
+*/
+enum class KeyPattern {uniform = 0, zipf = 1, sequential = 2};
+
+struct Workload
+{
+    std::vector<std::int64_t> universe_;
+    std::vector<std::int64_t> stream_;
+};
+
+static std::int64_t scramble(std::uint64_t rank)
+{
+    // an odd multiplier is a bijection on 64 bit integers
+    return static_cast<std::int64_t>(rank * 0x9E3779B97F4A7C15ull >> 1);
+}
+
+static Workload makeWorkload(KeyPattern pattern, std::size_t n)
+{
+    std::mt19937_64 rng(n);
+    Workload out;
+    out.universe_.resize(n);
+    out.stream_.resize(n);
+    switch (pattern)
+    {
+        case KeyPattern::uniform:
+        {
+            for (std::size_t i = 0; i < n; ++i)
+                out.universe_[i] = scramble(i);
+            std::uniform_int_distribution<std::size_t> pick(0, n - 1);
+            for (auto& key : out.stream_)
+                key = out.universe_[pick(rng)];
+            break;
+        }
+        case KeyPattern::zipf:
+        {
+            std::vector<double> cdf(n);
+            double sum{0};
+            for (std::size_t i = 0; i < n; ++i)
+                cdf[i] = sum += 1.0 / std::pow(static_cast<double>(i + 1), 0.99);
+            std::uniform_real_distribution<double> unit(0, sum);
+            for (std::size_t i = 0; i < n; ++i)
+                out.universe_[i] = scramble(i);
+            for (auto& key : out.stream_)
+            {
+                std::size_t rank = std::lower_bound(cdf.begin(), cdf.end(), unit(rng)) - cdf.begin();
+                key = scramble(std::min(rank, n - 1));
+            }
+            break;
+        }
+        case KeyPattern::sequential:
+            std::iota(out.universe_.begin(), out.universe_.end(), 0);
+            out.stream_ = out.universe_;
+            break;
+    }
+    if (pattern != KeyPattern::sequential)
+        std::shuffle(out.universe_.begin(), out.universe_.end(), rng);
+    return out;
+}
+
+using Set = std::set<std::int64_t>;
+
+template <typename Container>
+static void fill(Container& container, const std::vector<std::int64_t>& keys)
+{
+    for (auto key : keys)
+        container.insert(key);
+}
+
+/* the sum of up to length keys from key on */
+static std::int64_t scan(const Tree& tree, std::int64_t key, std::int64_t length)
+{
+    std::int64_t sum{0};
+    tree.rangeScan(key, std::numeric_limits<std::int64_t>::max(),
+                   [&](std::int64_t value) {sum += value; return --length > 0;});
+    return sum;
+}
+
+static std::int64_t scan(const Set& set, std::int64_t key, std::int64_t length)
+{
+    std::int64_t sum{0};
+    for (auto it = set.lower_bound(key); length > 0 && it != set.end(); ++it, --length)
+        sum += *it;
+    return sum;
+}
+
+/* doc
+Inserting the stream into an empty container, one key at a time.  The
+counter ``bytes_per_key`` is the memory the container requests per distinct
+key, counted by a ``core::CountingResource`` under a copy filled outside the
+timed loop: the pool chunks of the tree, the nodes of a ``std::pmr::set``.
+*/
+template <typename Container>
+static double bytesPerKey(const std::vector<std::int64_t>& keys)
+{
+    using Counted = std::conditional_t<std::is_same_v<Container, Tree>, Tree, std::pmr::set<std::int64_t>>;
+    foundation::core::CountingResource counter(std::pmr::new_delete_resource());
+    Counted container(&counter);
+    fill(container, keys);
+    return static_cast<double>(counter.stats().bytes_in_use_) / container.size();
+}
+
+template <typename Container>
+static void BMinsertKeys(benchmark::State& state)
+{
+    auto workload = makeWorkload(static_cast<KeyPattern>(state.range(1)), state.range(0));
+    for (auto _ : state)
+    {
+        Container container;
+        fill(container, workload.stream_);
+        state.PauseTiming();
+        container = Container();
+        state.ResumeTiming();
+    }
+    state.counters["bytes_per_key"] = bytesPerKey<Container>(workload.stream_);
+    state.SetItemsProcessed(state.iterations() * workload.stream_.size());
+}
+
+/* doc
+Erasing the keys of the stream from a container holding the universe.
+*/
+template <typename Container>
+static void BMeraseKeys(benchmark::State& state)
+{
+    auto workload = makeWorkload(static_cast<KeyPattern>(state.range(1)), state.range(0));
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        {
+            Container container;
+            fill(container, workload.universe_);
+            state.ResumeTiming();
+            for (auto key : workload.stream_)
+                benchmark::DoNotOptimize(container.erase(key));
+            state.PauseTiming();
+        }
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * workload.stream_.size());
+}
+
+/* doc
+Looking up the keys of the stream in a container holding the universe.
+*/
+template <typename Container>
+static void BMsearchKeys(benchmark::State& state)
+{
+    auto workload = makeWorkload(static_cast<KeyPattern>(state.range(1)), state.range(0));
+    Container container;
+    fill(container, workload.universe_);
+    for (auto _ : state)
+    {
+        for (auto key : workload.stream_)
+            benchmark::DoNotOptimize(container.contains(key));
+    }
+    state.SetItemsProcessed(state.iterations() * workload.stream_.size());
+}
+
+/* doc
+Scans of 32 consecutive keys from the first 4096 keys of the stream.
+*/
+template <typename Container>
+static void BMrangeKeys(benchmark::State& state)
+{
+    auto workload = makeWorkload(static_cast<KeyPattern>(state.range(1)), state.range(0));
+    Container container;
+    fill(container, workload.universe_);
+    std::size_t num_scans = std::min<std::size_t>(4096, workload.stream_.size());
+    std::int64_t sum{0};
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < num_scans; ++i)
+            sum += scan(container, workload.stream_[i], 32);
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * num_scans * 32);
+}
+
+/* doc
+A mixed stream of half lookups, a quarter inserts and a quarter erases, on a
+container starting from the universe.
+*/
+template <typename Container>
+static void BMmixedKeys(benchmark::State& state)
+{
+    auto workload = makeWorkload(static_cast<KeyPattern>(state.range(1)), state.range(0));
+    Container container;
+    fill(container, workload.universe_);
+    std::size_t i{0};
+    for (auto _ : state)
+    {
+        for (auto key : workload.stream_)
+        {
+            switch (++i & 3)
+            {
+                case 0:
+                    container.insert(key);
+                    break;
+                case 2:
+                    container.erase(key);
+                    break;
+                default:
+                    benchmark::DoNotOptimize(container.contains(key));
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * workload.stream_.size());
+}
+
+#define BM_KEYS_m(name)                                                                            \
+    BENCHMARK_TEMPLATE(name, Tree)->ArgsProduct({{1 << 14, 1 << 20}, {0, 1, 2}})->ArgNames({"n", "keys"}); \
+    BENCHMARK_TEMPLATE(name, Set)->ArgsProduct({{1 << 14, 1 << 20}, {0, 1, 2}})->ArgNames({"n", "keys"})
+
+BM_KEYS_m(BMinsertKeys);
+BM_KEYS_m(BMeraseKeys);
+BM_KEYS_m(BMsearchKeys);
+BM_KEYS_m(BMrangeKeys);
+BM_KEYS_m(BMmixedKeys);
+
+/* doc
+Randomized stress run: batches of 4096 inserts and erases of uniform and Zipf
+keys, alternating between growing and shrinking phases, with the red-black
+properties, links, order and size of the tree checked after every batch
+(outside the timed region).  Reports the operation rate, the bytes of pool
+memory per node, and the height against the 2 log2(n + 1) bound.
+*/
+static void BMstress(benchmark::State& state)
+{
+    constexpr std::size_t kBatch = 4096;
+    std::size_t target = state.range(0);
+    std::mt19937_64 rng(target);
+    auto zipf = makeWorkload(KeyPattern::zipf, target).stream_;
+    std::uniform_int_distribution<std::int64_t> uniform(0, 4 * static_cast<std::int64_t>(target));
+
+    Tree tree;
+    std::size_t num_batches{0};
+    std::size_t max_height{0};
+    double bytes_per_node{0};
+    for (auto _ : state)
+    {
+        bool growing = (num_batches / 16) % 2 == 0 || tree.size() < target / 4;
+        for (std::size_t i = 0; i < kBatch; ++i)
+        {
+            std::int64_t key = i & 1 ? uniform(rng) : zipf[rng() % zipf.size()];
+            if (growing == (rng() % 4 != 0))
+                tree.insert(key);
+            else
+                tree.erase(key);
+        }
+        ++num_batches;
+
+        state.PauseTiming();
+        if (!tree.isValid())
+        {
+            state.SkipWithError("red-black invariants violated");
+            break;
+        }
+        max_height = std::max(max_height, tree.height());
+        if (!tree.empty())
+            bytes_per_node = static_cast<double>(tree.pool().bytesReserved()) / tree.size();
+        state.ResumeTiming();
+    }
+    state.counters["height"] = max_height;
+    state.counters["height_bound"] = 2 * std::log2(static_cast<double>(tree.size()) + 1);
+    state.counters["bytes_per_node"] = bytes_per_node;
+    state.counters["size"] = tree.size();
+    state.SetItemsProcessed(state.iterations() * kBatch);
+}
+BENCHMARK(BMstress)->Arg(1 << 12)->Arg(1 << 16)->Arg(1 << 20)->Iterations(512);
@@ -1,13 +1,42 @@
-
-
-
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#ifndef RBTREE_HPP_
+#define RBTREE_HPP_
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
 #include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <istream>
+#include <iterator>
 #include <memory>
+#include <memory_resource>
+#include <new>
+#include <numeric>
+#include <span>
+#include <stdexcept>
 #include <stack>
+#include <type_traits>
 #include <string>
+#include <unordered_map>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <libfoundation/core/io.hpp>
+#include <libfoundation/core/parallel.hpp>
 #include <libfoundation/core/assertions.hpp>
+#include <libfoundation/rbtree/augment.hpp>
+#include <libfoundation/rbtree/frozen.hpp>
+#include <libfoundation/rbtree/pool.hpp>
 
 namespace foundation {
 namespace rbree {
@@ -15,115 +44,159 @@ namespace rbree {
 
     static const long int NIL_UID = 0;
 
+    /* hints the cache to load the line at ptr, a no-op where unsupported */
+    inline void prefetch(const void* ptr)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(ptr);
+#else
+        (void)ptr;
+#endif
+    }
+
     //--------------------------------------------------------------------------------------------//
     //                                       struct Node                                          //
     //--------------------------------------------------------------------------------------------//
-    template <typename T>
-    struct Node;
+    /*
+        Nodes are owned by the tree they belong to, the parent and child links are
+        plain pointers. A missing child or parent points to the tree's sentinel
+        node, which is black and whose children point back to itself.
+
+        The layout is kept compact: the key and the two child links, which are all a
+        search touches, come first, and the color is stored in the low bit of the
+        parent pointer, so the node carries no overhead beyond three pointers. Node
+        ids only exist in the JSON representation and are generated on the fly.
+
+        A is the value kept by the augmentation policy of the tree, it takes no
+        space when the tree is not augmented.
+    */
+    template <typename T, typename A = NoAugment::value_type>
+    struct Node
+    {
+        private:
 
-    template <typename T>
-    using Snode = std::shared_ptr<Node<T>>;
+        static constexpr std::uintptr_t RED_BIT = 1;
 
-    template <typename T>
-    struct Node 
-    {
+        public:
 
         T data_{};
-        long int uid_{NIL_UID};
-        Snode<T> p_;
-        Snode<T> l_;
-        Snode<T> r_;
+        Node* l_{nullptr};
+        Node* r_{nullptr};
+
+        private:
+
+        /* parent pointer, the low bit is set for red nodes */
+        std::uintptr_t pc_{0};
+
+        public:
+
+        /* fold of the subtree rooted here, see augment.hpp */
+        [[no_unique_address]] A aug_{};
 
         Node() = default;
-        Node(const T& value, long int uid)
+
+        /* new nodes are red */
+        explicit Node(const T& value) : data_{value}, pc_{RED_BIT} {}
+
+        Node* parent() const
+        {
+            return reinterpret_cast<Node*>(pc_ & ~RED_BIT);
+        }
+
+        void setParent(Node* p)
         {
-            init(value, uid);
+            pc_ = reinterpret_cast<std::uintptr_t>(p) | (pc_ & RED_BIT);
         }
-        void init(const T& value, long int uid)
+
+        bool isRed() const
         {
-            data_ = value;
-            uid_ = uid;    
+            return (pc_ & RED_BIT) != 0;
         }
 
-        static Snode<T> newFromData(const T& data, long int uid)
+        void flip()
         {
-            return std::make_shared<Node<T>>(data, uid);
+            pc_ ^= RED_BIT;
         }
 
-        static Snode<T> newFromJson(const core::Json& json)
+        void setRed()
         {
-            auto out = std::make_shared<Node<T>>();
-            out->fromJson(json);
-            return out;
+            pc_ |= RED_BIT;
         }
 
-        bool isRed() const 
+        void setBlack()
         {
-            return uid_ >= 0;
+            pc_ &= ~RED_BIT;
         }
 
-        void flip()
+        void setColor(bool red)
         {
-            uid_ = -uid_;
+            red ? setRed() : setBlack();
         }
 
-        bool isLeft() const 
+        bool isLeft() const
         {
             bool is_left{false};
-            if(p_) 
+            if(parent())
             {
-                is_left = this == p_->l_.get();
+                is_left = this == parent()->l_;
             }
             return is_left;
         }
 
 
-        bool isRight() const 
+        bool isRight() const
         {
             bool is_right{false};
-            if(p_) 
+            if(parent())
             {
-                is_right = this == p_->r_.get();
+                is_right = this == parent()->r_;
             }
             return is_right;
         }
 
-        bool isLeaf() const 
+        bool isLeaf() const
         {
-            bool is_leaf = !l_ && !r_;
+            bool is_leaf = (!l_ || l_->isNil()) && (!r_ || r_->isNil());
             return is_leaf;
         }
 
-        bool isNil() const 
+        bool isNil() const
         {
-            return uid_ == NIL_UID;
+            return l_ == this;
         }
 
-        bool isRoot() const 
+        bool isRoot() const
         {
-            return !bool(p_);
+            return !parent() || parent()->isNil();
         }
 
-        core::Json toJson() const 
+        /*
+            The sign of the uid encodes the color: positive is red, negative is
+            black.
+        */
+        core::Json toJson(long int uid = 1,
+                          long int p_uid = NIL_UID,
+                          long int l_uid = NIL_UID,
+                          long int r_uid = NIL_UID) const
         {
             core::Json json;
             json["data"] = data_;
-            json["uid"] = uid_;
-            json["p"] = p_ ? std::abs(p_->uid_) : NIL_UID;
-            json["l"] = l_ ? std::abs(l_->uid_) : NIL_UID;
-            json["r"] = r_ ? std::abs(r_->uid_) : NIL_UID;
+            json["uid"] = isRed() ? uid : -uid;
+            json["p"] = p_uid;
+            json["l"] = l_uid;
+            json["r"] = r_uid;
             return json;
         }
 
-        void fromJson(const core::Json& json) 
+        void fromJson(const core::Json& json)
         {
             data_ = json["data"];
-            uid_ = json["uid"];
+            setColor(json["uid"].get<long int>() > 0);
         }
     };
 
-    template <typename T> 
-    std::string format_as(Node<T> node) 
+    template <typename T, typename A>
+    std::string format_as(const Node<T, A>& node)
     {
         core::Json json = node.toJson();
         auto json_str = json.dump(4);
@@ -134,179 +207,1931 @@ namespace rbree {
     //--------------------------------------------------------------------------------------------//
     //                                       class RBtree                                         //
     //--------------------------------------------------------------------------------------------//
-    template <typename T, typename Compare = std::less<T>> 
+    template <typename T, typename Compare = std::less<T>, typename Augment = NoAugment>
+        requires AugmentPolicy<Augment, T>
+    class RBtree;
+
+    template <typename T, typename Compare, typename Augment>
+    void leftRotate(RBtree<T, Compare, Augment>& tree,
+                    typename RBtree<T, Compare, Augment>::node_type* x);
+
+    template <typename T, typename Compare, typename Augment>
+    void rightRotate(RBtree<T, Compare, Augment>& tree,
+                     typename RBtree<T, Compare, Augment>::node_type* x);
+
+    /*
+        An ordered set implemented as a red-black tree (CLRS, chapter 13).
+
+        The tree owns its nodes and a single sentinel node which stands in for every
+        missing child and for the parent of the root, so no link is ever null.
+
+        Nodes are allocated from a NodePool on top of a std::pmr::memory_resource,
+        the default resource unless one is given. For trivially destructible T,
+        clear() hands whole chunks back to the resource without visiting the nodes.
+    */
+    template <typename T, typename Compare, typename Augment>
+        requires AugmentPolicy<Augment, T>
     class RBtree
     {
-        private: 
+        public:
+
+        using node_type = Node<T, typename Augment::value_type>;
+
+        private:
 
-        Snode<T> root_;
-        const Snode<T> nil_node_{std::make_shared<Node<T>>(0.0, NIL_UID)};
+        NodePool<node_type> pool_;
+        node_type* nil_;
+        node_type* root_;
         Compare cmp_;
         std::size_t size_{0};
 
-        public: 
+        static_assert(alignof(node_type) >= 2, "the color bit needs an unused pointer bit");
 
+        template <typename U, typename C, typename A>
+        friend void leftRotate(RBtree<U, C, A>& tree, typename RBtree<U, C, A>::node_type* x);
 
+        template <typename U, typename C, typename A>
+        friend void rightRotate(RBtree<U, C, A>& tree, typename RBtree<U, C, A>::node_type* x);
+
+        /*
+            Recomputes the augmented value of x from its children. Compiles to
+            nothing for trees without augmentation.
+        */
+        void update(node_type* x) const
+        {
+            if constexpr (Augment::enabled)
+            {
+                x->aug_ = Augment::combine(Augment::combine(x->l_->aug_, Augment::lift(x->data_)),
+                                           x->r_->aug_);
+            }
+        }
+
+        /* updates x and all of its ancestors */
+        void updatePath(node_type* x) const
+        {
+            if constexpr (Augment::enabled)
+            {
+                for (; x != nil_; x = x->parent())
+                    update(x);
+            }
+        }
 
-        RBtree() = default;
+        void updateSubtree(node_type* x) const
+        {
+            if constexpr (Augment::enabled)
+            {
+                if (x == nil_)
+                    return;
+                updateSubtree(x->l_);
+                updateSubtree(x->r_);
+                update(x);
+            }
+        }
 
-        RBtree(Compare cmp)
+        node_type* newNode(const T& value)
         {
-            cmp_ = cmp;
+            auto out = pool_.create(value);
+            out->setParent(nil_);
+            out->l_ = nil_;
+            out->r_ = nil_;
+            update(out);
+            return out;
         }
 
-        Snode<T>& root() {return root_;};
-        const Snode<T>& root() const {return root_;};
+        void deleteNode(node_type* node)
+        {
+            pool_.destroy(node);
+        }
 
-        const Compare& cmp() const {return cmp_;};
+        /*
+            Replaces the subtree rooted at u by the subtree rooted at v.
+        */
+        void transplant(node_type* u, node_type* v)
+        {
+            if (u->parent() == nil_)
+                root_ = v;
+            else if (u == u->parent()->l_)
+                u->parent()->l_ = v;
+            else
+                u->parent()->r_ = v;
+            v->setParent(u->parent());
+        }
 
-        Snode<T>& search(const T& value)
+        void insertFixup(node_type* z)
         {
-            Compare cmp;
-            Snode<T> cur = root_;
-            Snode<T> prev = nullptr;
-            while (cur)
+            while (z->parent()->isRed())
             {
-                prev = cur;
-                if (cmp_(value, cur->data_))
+                node_type* g = z->parent()->parent();
+                if (z->parent() == g->l_)
                 {
-                    cur = cur->l_;
+                    node_type* y = g->r_;
+                    if (y->isRed())
+                    {
+                        z->parent()->setBlack();
+                        y->setBlack();
+                        g->setRed();
+                        z = g;
+                    }
+                    else
+                    {
+                        if (z == z->parent()->r_)
+                        {
+                            z = z->parent();
+                            leftRotate(*this, z);
+                        }
+                        z->parent()->setBlack();
+                        z->parent()->parent()->setRed();
+                        rightRotate(*this, z->parent()->parent());
+                    }
                 }
-                else if(cmp_(cur->data_, value)) 
+                else
                 {
-                    cur = cur->r_;
+                    node_type* y = g->l_;
+                    if (y->isRed())
+                    {
+                        z->parent()->setBlack();
+                        y->setBlack();
+                        g->setRed();
+                        z = g;
+                    }
+                    else
+                    {
+                        if (z == z->parent()->l_)
+                        {
+                            z = z->parent();
+                            rightRotate(*this, z);
+                        }
+                        z->parent()->setBlack();
+                        z->parent()->parent()->setRed();
+                        leftRotate(*this, z->parent()->parent());
+                    }
+                }
+            }
+            root_->setBlack();
+        }
+
+        void eraseFixup(node_type* x)
+        {
+            while (x != root_ && !x->isRed())
+            {
+                if (x == x->parent()->l_)
+                {
+                    node_type* w = x->parent()->r_;
+                    if (w->isRed())
+                    {
+                        w->setBlack();
+                        x->parent()->setRed();
+                        leftRotate(*this, x->parent());
+                        w = x->parent()->r_;
+                    }
+                    if (!w->l_->isRed() && !w->r_->isRed())
+                    {
+                        w->setRed();
+                        x = x->parent();
+                    }
+                    else
+                    {
+                        if (!w->r_->isRed())
+                        {
+                            w->l_->setBlack();
+                            w->setRed();
+                            rightRotate(*this, w);
+                            w = x->parent()->r_;
+                        }
+                        w->setColor(x->parent()->isRed());
+                        x->parent()->setBlack();
+                        w->r_->setBlack();
+                        leftRotate(*this, x->parent());
+                        x = root_;
+                    }
                 }
-                else 
+                else
                 {
-                    return cur;
+                    node_type* w = x->parent()->l_;
+                    if (w->isRed())
+                    {
+                        w->setBlack();
+                        x->parent()->setRed();
+                        rightRotate(*this, x->parent());
+                        w = x->parent()->l_;
+                    }
+                    if (!w->r_->isRed() && !w->l_->isRed())
+                    {
+                        w->setRed();
+                        x = x->parent();
+                    }
+                    else
+                    {
+                        if (!w->l_->isRed())
+                        {
+                            w->r_->setBlack();
+                            w->setRed();
+                            leftRotate(*this, w);
+                            w = x->parent()->l_;
+                        }
+                        w->setColor(x->parent()->isRed());
+                        x->parent()->setBlack();
+                        w->l_->setBlack();
+                        rightRotate(*this, x->parent());
+                        x = root_;
+                    }
                 }
             }
-            return nil_node_;
+            x->setBlack();
         }
 
+        //----------------------------------------------------------------------------------------//
+        //                                 Join based operations                                  //
+        //----------------------------------------------------------------------------------------//
+        /*
+            The bulk operations follow Blelloch, Ferizovic and Sun, "Just Join for
+            Parallel Ordered Sets". Everything is expressed through joinNodes, which
+            links two detached subtrees and a middle node in time proportional to the
+            difference of their black heights. The subtrees of the recursion are
+            disjoint, so the two halves of a set operation can run on different
+            threads: they never allocate, never write to the sentinel, and collect
+            the nodes they drop in their own NodeList, which is freed by the caller
+            once all threads are done.
+
+            Detached subtrees may have stale parent links and a red root, the links
+            are fixed whenever a subtree is attached again.
+        */
+
+        /* nodes are spawned onto other threads only for inputs of at least this size */
+        static constexpr std::size_t PARALLEL_GRAIN = std::size_t{1} << 14;
+
+        /* a list of detached nodes, linked through l_ */
+        struct NodeList
+        {
+            node_type* head_{nullptr};
+            node_type* tail_{nullptr};
+            std::size_t size_{0};
+
+            void push(node_type* x)
+            {
+                x->l_ = head_;
+                head_ = x;
+                if (!tail_)
+                    tail_ = x;
+                ++size_;
+            }
+
+            void append(NodeList& other)
+            {
+                if (!other.head_)
+                    return;
+                if (tail_)
+                    tail_->l_ = other.head_;
+                else
+                    head_ = other.head_;
+                tail_ = other.tail_;
+                size_ += other.size_;
+            }
+        };
 
-        core::Json toJson() const 
+        struct Split
         {
-            core::Json json;
+            node_type* l_;
+            node_type* m_;
+            node_type* r_;
+        };
 
-            json["size"] = size_;
-            json["root"] = std::abs(root_->uid_);
+        using SetOperation = node_type* (RBtree::*)(node_type*, node_type*, NodeList&, int);
 
-            std::stack<Snode<T>> node_stack;
-            node_stack.push(root_);
+        node_type* link(node_type* x, node_type* l, node_type* r) const
+        {
+            x->l_ = l;
+            x->r_ = r;
+            if (l != nil_)
+                l->setParent(x);
+            if (r != nil_)
+                r->setParent(x);
+            update(x);
+            return x;
+        }
 
-            while(!node_stack.empty())
+        /* number of black nodes from x down to the sentinel, x included */
+        std::size_t blackHeight(node_type* x) const
+        {
+            std::size_t bh{0};
+            for (; x != nil_; x = x->l_)
+                bh += x->isRed() ? 0 : 1;
+            return bh;
+        }
+
+        /*
+            Joins tl, k and tr when tl is black higher than tr, whose root is black.
+            k is hung off the right spine of tl and red-red violations are rotated
+            away on the way back up.
+        */
+        node_type* joinRight(node_type* tl, std::size_t bh_l, node_type* k, node_type* tr, std::size_t bh_r)
+        {
+            if (!tl->isRed() && bh_l == bh_r)
             {
-                auto cur = node_stack.top();
-                node_stack.pop();
+                k->setRed();
+                return link(k, tl, tr);
+            }
+            node_type* r = joinRight(tl->r_, bh_l - (tl->isRed() ? 0 : 1), k, tr, bh_r);
+            link(tl, tl->l_, r);
+            if (!tl->isRed() && r->isRed() && r->r_->isRed())
+            {
+                r->r_->setBlack();
+                link(tl, tl->l_, r->l_);
+                return link(r, tl, r->r_);
+            }
+            return tl;
+        }
+
+        node_type* joinLeft(node_type* tl, std::size_t bh_l, node_type* k, node_type* tr, std::size_t bh_r)
+        {
+            if (!tr->isRed() && bh_l == bh_r)
+            {
+                k->setRed();
+                return link(k, tl, tr);
+            }
+            node_type* l = joinLeft(tl, bh_l, k, tr->l_, bh_r - (tr->isRed() ? 0 : 1));
+            link(tr, l, tr->r_);
+            if (!tr->isRed() && l->isRed() && l->l_->isRed())
+            {
+                l->l_->setBlack();
+                link(tr, l->r_, tr->r_);
+                return link(l, l->l_, tr);
+            }
+            return tr;
+        }
 
-                auto cur_uid_str = core::format("{}", std::abs(cur->uid_));
+        /*
+            Returns a tree holding tl, then k, then tr, where every value in tl is
+            less than k and every value in tr is greater.
+        */
+        node_type* joinNodes(node_type* tl, node_type* k, node_type* tr)
+        {
+            // a red root can always be made black, the sentinel is never red
+            if (tl->isRed())
+                tl->setBlack();
+            if (tr->isRed())
+                tr->setBlack();
+
+            std::size_t bh_l = blackHeight(tl);
+            std::size_t bh_r = blackHeight(tr);
+            if (bh_l > bh_r)
+            {
+                node_type* t = joinRight(tl, bh_l, k, tr, bh_r);
+                if (t->isRed() && t->r_->isRed())
+                    t->setBlack();
+                return t;
+            }
+            if (bh_r > bh_l)
+            {
+                node_type* t = joinLeft(tl, bh_l, k, tr, bh_r);
+                if (t->isRed() && t->l_->isRed())
+                    t->setBlack();
+                return t;
+            }
+            k->setRed();
+            return link(k, tl, tr);
+        }
 
-                json[cur_uid_str] = cur->toJson();
+        /* removes the largest node of t, returns the rest and that node */
+        std::pair<node_type*, node_type*> splitLast(node_type* t)
+        {
+            node_type* l = t->l_;
+            node_type* r = t->r_;
+            if (r == nil_)
+                return {l, t};
+            auto [rest, last] = splitLast(r);
+            return {joinNodes(l, t, rest), last};
+        }
 
-                if(cur->l_)
-                    node_stack.push(cur->l_);
+        /* joins two trees without a middle node */
+        node_type* joinNodes(node_type* tl, node_type* tr)
+        {
+            if (tl == nil_)
+                return tr;
+            auto [rest, last] = splitLast(tl);
+            return joinNodes(rest, last, tr);
+        }
 
-                if(cur->r_)
-                    node_stack.push(cur->r_);
+        /*
+            Splits t into the values less than value, the node equivalent to value,
+            or nil() if there is none, and the values greater than value.
+        */
+        Split splitNodes(node_type* t, const T& value)
+        {
+            if (t == nil_)
+                return {nil_, nil_, nil_};
 
+            node_type* l = t->l_;
+            node_type* r = t->r_;
+            if (cmp_(value, t->data_))
+            {
+                Split s = splitNodes(l, value);
+                return {s.l_, s.m_, joinNodes(s.r_, t, r)};
             }
-            return json;
+            if (cmp_(t->data_, value))
+            {
+                Split s = splitNodes(r, value);
+                return {joinNodes(l, t, s.l_), s.m_, s.r_};
+            }
+            return {l, t, r};
         }
 
-        void fromJson(const core::Json& json)
+        void discard(node_type* t, NodeList& garbage)
         {
-            std::size_t size = json["size"].get<std::size_t>();
-            size_ = size;
+            if (t == nil_)
+                return;
+            node_type* l = t->l_;
+            node_type* r = t->r_;
+            garbage.push(t);
+            discard(l, garbage);
+            discard(r, garbage);
+        }
 
-            long int root_uid = json["root"];
+        /*
+            Applies op to (a1, a2) and (b1, b2), the first pair as a task of the
+            global core::ThreadPool while spawn_depth is positive and both pairs
+            have work to do.
+        */
+        std::pair<node_type*, node_type*> recurse(SetOperation op,
+                                              node_type* a1, node_type* a2,
+                                              node_type* b1, node_type* b2,
+                                              NodeList& garbage, int spawn_depth)
+        {
+            bool spawn = spawn_depth > 0 &&
+                         (a1 != nil_ || a2 != nil_) && (b1 != nil_ || b2 != nil_);
+            if (!spawn)
+            {
+                node_type* a = (this->*op)(a1, a2, garbage, 0);
+                node_type* b = (this->*op)(b1, b2, garbage, 0);
+                return {a, b};
+            }
 
+            NodeList a_garbage;
+            node_type* a{nullptr};
+            node_type* b{nullptr};
+            core::parallelInvoke([&] {b = (this->*op)(b1, b2, garbage, spawn_depth - 1);},
+                                 [&] {a = (this->*op)(a1, a2, a_garbage, spawn_depth - 1);});
+            garbage.append(a_garbage);
+            return {a, b};
+        }
 
-            std::stack<long int> node_ids;
-            node_ids.push(root_uid);
+        node_type* uniteNodes(node_type* t1, node_type* t2, NodeList& garbage, int spawn_depth)
+        {
+            if (t1 == nil_)
+                return t2;
+            if (t2 == nil_)
+                return t1;
+
+            node_type* l1 = t1->l_;
+            node_type* r1 = t1->r_;
+            Split s = splitNodes(t2, t1->data_);
+            if (s.m_ != nil_)
+                garbage.push(s.m_);
+
+            auto [l, r] = recurse(&RBtree::uniteNodes, l1, s.l_, r1, s.r_, garbage, spawn_depth);
+            return joinNodes(l, t1, r);
+        }
 
-            while(!node_ids.empty())
+        node_type* intersectNodes(node_type* t1, node_type* t2, NodeList& garbage, int spawn_depth)
+        {
+            if (t1 == nil_ || t2 == nil_)
             {
-                long int cur_uid = node_ids.top();
-                auto cur_uid_str = core::format("{}", cur_uid);
-                node_ids.pop();
+                discard(t1, garbage);
+                discard(t2, garbage);
+                return nil_;
+            }
 
-                core::Json cur_json = json[cur_uid_str];
-                auto cur = Node<T>::newFromJson(cur_json);
+            node_type* l1 = t1->l_;
+            node_type* r1 = t1->r_;
+            Split s = splitNodes(t2, t1->data_);
 
-                if(!root_) root_ = cur;
+            auto [l, r] = recurse(&RBtree::intersectNodes, l1, s.l_, r1, s.r_, garbage, spawn_depth);
+            if (s.m_ != nil_)
+            {
+                garbage.push(s.m_);
+                return joinNodes(l, t1, r);
+            }
+            garbage.push(t1);
+            return joinNodes(l, r);
+        }
 
-                long int l_uid = cur_json["l"];
-                if (l_uid != NIL_UID)
-                {
+        node_type* subtractNodes(node_type* t1, node_type* t2, NodeList& garbage, int spawn_depth)
+        {
+            if (t1 == nil_ || t2 == nil_)
+            {
+                discard(t2, garbage);
+                return t1;
+            }
 
-                    auto l_uid_str = core::format("{}", l_uid);
-                    core::Json l_json = json[l_uid_str];
-                    auto l = Node<T>::newFromJson(l_json);
-                    cur->l_ = l;
-                    l->p_ = cur;
-                    node_ids.push(std::abs(l_uid));
-                }
+            node_type* l1 = t1->l_;
+            node_type* r1 = t1->r_;
+            Split s = splitNodes(t2, t1->data_);
 
+            auto [l, r] = recurse(&RBtree::subtractNodes, l1, s.l_, r1, s.r_, garbage, spawn_depth);
+            if (s.m_ != nil_)
+            {
+                garbage.push(s.m_);
+                garbage.push(t1);
+                return joinNodes(l, r);
+            }
+            return joinNodes(l, t1, r);
+        }
 
-                long int r_uid = cur_json["r"];
-                if (r_uid != NIL_UID)
+        /*
+            Builds a balanced subtree from the next n values of first. Only the
+            nodes at red_depth are red, which is the deepest level whenever it is
+            not full, so every path holds the same number of black nodes.
+        */
+        template <typename ForwardIt>
+        node_type* buildSorted(ForwardIt& first, std::size_t n, std::size_t depth, std::size_t red_depth)
+        {
+            if (n == 0)
+                return nil_;
+
+            std::size_t n_left = (n - 1) / 2;
+            node_type* l = buildSorted(first, n_left, depth + 1, red_depth);
+            node_type* x = newNode(*first);
+            ++first;
+            node_type* r = buildSorted(first, n - 1 - n_left, depth + 1, red_depth);
+            x->setColor(depth > 0 && depth == red_depth);
+            return link(x, l, r);
+        }
+
+        template <typename ForwardIt>
+        node_type* buildSorted(ForwardIt first, std::size_t n)
+        {
+            return buildSorted(first, n, 0, std::bit_width(n) - 1);
+        }
+
+        /* makes t the root and frees the nodes in garbage */
+        void setRoot(node_type* t, NodeList& garbage)
+        {
+            root_ = t;
+            if (root_ != nil_)
+            {
+                root_->setParent(nil_);
+                root_->setBlack();
+            }
+            size_ -= garbage.size_;
+            for (node_type* x = garbage.head_; x;)
+            {
+                node_type* next = x->l_;
+                deleteNode(x);
+                x = next;
+            }
+        }
+
+        void applySetOperation(SetOperation op, const RBtree& other)
+        {
+            // other is copied into this tree's pool first, the copy is consumed by op
+            node_type* t2 = buildSorted(other.begin(), other.size());
+            size_ += other.size();
+
+            int spawn_depth{0};
+            if (size_ >= PARALLEL_GRAIN)
+                spawn_depth = std::bit_width(core::ThreadPool::global().size()) + 1;
+
+            NodeList garbage;
+            node_type* t = (this->*op)(root_, t2, garbage, spawn_depth);
+            setRoot(t, garbage);
+            ERR_ASSERT_EXPENSIVE_m(isValid(), "a set operation broke the red-black properties");
+        }
+
+        public:
+
+        RBtree() : RBtree(Compare{}, std::pmr::get_default_resource()) {}
+
+        RBtree(Compare cmp) : RBtree(cmp, std::pmr::get_default_resource()) {}
+
+        explicit RBtree(std::pmr::memory_resource* resource) : RBtree(Compare{}, resource) {}
+
+        RBtree(Compare cmp, std::pmr::memory_resource* resource) : pool_(resource), cmp_(cmp)
+        {
+            // the sentinel lives outside the pool so that it survives clear()
+            void* mem = resource->allocate(sizeof(node_type), alignof(node_type));
+            nil_ = ::new (mem) node_type();
+            nil_->l_ = nil_;
+            nil_->r_ = nil_;
+            nil_->aug_ = Augment::identity();
+            root_ = nil_;
+        }
+
+        RBtree(const RBtree&) = delete;
+        RBtree& operator=(const RBtree&) = delete;
+
+        /*
+            Not noexcept: other is left with a new sentinel, which is allocated
+            from its resource and may throw. Nodes point at their tree's
+            sentinel, so it cannot be stored in the tree object and moved.
+        */
+        RBtree(RBtree&& other) : RBtree(other.cmp_, other.resource())
+        {
+            swap(other);
+        }
+
+        RBtree& operator=(RBtree&& other) noexcept
+        {
+            clear();
+            swap(other);
+            return *this;
+        }
+
+        ~RBtree()
+        {
+            clear();
+            nil_->~node_type();
+            resource()->deallocate(nil_, sizeof(node_type), alignof(node_type));
+        }
+
+        void swap(RBtree& other) noexcept
+        {
+            pool_.swap(other.pool_);
+            std::swap(nil_, other.nil_);
+            std::swap(root_, other.root_);
+            std::swap(cmp_, other.cmp_);
+            std::swap(size_, other.size_);
+        }
+
+        node_type*& root() {return root_;};
+        node_type* root() const {return root_;};
+
+        node_type* nil() const {return nil_;};
+
+        const Compare& cmp() const {return cmp_;};
+
+        std::pmr::memory_resource* resource() const {return pool_.upstream();};
+
+        const NodePool<node_type>& pool() const {return pool_;};
+
+        std::size_t size() const {return size_;};
+
+        bool empty() const {return size_ == 0;};
+
+        /* the number of nodes on the longest path from the root down, 0 if empty */
+        std::size_t height() const
+        {
+            std::size_t out{0};
+            std::vector<std::pair<node_type*, std::size_t>> pending;
+            if (root_ != nil_)
+                pending.push_back({root_, 1});
+            while (!pending.empty())
+            {
+                auto [x, depth] = pending.back();
+                pending.pop_back();
+                out = std::max(out, depth);
+                if (x->l_ != nil_)
+                    pending.push_back({x->l_, depth + 1});
+                if (x->r_ != nil_)
+                    pending.push_back({x->r_, depth + 1});
+            }
+            return out;
+        }
+
+        /*
+            Checks the red-black properties, the parent links, the order of the
+            values, the size and the augmented values, in linear time. Meant for
+            tests and stress drivers; a tree which is only modified through its
+            interface is always valid.
+        */
+        bool isValid() const
+        {
+            if (root_->isRed() || nil_->isRed() || (root_ != nil_ && root_->parent() != nil_))
+                return false;
+
+            // in order walk, carrying the number of black nodes from the root
+            std::vector<std::pair<node_type*, std::size_t>> pending;
+            std::size_t leaf_blacks{0};
+            bool has_leaf{false};
+            auto checkLeaf = [&](std::size_t blacks)
+            {
+                if (!has_leaf)
+                {
+                    leaf_blacks = blacks;
+                    has_leaf = true;
+                }
+                return blacks == leaf_blacks;
+            };
+
+            node_type* x = root_;
+            std::size_t blacks{0};
+            std::size_t count{0};
+            const T* prev{nullptr};
+            while (x != nil_ || !pending.empty())
+            {
+                for (; x != nil_; x = x->l_)
                 {
+                    for (node_type* child : {x->l_, x->r_})
+                    {
+                        if (child != nil_ && (child->parent() != x || (x->isRed() && child->isRed())))
+                            return false;
+                    }
+                    if constexpr (Augment::enabled)
+                    {
+                        if (!(x->aug_ == Augment::combine(Augment::combine(x->l_->aug_, Augment::lift(x->data_)),
+                                                          x->r_->aug_)))
+                            return false;
+                    }
+                    blacks += x->isRed() ? 0 : 1;
+                    if (x->l_ == nil_ && !checkLeaf(blacks))
+                        return false;
+                    pending.push_back({x, blacks});
+                }
 
-                    auto r_uid_str = core::format("{}", r_uid);
-                    core::Json r_json = json[r_uid_str];
-                    auto r = Node<T>::newFromJson(r_json);
-                    cur->r_ = r;
-                    r->p_ = cur;
-                    node_ids.push(std::abs(r_uid));
+                auto [y, y_blacks] = pending.back();
+                pending.pop_back();
+                if ((prev && !cmp_(*prev, y->data_)) || ++count > size_)
+                    return false;
+                prev = &y->data_;
+                if (y->r_ == nil_ && !checkLeaf(y_blacks))
+                    return false;
+                x = y->r_;
+                blacks = y_blacks;
+            }
+            return count == size_;
+        }
+
+        /*
+            Returns the node holding a value equivalent to value, or nil() if there
+            is none.
+        */
+        node_type* search(const T& value) const
+        {
+            node_type* cur = root_;
+            while (cur != nil_)
+            {
+                if (cmp_(value, cur->data_))
+                {
+                    cur = cur->l_;
+                }
+                else if(cmp_(cur->data_, value))
+                {
+                    cur = cur->r_;
+                }
+                else
+                {
+                    return cur;
                 }
+            }
+            return nil_;
+        }
+
+        bool contains(const T& value) const
+        {
+            return search(value) != nil_;
+        }
+
+        /* number of lookups searchBatch() keeps in flight */
+        static constexpr std::size_t BATCH_WIDTH = 16;
+
+        /*
+            Looks up every key of keys and stores the node holding it, or nil(), at
+            the same position of out.
 
+            A single search is a chain of dependent cache misses, one per level.
+            Here up to BATCH_WIDTH searches are in flight at once and advanced one
+            level each in turn, with the next node of each prefetched, so the misses
+            of different searches overlap (asynchronous memory access chaining).
+            A finished search hands its slot to the next key.
+
+            With sort_keys the keys are visited in sorted order, so searches running
+            side by side share most of their path and find it in cache, at the cost
+            of sorting an index array first.
+        */
+        void searchBatch(std::span<const T> keys, std::span<node_type*> out, bool sort_keys = false) const
+        {
+            ERR_ASSERT_THROW_INVARG_m(keys.size() == out.size(),
+                                      "searchBatch() needs one output per key");
+
+            std::vector<std::size_t> order;
+            if (sort_keys)
+            {
+                order.resize(keys.size());
+                std::iota(order.begin(), order.end(), 0);
+                std::sort(order.begin(), order.end(),
+                          [&](std::size_t a, std::size_t b) {return cmp_(keys[a], keys[b]);});
             }
 
+            struct Probe
+            {
+                node_type* cur_;
+                std::size_t index_;
+            };
+
+            std::array<Probe, BATCH_WIDTH> probes;
+            std::size_t num_active{0};
+            std::size_t next{0};
+            auto start = [&](Probe& probe)
+            {
+                probe = {root_, sort_keys ? order[next] : next};
+                ++next;
+            };
 
+            for (; num_active < BATCH_WIDTH && next < keys.size(); ++num_active)
+                start(probes[num_active]);
+
+            while (num_active > 0)
+            {
+                for (std::size_t j = 0; j < num_active;)
+                {
+                    Probe& probe = probes[j];
+                    const T& key = keys[probe.index_];
+                    node_type* cur = probe.cur_;
+
+                    if (cur != nil_ && cmp_(key, cur->data_))
+                    {
+                        probe.cur_ = cur->l_;
+                    }
+                    else if (cur != nil_ && cmp_(cur->data_, key))
+                    {
+                        probe.cur_ = cur->r_;
+                    }
+                    else
+                    {
+                        // found, or fell off the tree
+                        out[probe.index_] = cur;
+                        if (next < keys.size())
+                            start(probe);
+                        else
+                            probe = probes[--num_active];
+                        continue;
+                    }
+                    prefetch(probe.cur_);
+                    ++j;
+                }
+            }
         }
 
+        /*
+            Returns an immutable copy of the values in Eytzinger layout, for indexes
+            which are built once and then only read. Searches in the copy touch one
+            array instead of chasing pointers, see FrozenTree.
+        */
+        FrozenTree<T, Compare> freeze() const
+        {
+            return FrozenTree<T, Compare>(begin(), end(), cmp_);
+        }
 
-    };
+        node_type* minimum(node_type* x) const
+        {
+            while (x->l_ != nil_)
+                x = x->l_;
+            return x;
+        }
 
-    template <typename T> 
-    std::string format_as(RBtree<T> tree) 
-    {
-        core::Json json = tree.toJson();
-        auto json_str = json.dump(4);
-        return json_str;
-    }
+        node_type* maximum(node_type* x) const
+        {
+            while (x->r_ != nil_)
+                x = x->r_;
+            return x;
+        }
 
-    template <typename T> 
-    void leftRotate(RBtree<T>& tree, Snode<T> x)
-    {
-        if(x->r_)
+        /*
+            Returns the in-order successor of x, or nil() if x holds the largest
+            value. Only parent links are followed, nothing is allocated.
+        */
+        node_type* successor(node_type* x) const
         {
-            // extract right subtree
-            auto y = x->r_;
-            // turn y's left tree into x's right tree
-            x->r_ = y->l_;
-            if (y->l_)
-                y->l_->p_ = x;
-            // link x's parent to y
-            y->p_ = x->p_;
-            if (x->isRoot())
-                tree.root() = y;
-            else if(x->isLeft())
-                x->p_->l_ = y;
-            else 
-                x->p_->r_ = y;
-            // make x left subtree of y
-            y->l_ = x;
-            x->p_ = y;
+            if (x->r_ != nil_)
+                return minimum(x->r_);
+            node_type* y = x->parent();
+            while (y != nil_ && x == y->r_)
+            {
+                x = y;
+                y = y->parent();
+            }
+            return y;
         }
-    }
 
+        /*
+            Returns the in-order predecessor of x, or nil() if x holds the smallest
+            value.
+        */
+        node_type* predecessor(node_type* x) const
+        {
+            if (x->l_ != nil_)
+                return maximum(x->l_);
+            node_type* y = x->parent();
+            while (y != nil_ && x == y->l_)
+            {
+                x = y;
+                y = y->parent();
+            }
+            return y;
+        }
 
-    template <typename T> 
-    void rightRotate(RBtree<T>& tree, Snode<T>& node)
-    {
+        //----------------------------------------------------------------------------------------//
+        //                                      Iterators                                         //
+        //----------------------------------------------------------------------------------------//
+        /*
+            A bidirectional iterator over the values in order. As in std::set the
+            values are read only, changing one could break the order of the tree.
+            The end iterator points to the sentinel, decrementing it gives the
+            largest value. Iterators stay valid until the node they point to is
+            erased.
+        */
+        class Iterator
+        {
+            private:
 
-    }
-}
-}
\ No newline at end of file
+            const RBtree* tree_{nullptr};
+            node_type* node_{nullptr};
+
+            public:
+
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const T*;
+            using reference = const T&;
+
+            Iterator() = default;
+
+            Iterator(const RBtree* tree, node_type* node) : tree_{tree}, node_{node} {}
+
+            node_type* node() const {return node_;};
+
+            reference operator*() const {return node_->data_;};
+
+            pointer operator->() const {return &node_->data_;};
+
+            Iterator& operator++()
+            {
+                node_ = tree_->successor(node_);
+                return *this;
+            }
+
+            Iterator operator++(int)
+            {
+                Iterator out = *this;
+                ++*this;
+                return out;
+            }
+
+            Iterator& operator--()
+            {
+                if (node_ == tree_->nil_)
+                    node_ = tree_->maximum(tree_->root_);
+                else
+                    node_ = tree_->predecessor(node_);
+                return *this;
+            }
+
+            Iterator operator--(int)
+            {
+                Iterator out = *this;
+                --*this;
+                return out;
+            }
+
+            bool operator==(const Iterator& other) const {return node_ == other.node_;};
+        };
+
+        using iterator = Iterator;
+        using const_iterator = Iterator;
+        using reverse_iterator = std::reverse_iterator<Iterator>;
+
+        Iterator begin() const {return {this, root_ == nil_ ? nil_ : minimum(root_)};};
+
+        Iterator end() const {return {this, nil_};};
+
+        reverse_iterator rbegin() const {return reverse_iterator(end());};
+
+        reverse_iterator rend() const {return reverse_iterator(begin());};
+
+        /*
+            Returns the node holding the first value not less than value, or nil().
+        */
+        node_type* lowerBoundNode(const T& value) const
+        {
+            node_type* out = nil_;
+            node_type* cur = root_;
+            while (cur != nil_)
+            {
+                if (cmp_(cur->data_, value))
+                {
+                    cur = cur->r_;
+                }
+                else
+                {
+                    out = cur;
+                    cur = cur->l_;
+                }
+            }
+            return out;
+        }
+
+        /*
+            Returns the node holding the first value greater than value, or nil().
+        */
+        node_type* upperBoundNode(const T& value) const
+        {
+            node_type* out = nil_;
+            node_type* cur = root_;
+            while (cur != nil_)
+            {
+                if (cmp_(value, cur->data_))
+                {
+                    out = cur;
+                    cur = cur->l_;
+                }
+                else
+                {
+                    cur = cur->r_;
+                }
+            }
+            return out;
+        }
+
+        Iterator lowerBound(const T& value) const {return {this, lowerBoundNode(value)};};
+
+        Iterator upperBound(const T& value) const {return {this, upperBoundNode(value)};};
+
+        /*
+            Returns the range of values equivalent to value, which holds at most one
+            value as the tree has set semantics.
+        */
+        std::pair<Iterator, Iterator> equalRange(const T& value) const
+        {
+            Iterator first = lowerBound(value);
+            Iterator last = first;
+            if (last != end() && !cmp_(value, *last))
+                ++last;
+            return {first, last};
+        }
+
+        Iterator find(const T& value) const {return {this, search(value)};};
+
+        //----------------------------------------------------------------------------------------//
+        //                                 Augmented queries                                      //
+        //----------------------------------------------------------------------------------------//
+        using aggregate_type = typename Augment::value_type;
+
+        /* fold of every value in the tree */
+        aggregate_type aggregate() const
+        {
+            return root_->aug_;
+        }
+
+        /*
+            Fold of the values in [lo, hi), in order. The paths to lo and hi are
+            walked once each, taking whole subtrees between them, so the cost is
+            O(log n) combines.
+        */
+        aggregate_type aggregate(const T& lo, const T& hi) const
+            requires Augment::enabled
+        {
+            node_type* x = root_;
+            while (x != nil_)
+            {
+                if (!cmp_(x->data_, hi))
+                {
+                    x = x->l_;
+                }
+                else if (cmp_(x->data_, lo))
+                {
+                    x = x->r_;
+                }
+                else
+                {
+                    break;
+                }
+            }
+            if (x == nil_)
+                return Augment::identity();
+
+            // x is the topmost value in the window, fold the values >= lo on its left
+            aggregate_type left = Augment::identity();
+            for (node_type* cur = x->l_; cur != nil_;)
+            {
+                if (cmp_(cur->data_, lo))
+                {
+                    cur = cur->r_;
+                }
+                else
+                {
+                    left = Augment::combine(Augment::combine(Augment::lift(cur->data_), cur->r_->aug_),
+                                            left);
+                    cur = cur->l_;
+                }
+            }
+
+            // and the values < hi on its right
+            aggregate_type right = Augment::identity();
+            for (node_type* cur = x->r_; cur != nil_;)
+            {
+                if (cmp_(cur->data_, hi))
+                {
+                    right = Augment::combine(right,
+                                             Augment::combine(cur->l_->aug_, Augment::lift(cur->data_)));
+                    cur = cur->r_;
+                }
+                else
+                {
+                    cur = cur->l_;
+                }
+            }
+            return Augment::combine(Augment::combine(left, Augment::lift(x->data_)), right);
+        }
+
+        /*
+            Returns the number of values less than value.
+        */
+        std::size_t rank(const T& value) const
+            requires CountingPolicy<Augment>
+        {
+            std::size_t out{0};
+            node_type* x = root_;
+            while (x != nil_)
+            {
+                if (cmp_(x->data_, value))
+                {
+                    out += Augment::count(x->l_->aug_) + 1;
+                    x = x->r_;
+                }
+                else
+                {
+                    x = x->l_;
+                }
+            }
+            return out;
+        }
+
+        /*
+            Returns an iterator to the i-th smallest value, counting from 0.
+        */
+        Iterator select(std::size_t i) const
+            requires CountingPolicy<Augment>
+        {
+            ERR_ASSERT_THROW_RANGE_m(i < size_, "select() index out of range");
+
+            node_type* x = root_;
+            while (true)
+            {
+                std::size_t left = Augment::count(x->l_->aug_);
+                if (i < left)
+                {
+                    x = x->l_;
+                }
+                else if (i == left)
+                {
+                    return {this, x};
+                }
+                else
+                {
+                    i -= left + 1;
+                    x = x->r_;
+                }
+            }
+        }
+
+        /*
+            Calls visitor on every value in [lo, hi) in order and returns the number
+            of values visited. If the visitor returns bool, the scan stops after it
+            returns false.
+
+            The scan descends once to the first value and then steps from node to
+            node along the parent links, without a stack or any allocation. The
+            next nodes on either path, the right child and the parent, are
+            prefetched before the visitor runs so their loads overlap with it.
+        */
+        template <typename Visitor>
+        std::size_t rangeScan(const T& lo, const T& hi, Visitor&& visitor) const
+        {
+            std::size_t num_visited{0};
+            node_type* cur = lowerBoundNode(lo);
+            while (cur != nil_ && cmp_(cur->data_, hi))
+            {
+                prefetch(cur->r_);
+                prefetch(cur->parent());
+                ++num_visited;
+                if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, const T&>, bool>)
+                {
+                    if (!visitor(std::as_const(cur->data_)))
+                        break;
+                }
+                else
+                {
+                    visitor(std::as_const(cur->data_));
+                }
+                cur = successor(cur);
+            }
+            return num_visited;
+        }
+
+        /*
+            Inserts value unless an equivalent value is already present. Returns the
+            node holding the value and whether an insertion took place.
+        */
+        std::pair<node_type*, bool> insert(const T& value)
+        {
+            node_type* y = nil_;
+            node_type* x = root_;
+            while (x != nil_)
+            {
+                y = x;
+                if (cmp_(value, x->data_))
+                    x = x->l_;
+                else if (cmp_(x->data_, value))
+                    x = x->r_;
+                else
+                    return {x, false};
+            }
+
+            node_type* z = newNode(value);
+            z->setParent(y);
+            if (y == nil_)
+                root_ = z;
+            else if (cmp_(value, y->data_))
+                y->l_ = z;
+            else
+                y->r_ = z;
+
+            ++size_;
+            updatePath(z);
+            insertFixup(z);
+            ERR_ASSERT_EXPENSIVE_m(isValid(), "insert() broke the red-black properties");
+            return {z, true};
+        }
+
+        /*
+            Removes node z, which must belong to this tree, and frees it.
+        */
+        void erase(node_type* z)
+        {
+            ERR_ASSERT_CHEAP_m(z != nil_, "erase() of the sentinel");
+            node_type* y = z;
+            node_type* x;
+            bool y_was_red = y->isRed();
+
+            if (z->l_ == nil_)
+            {
+                x = z->r_;
+                transplant(z, z->r_);
+            }
+            else if (z->r_ == nil_)
+            {
+                x = z->l_;
+                transplant(z, z->l_);
+            }
+            else
+            {
+                y = minimum(z->r_);
+                y_was_red = y->isRed();
+                x = y->r_;
+                if (y != z->r_)
+                {
+                    transplant(y, y->r_);
+                    y->r_ = z->r_;
+                    y->r_->setParent(y);
+                }
+                else
+                {
+                    x->setParent(y);
+                }
+                transplant(z, y);
+                y->l_ = z->l_;
+                y->l_->setParent(y);
+                y->setColor(z->isRed());
+            }
+
+            // x may be the sentinel, its parent is still set by transplant
+            updatePath(x->parent());
+            if (!y_was_red)
+                eraseFixup(x);
+
+            deleteNode(z);
+            --size_;
+            ERR_ASSERT_EXPENSIVE_m(isValid(), "erase() broke the red-black properties");
+        }
+
+        /*
+            Removes the value equivalent to value, if any. Returns the number of
+            removed values.
+        */
+        std::size_t erase(const T& value)
+        {
+            node_type* z = search(value);
+            if (z == nil_)
+                return 0;
+            erase(z);
+            return 1;
+        }
+
+        /*
+            Replaces the contents by the values of [first, last), which must be
+            strictly increasing. The tree is built in linear time, perfectly balanced,
+            without any rotation.
+        */
+        template <std::forward_iterator ForwardIt>
+        void fromSorted(ForwardIt first, ForwardIt last)
+        {
+            ERR_ASSERT_THROW_INVARG_m(
+                std::adjacent_find(first, last, [&](const T& a, const T& b) {return !cmp_(a, b);}) == last,
+                "fromSorted() requires strictly increasing values");
+
+            clear();
+            std::size_t n = std::distance(first, last);
+            root_ = buildSorted(first, n);
+            if (root_ != nil_)
+                root_->setParent(nil_);
+            size_ = n;
+            ERR_ASSERT_EXPENSIVE_m(isValid(), "fromSorted() built an invalid tree");
+        }
+
+        /*
+            Appends the values of other, which must all be greater than the values
+            of this tree. The values of other are copied in linear time, the two
+            trees are then joined in O(log n).
+        */
+        void join(const RBtree& other)
+        {
+            if (other.empty())
+                return;
+            ERR_ASSERT_THROW_INVARG_m(empty() || cmp_(*std::prev(end()), *other.begin()),
+                                      "join() requires the values of other to be greater");
+
+            node_type* t2 = buildSorted(other.begin(), other.size());
+            size_ += other.size();
+            NodeList garbage;
+            setRoot(joinNodes(root_, t2), garbage);
+            ERR_ASSERT_EXPENSIVE_m(isValid(), "join() broke the red-black properties");
+        }
+
+        /*
+            Moves the values greater than value into the returned tree, which uses
+            the same comparison object and memory resource. The tree is split in
+            O(log n), the moved values are then copied into the new tree.
+        */
+        RBtree split(const T& value)
+        {
+            RBtree out(cmp_, resource());
+
+            Split s = splitNodes(root_, value);
+            node_type* l = s.m_ == nil_ ? s.l_ : joinNodes(s.l_, s.m_, nil_);
+
+            std::vector<T> moved;
+            std::vector<node_type*> node_stack;
+            for (node_type* cur = s.r_; cur != nil_ || !node_stack.empty(); cur = cur->r_)
+            {
+                for (; cur != nil_; cur = cur->l_)
+                    node_stack.push_back(cur);
+                cur = node_stack.back();
+                node_stack.pop_back();
+                moved.push_back(cur->data_);
+            }
+            out.fromSorted(moved.begin(), moved.end());
+
+            NodeList garbage;
+            discard(s.r_, garbage);
+            setRoot(l, garbage);
+            ERR_ASSERT_EXPENSIVE_m(isValid() && out.isValid(), "split() broke the red-black properties");
+            return out;
+        }
+
+        /*
+            Set operations with other, which is expected to use an equivalent
+            ordering. The result replaces the contents of this tree. Each one costs
+            O(m log(n / m + 1)) work for m <= n values, plus a linear copy of other,
+            and runs the two halves of the recursion on separate threads for large
+            inputs.
+        */
+        void unite(const RBtree& other)
+        {
+            applySetOperation(&RBtree::uniteNodes, other);
+        }
+
+        void intersect(const RBtree& other)
+        {
+            applySetOperation(&RBtree::intersectNodes, other);
+        }
+
+        void subtract(const RBtree& other)
+        {
+            applySetOperation(&RBtree::subtractNodes, other);
+        }
+
+        /*
+            Frees every node, the sentinel is kept.
+        */
+        void clear()
+        {
+            if (!std::is_trivially_destructible_v<T> && root_ != nil_)
+            {
+                std::vector<node_type*> node_stack{root_};
+                while (!node_stack.empty())
+                {
+                    auto cur = node_stack.back();
+                    node_stack.pop_back();
+
+                    if (cur->l_ != nil_)
+                        node_stack.push_back(cur->l_);
+                    if (cur->r_ != nil_)
+                        node_stack.push_back(cur->r_);
+                    cur->~node_type();
+                }
+            }
+            pool_.release();
+            root_ = nil_;
+            nil_->setParent(nullptr);
+            size_ = 0;
+        }
+
+
+        private:
+
+        /*
+            SAX handler building the tree straight from the parse events of the
+            document written by toJson(). Nodes are created as their objects start
+            and kept in a table keyed by uid, the links are resolved once the
+            document has been read, so the order of the nodes in the document does
+            not matter. Only a data value which is itself an object or an array
+            is assembled into a Json value before it is converted.
+        */
+        class JsonLoader
+        {
+            private:
+
+            enum class Field {none, size, root, data, uid, link_l, link_r, other};
+
+            struct Entry
+            {
+                node_type* node_{nullptr};
+                long int l_uid_{NIL_UID};
+                long int r_uid_{NIL_UID};
+            };
+
+            // uids come from the input and need not be dense, a table indexed by
+            // uid could be made arbitrarily large by a single node
+            static constexpr std::size_t MAX_RESERVE = std::size_t{1} << 20;
+
+            RBtree& tree_;
+            std::unordered_map<long int, Entry> nodes_;
+            std::size_t size_{0};
+            long int root_uid_{NIL_UID};
+            std::size_t depth_{0};
+            Entry* cur_{nullptr};
+            Field field_{Field::none};
+            core::Json data_;
+            std::vector<core::Json*> data_stack_;
+            std::string data_key_;
+            std::string error_;
+
+            bool fail(std::string error)
+            {
+                error_ = std::move(error);
+                return false;
+            }
+
+            bool capturing() const {return !data_stack_.empty();};
+
+            /* adds a scalar or a new container to the data value being assembled */
+            core::Json* captureValue(core::Json&& value)
+            {
+                if (!capturing())
+                {
+                    data_ = std::move(value);
+                    return &data_;
+                }
+                core::Json* parent = data_stack_.back();
+                if (parent->is_array())
+                {
+                    parent->push_back(std::move(value));
+                    return &parent->back();
+                }
+                return &((*parent)[data_key_] = std::move(value));
+            }
+
+            void finishData()
+            {
+                cur_->node_->data_ = data_.template get<T>();
+                field_ = Field::none;
+            }
+
+            template <typename V>
+            bool scalar(V value)
+            {
+                if (capturing() || field_ == Field::data)
+                {
+                    captureValue(core::Json(value));
+                    if (!capturing())
+                        finishData();
+                    return true;
+                }
+                if constexpr (std::is_arithmetic_v<V>)
+                {
+                    switch (field_)
+                    {
+                        case Field::size:
+                            size_ = static_cast<std::size_t>(value);
+                            nodes_.reserve(std::min(size_, MAX_RESERVE));
+                            break;
+                        case Field::root:
+                            root_uid_ = static_cast<long int>(value);
+                            break;
+                        case Field::uid:
+                            cur_->node_->setColor(value > 0);
+                            break;
+                        case Field::link_l:
+                            cur_->l_uid_ = std::abs(static_cast<long int>(value));
+                            break;
+                        case Field::link_r:
+                            cur_->r_uid_ = std::abs(static_cast<long int>(value));
+                            break;
+                        default:
+                            break;
+                    }
+                }
+                field_ = Field::none;
+                return true;
+            }
+
+            bool startContainer(core::Json&& container)
+            {
+                if (capturing() || field_ == Field::data)
+                {
+                    data_stack_.push_back(captureValue(std::move(container)));
+                    return true;
+                }
+                ++depth_;
+                if (depth_ == 1)
+                    return container.is_object() || fail("a tree must be an object");
+                if (depth_ == 2 && cur_ && container.is_object())
+                    return true;
+                return fail("unexpected nesting in a tree");
+            }
+
+            bool endContainer()
+            {
+                if (capturing())
+                {
+                    data_stack_.pop_back();
+                    if (!capturing())
+                        finishData();
+                    return true;
+                }
+                if (depth_ == 2)
+                    cur_ = nullptr;
+                --depth_;
+                return true;
+            }
+
+            public:
+
+            explicit JsonLoader(RBtree& tree) : tree_{tree} {}
+
+            JsonLoader(const JsonLoader&) = delete;
+            JsonLoader& operator=(const JsonLoader&) = delete;
+
+            /* the nodes of a document which failed to load are freed here */
+            ~JsonLoader()
+            {
+                if (tree_.root_ != tree_.nil_)
+                    return;
+                for (auto& [uid, entry] : nodes_)
+                {
+                    if (entry.node_)
+                        tree_.deleteNode(entry.node_);
+                }
+            }
+
+            const std::string& error() const {return error_;};
+
+            bool null() {return scalar(nullptr);};
+            bool boolean(bool value) {return scalar(value);};
+            bool number_integer(core::Json::number_integer_t value) {return scalar(value);};
+            bool number_unsigned(core::Json::number_unsigned_t value) {return scalar(value);};
+            bool number_float(core::Json::number_float_t value, const core::Json::string_t&) {return scalar(value);};
+            bool string(core::Json::string_t& value) {return scalar(std::move(value));};
+            bool binary(core::Json::binary_t& value) {return scalar(std::move(value));};
+            bool start_object(std::size_t) {return startContainer(core::Json::object());};
+            bool end_object() {return endContainer();};
+            bool start_array(std::size_t) {return startContainer(core::Json::array());};
+            bool end_array() {return endContainer();};
+
+            bool key(core::Json::string_t& key)
+            {
+                if (capturing())
+                {
+                    data_key_ = std::move(key);
+                    return true;
+                }
+                if (depth_ == 2)
+                {
+                    if (key == "data")
+                        field_ = Field::data;
+                    else if (key == "uid")
+                        field_ = Field::uid;
+                    else if (key == "l")
+                        field_ = Field::link_l;
+                    else if (key == "r")
+                        field_ = Field::link_r;
+                    else
+                        field_ = Field::other;
+                    return true;
+                }
+                if (key == "size")
+                {
+                    field_ = Field::size;
+                    return true;
+                }
+                if (key == "root")
+                {
+                    field_ = Field::root;
+                    return true;
+                }
+
+                long int uid{NIL_UID};
+                auto [end, ec] = std::from_chars(key.data(), key.data() + key.size(), uid);
+                if (ec != std::errc{} || end != key.data() + key.size() || uid <= NIL_UID)
+                    return fail("unexpected key " + key);
+                auto [it, inserted] = nodes_.try_emplace(uid);
+                if (!inserted)
+                    return fail("duplicate node uid " + key);
+                cur_ = &it->second;
+                cur_->node_ = tree_.newNode(T{});
+                field_ = Field::none;
+                return true;
+            }
+
+            bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& ex)
+            {
+                return fail(core::format("parse error at byte {}: {}", position, ex.what()));
+            }
+
+            /*
+                Links the nodes read and installs them as the contents of the tree.
+            */
+            bool finish()
+            {
+                if (nodes_.size() != size_)
+                    return fail(core::format("{} nodes read for a tree of size {}", nodes_.size(), size_));
+                if (size_ == 0)
+                    return true;
+
+                auto resolve = [&](long int uid) -> node_type*
+                {
+                    if (uid == NIL_UID)
+                        return tree_.nil_;
+                    auto it = nodes_.find(uid);
+                    return it != nodes_.end() ? it->second.node_ : nullptr;
+                };
+
+                node_type* root = resolve(root_uid_);
+                if (!root || root == tree_.nil_)
+                    return fail("missing root node");
+
+                auto adopt = [&](node_type* parent, node_type* child)
+                {
+                    if (child == tree_.nil_)
+                        return true;
+                    if (child->parent() != tree_.nil_)
+                        return false;
+                    child->setParent(parent);
+                    return true;
+                };
+
+                for (auto& [uid, entry] : nodes_)
+                {
+                    node_type* l = resolve(entry.l_uid_);
+                    node_type* r = resolve(entry.r_uid_);
+                    if (!l || !r)
+                        return fail("link to a missing node");
+                    entry.node_->l_ = l;
+                    entry.node_->r_ = r;
+                    if (!adopt(entry.node_, l) || !adopt(entry.node_, r))
+                        return fail("node with two parents");
+                }
+
+                // with at most one parent per node, the walk from the root cannot cycle
+                std::size_t num_reachable{0};
+                std::vector<node_type*> pending{root};
+                while (!pending.empty() && root->parent() == tree_.nil_)
+                {
+                    node_type* x = pending.back();
+                    pending.pop_back();
+                    ++num_reachable;
+                    if (x->l_ != tree_.nil_)
+                        pending.push_back(x->l_);
+                    if (x->r_ != tree_.nil_)
+                        pending.push_back(x->r_);
+                }
+                if (num_reachable != size_)
+                    return fail("the nodes do not form a tree");
+
+                tree_.root_ = root;
+                tree_.updateSubtree(tree_.root_);
+                tree_.size_ = size_;
+                return true;
+            }
+        };
+
+        template <typename Input>
+        void fromJsonInput(Input&& input)
+        {
+            clear();
+            JsonLoader loader(*this);
+            bool loaded = core::Json::sax_parse(std::forward<Input>(input), &loader) && loader.finish();
+            ERR_ASSERT_THROW_INVARG_m(loaded, loader.error());
+        }
+
+        public:
+
+        /*
+            Replaces the contents by the tree written by toJson() to input, in a
+            single pass over the text. Unlike fromJson(), no Json document is built
+            and no node is looked up by its uid string, the memory needed on top of
+            the tree is a hash table entry of one pointer and two uids per node,
+            whatever the values of the uids. Throws
+            std::invalid_argument, leaving the tree empty, if the input is not a
+            valid tree.
+        */
+        void fromJsonStream(std::istream& input)
+        {
+            fromJsonInput(input);
+        }
+
+        /*
+            As fromJsonStream(), reading the file through a FILE*, which nlohmann's
+            parser reads faster than a stream.
+        */
+        void fromJsonFile(const std::string& filename)
+        {
+            std::FILE* file = std::fopen(filename.c_str(), "rb");
+            ERR_ASSERT_THROW_m(file != nullptr, std::runtime_error, "cannot open " + filename);
+            std::unique_ptr<std::FILE, int (*)(std::FILE*)> guard(file, &std::fclose);
+            fromJsonInput(file);
+        }
+
+        /*
+            Node ids are assigned in depth-first order when the tree is written, the
+            root is 1.
+        */
+        core::Json toJson() const
+        {
+            core::Json json;
+
+            json["size"] = size_;
+            json["root"] = root_ == nil_ ? NIL_UID : 1;
+
+            if (root_ == nil_)
+                return json;
+
+            struct Entry
+            {
+                node_type* node_;
+                long int uid_;
+                long int p_uid_;
+            };
+
+            long int next_uid{2};
+            std::stack<Entry> node_stack;
+            node_stack.push({root_, 1, NIL_UID});
+
+            while(!node_stack.empty())
+            {
+                auto cur = node_stack.top();
+                node_stack.pop();
+
+                long int l_uid = NIL_UID;
+                long int r_uid = NIL_UID;
+                if(cur.node_->l_ != nil_)
+                {
+                    l_uid = next_uid++;
+                    node_stack.push({cur.node_->l_, l_uid, cur.uid_});
+                }
+                if(cur.node_->r_ != nil_)
+                {
+                    r_uid = next_uid++;
+                    node_stack.push({cur.node_->r_, r_uid, cur.uid_});
+                }
+
+                auto cur_uid_str = core::format("{}", cur.uid_);
+                json[cur_uid_str] = cur.node_->toJson(cur.uid_, cur.p_uid_, l_uid, r_uid);
+            }
+            return json;
+        }
+
+        void fromJson(const core::Json& json)
+        {
+            clear();
+
+            std::size_t size = json["size"].get<std::size_t>();
+            long int root_uid = json["root"];
+
+            if (root_uid == NIL_UID)
+                return;
+
+            auto readNode = [&](long int uid)
+            {
+                auto node = newNode(T{});
+                node->fromJson(json[core::format("{}", uid)]);
+                return node;
+            };
+
+            root_ = readNode(root_uid);
+
+            // every node is read once, when its parent is expanded
+            std::stack<std::pair<node_type*, long int>> node_stack;
+            node_stack.push({root_, root_uid});
+
+            while(!node_stack.empty())
+            {
+                auto [cur, cur_uid] = node_stack.top();
+                node_stack.pop();
+
+                const core::Json& cur_json = json[core::format("{}", cur_uid)];
+
+                long int l_uid = std::abs(cur_json["l"].get<long int>());
+                if (l_uid != NIL_UID)
+                {
+                    auto l = readNode(l_uid);
+                    cur->l_ = l;
+                    l->setParent(cur);
+                    node_stack.push({l, l_uid});
+                }
+
+                long int r_uid = std::abs(cur_json["r"].get<long int>());
+                if (r_uid != NIL_UID)
+                {
+                    auto r = readNode(r_uid);
+                    cur->r_ = r;
+                    r->setParent(cur);
+                    node_stack.push({r, r_uid});
+                }
+            }
+            updateSubtree(root_);
+
+            size_ = size;
+        }
+
+
+    };
+
+    template <typename T, typename Compare, typename Augment>
+    std::string format_as(const RBtree<T, Compare, Augment>& tree)
+    {
+        core::Json json = tree.toJson();
+        auto json_str = json.dump(4);
+        return json_str;
+    }
+
+    template <typename T, typename Compare, typename Augment>
+    void leftRotate(RBtree<T, Compare, Augment>& tree,
+                    typename RBtree<T, Compare, Augment>::node_type* x)
+    {
+        if(!x->r_->isNil())
+        {
+            // extract right subtree
+            auto y = x->r_;
+            // turn y's left tree into x's right tree
+            x->r_ = y->l_;
+            if (!y->l_->isNil())
+                y->l_->setParent(x);
+            // link x's parent to y
+            y->setParent(x->parent());
+            if (x->isRoot())
+                tree.root() = y;
+            else if(x->isLeft())
+                x->parent()->l_ = y;
+            else
+                x->parent()->r_ = y;
+            // make x left subtree of y
+            y->l_ = x;
+            x->setParent(y);
+            tree.update(x);
+            tree.update(y);
+        }
+    }
+
+
+    template <typename T, typename Compare, typename Augment>
+    void rightRotate(RBtree<T, Compare, Augment>& tree,
+                     typename RBtree<T, Compare, Augment>::node_type* x)
+    {
+        if(!x->l_->isNil())
+        {
+            // extract left subtree
+            auto y = x->l_;
+            // turn y's right tree into x's left tree
+            x->l_ = y->r_;
+            if (!y->r_->isNil())
+                y->r_->setParent(x);
+            // link x's parent to y
+            y->setParent(x->parent());
+            if (x->isRoot())
+                tree.root() = y;
+            else if(x->isRight())
+                x->parent()->r_ = y;
+            else
+                x->parent()->l_ = y;
+            // make x right subtree of y
+            y->r_ = x;
+            x->setParent(y);
+            tree.update(x);
+            tree.update(y);
+        }
+    }
+}
+}
+
+#endif  // RBTREE_HPP_
@@ -1,5 +1,16 @@
-
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
 #include <functional>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 #include <libfoundation/core/io.hpp>
 #include <libfoundation/rbtree/rbtree.hpp>
 
@@ -10,13 +21,13 @@ namespace rbree {
 
 
 template <typename T, typename Compare = std::less<T>>
-bool equal(const RBtree<T, Compare>& t1, 
-           const RBtree<T, Compare>& t2, 
+bool equal(const RBtree<T, Compare>& t1,
+           const RBtree<T, Compare>& t2,
            bool compare_data = false)
 {
     auto cmp = t1.cmp();
     bool is_eq{true};
-    std::stack<std::pair<Snode<T>, Snode<T>>> ptr_pair_stack;
+    std::stack<std::pair<Node<T>*, Node<T>*>> ptr_pair_stack;
     ptr_pair_stack.push({t1.root(), t2.root()});
 
     while(!ptr_pair_stack.empty())
@@ -24,53 +35,124 @@ bool equal(const RBtree<T, Compare>& t1,
         auto cur_pair = ptr_pair_stack.top();
         ptr_pair_stack.pop();
 
-        is_eq = cur_pair.first->uid_ == cur_pair.second->uid_;
+        is_eq = cur_pair.first->isRed() == cur_pair.second->isRed();
         if(!is_eq) break;
 
         if(compare_data)
         {
-            is_eq = compare_data && cmp(cur_pair.first->data_, cur_pair.second->data_);
+            is_eq = !cmp(cur_pair.first->data_, cur_pair.second->data_) &&
+                    !cmp(cur_pair.second->data_, cur_pair.first->data_);
             if(!is_eq) break;
         }
 
 
-        is_eq = bool(cur_pair.first->l_) == bool(cur_pair.second->l_);
-        if(is_eq && cur_pair.first->l_ && cur_pair.second->l_)
+        is_eq = cur_pair.first->l_->isNil() == cur_pair.second->l_->isNil();
+        if(!is_eq) break;
+        if(!cur_pair.first->l_->isNil())
         {
             ptr_pair_stack.push({cur_pair.first->l_, cur_pair.second->l_});
         }
-        else break;
 
-        is_eq = bool(cur_pair.first->r_) == bool(cur_pair.second->r_);
-        if(is_eq && cur_pair.first->r_ && cur_pair.second->r_)
+        is_eq = cur_pair.first->r_->isNil() == cur_pair.second->r_->isNil();
+        if(!is_eq) break;
+        if(!cur_pair.first->r_->isNil())
         {
             ptr_pair_stack.push({cur_pair.first->r_, cur_pair.second->r_});
         }
-        else break;
 
     }
     return is_eq;
 }
 
+/*
+    Checks the binary search tree order, the parent links, that no red node has a
+    red child and that every root to leaf path has the same number of black nodes.
+    For augmented trees the value of every node must match its children.
+*/
+template <typename T, typename Compare, typename Augment>
+bool isValid(const RBtree<T, Compare, Augment>& tree)
+{
+    using node_type = typename RBtree<T, Compare, Augment>::node_type;
+
+    auto nil = tree.nil();
+    if (tree.root()->isRed() || nil->isRed())
+        return false;
+
+    // returns the black height of the subtree at x, or -1 if invalid
+    std::function<int(node_type*)> check = [&](node_type* x) -> int
+    {
+        if (x == nil)
+            return 1;
+        for (auto child : {x->l_, x->r_})
+        {
+            if (child == nil)
+                continue;
+            if (child->parent() != x)
+                return -1;
+            if (x->isRed() && child->isRed())
+                return -1;
+        }
+        if (x->l_ != nil && !tree.cmp()(x->l_->data_, x->data_))
+            return -1;
+        if (x->r_ != nil && !tree.cmp()(x->data_, x->r_->data_))
+            return -1;
+        if constexpr (Augment::enabled)
+        {
+            auto expected = Augment::combine(
+                Augment::combine(x->l_->aug_, Augment::lift(x->data_)), x->r_->aug_);
+            if (x->aug_ != expected)
+                return -1;
+        }
+
+        int lh = check(x->l_);
+        int rh = check(x->r_);
+        if (lh < 0 || lh != rh)
+            return -1;
+        return lh + (x->isRed() ? 0 : 1);
+    };
+    return check(tree.root()) > 0;
+}
+
 
 
 TEST(NodeTests, create){
 
-    Snode<double> n1 = Node<double>::newFromData(0.0, 1); 
+    Node<double> n1(0.0);
 
     core::Json json = core::loadJson("assets/rbtree/node1.json");
-    Snode<double> n2 = Node<double>::newFromJson(json);
+    Node<double> n2;
+    n2.fromJson(json);
 
-    ASSERT_DOUBLE_EQ(n1->data_, n2->data_);
-    ASSERT_EQ(n1->uid_, n2->uid_);
+    ASSERT_DOUBLE_EQ(n1.data_, n2.data_);
+    ASSERT_EQ(n1.isRed(), n2.isRed());
 }
 
 TEST(NodeTests, queries)
 {
-    Snode<double> n1 = Node<double>::newFromData(0.0, 1); 
-    Snode<double> n2 = Node<double>::newFromData(0.0, 2); 
-
-
+    Node<double> n1(0.0);
+    Node<double> n2(0.0);
+    n2.setBlack();
+
+    ASSERT_TRUE(n1.isRed());
+    ASSERT_FALSE(n2.isRed());
+    ASSERT_FALSE(Node<double>().isRed());
+    ASSERT_EQ(sizeof(Node<double>), 4 * sizeof(void*));
+
+    n1.setBlack();
+    ASSERT_FALSE(n1.isRed());
+    n1.flip();
+    ASSERT_TRUE(n1.isRed());
+
+    // the color bit does not leak into the parent link
+    n1.setParent(&n2);
+    ASSERT_EQ(n1.parent(), &n2);
+    ASSERT_TRUE(n1.isRed());
+    n1.setBlack();
+    ASSERT_EQ(n1.parent(), &n2);
+    ASSERT_FALSE(n1.isLeft());
+    ASSERT_FALSE(n1.isRight());
+    n2.l_ = &n1;
+    ASSERT_TRUE(n1.isLeft());
 }
 
 
@@ -80,11 +162,19 @@ TEST(TreeTests, create) {
 
     core::Json json = core::loadJson("assets/rbtree/tree3.json");
     tree.fromJson(json);
-    ASSERT_EQ(tree.root()->uid_, -1);
-    ASSERT_EQ(tree.root()->l_->uid_, 2);
-    ASSERT_EQ(tree.root()->l_->p_->uid_, -1);
-    ASSERT_EQ(tree.root()->r_->uid_, 3);
-    ASSERT_EQ(tree.root()->r_->p_->uid_, -1);
+    ASSERT_EQ(tree.size(), 3);
+    ASSERT_FALSE(tree.root()->isRed());
+    ASSERT_DOUBLE_EQ(tree.root()->data_, 1.0);
+    ASSERT_TRUE(tree.root()->l_->isRed());
+    ASSERT_DOUBLE_EQ(tree.root()->l_->data_, 0.0);
+    ASSERT_EQ(tree.root()->l_->parent(), tree.root());
+    ASSERT_TRUE(tree.root()->r_->isRed());
+    ASSERT_DOUBLE_EQ(tree.root()->r_->data_, 2.0);
+    ASSERT_EQ(tree.root()->r_->parent(), tree.root());
+    ASSERT_TRUE(tree.nil()->isNil());
+    ASSERT_TRUE(tree.root()->l_->isLeaf());
+    ASSERT_TRUE(tree.root()->isRoot());
+    ASSERT_TRUE(isValid(tree));
 }
 
 TEST(TreeTests, equal) {
@@ -98,6 +188,119 @@ TEST(TreeTests, equal) {
 
 }
 
+TEST(TreeTests, jsonRoundTrip) {
+
+    RBtree<int> tree1, tree2;
+    for (int i = 0; i < 100; ++i)
+        tree1.insert((i * 37) % 100);
+
+    tree2.fromJson(tree1.toJson());
+    ASSERT_EQ(tree2.size(), 100);
+    ASSERT_TRUE(equal(tree1, tree2, true));
+    ASSERT_TRUE(isValid(tree2));
+
+    // trees go through every encoding of core::save()
+    static_assert(core::HasToJson<RBtree<int>> && core::HasFromJson<RBtree<int>>);
+    auto path = (std::filesystem::temp_directory_path() / "foundation-tree.msgpack").string();
+    RBtree<int> tree3;
+    core::save(tree1, path, core::Format::msgpack);
+    core::load(tree3, path);
+    ASSERT_TRUE(equal(tree1, tree3, true));
+    std::filesystem::remove(path);
+}
+
+TEST(TreeTests, selfCheck)
+{
+    RBtree<int> tree;
+    ASSERT_TRUE(tree.isValid());
+    ASSERT_EQ(tree.height(), 0);
+    for (int i = 0; i < 3000; ++i)
+    {
+        tree.insert(std::rand() % 2000);
+        if (i % 3 == 0)
+            tree.erase(std::rand() % 2000);
+        ASSERT_EQ(tree.isValid(), isValid(tree));
+    }
+    ASSERT_TRUE(tree.isValid());
+    ASSERT_LE(tree.height(), 2 * std::log2(tree.size() + 1));
+
+    // broken colors, order and links are all reported
+    tree.root()->l_->flip();
+    ASSERT_FALSE(tree.isValid());
+    tree.root()->l_->flip();
+    std::swap(tree.root()->data_, tree.root()->l_->data_);
+    ASSERT_FALSE(tree.isValid());
+    std::swap(tree.root()->data_, tree.root()->l_->data_);
+    tree.root()->l_->setParent(tree.root()->r_);
+    ASSERT_FALSE(tree.isValid());
+    tree.root()->l_->setParent(tree.root());
+    ASSERT_TRUE(tree.isValid());
+}
+
+TEST(TreeTests, jsonStream)
+{
+    // enough nodes for uids of several digits, which the writer orders as strings
+    RBtree<int> tree1, tree2;
+    for (int i = 0; i < 5000; ++i)
+        tree1.insert(std::rand());
+
+    std::stringstream stream(tree1.toJson().dump());
+    tree2.fromJsonStream(stream);
+    ASSERT_EQ(tree2.size(), tree1.size());
+    ASSERT_TRUE(equal(tree1, tree2, true));
+    ASSERT_TRUE(isValid(tree2));
+
+    std::stringstream empty(RBtree<int>().toJson().dump());
+    tree2.fromJsonStream(empty);
+    ASSERT_TRUE(tree2.empty());
+
+    // values which are containers themselves
+    RBtree<std::vector<std::string>> tree3, tree4;
+    tree3.insert({"b", "c"});
+    tree3.insert({});
+    tree3.insert({"a"});
+    std::stringstream nested(tree3.toJson().dump());
+    tree4.fromJsonStream(nested);
+    ASSERT_EQ(std::vector<std::vector<std::string>>(tree4.begin(), tree4.end()),
+              std::vector<std::vector<std::string>>(tree3.begin(), tree3.end()));
+
+    // broken documents leave the tree empty
+    core::Json valid = tree1.toJson();
+    core::Json two_parents = valid;
+    two_parents["1"]["r"] = two_parents["1"]["l"];
+    core::Json missing = valid;
+    missing.erase("2");
+    for (const std::string& text : {valid.dump().substr(0, 1000), two_parents.dump(), missing.dump(),
+                                    std::string("[1, 2]"), std::string("{\"size\": 1, \"root\": 1}")})
+    {
+        std::stringstream broken(text);
+        ASSERT_THROW(tree2.fromJsonStream(broken), std::invalid_argument);
+        ASSERT_TRUE(tree2.empty());
+    }
+}
+
+TEST(TreeTests, jsonStreamSparseUids)
+{
+    // uids far beyond the node count cost no more than dense ones
+    RBtree<int> tree;
+    std::stringstream sparse(R"({"size": 2, "root": 4000000000,
+                                 "4000000000": {"data": 1, "uid": -4000000000, "l": 0, "r": 3000000000},
+                                 "3000000000": {"data": 2, "uid": 3000000000, "l": 0, "r": 0}})");
+    tree.fromJsonStream(sparse);
+    ASSERT_EQ(std::vector<int>(tree.begin(), tree.end()), std::vector<int>({1, 2}));
+    ASSERT_TRUE(isValid(tree));
+
+    for (const std::string& text : {std::string(R"({"size": 1, "root": 4000000000,
+                                                    "4000000000": {"data": 1, "uid": -4000000000, "l": 0, "r": 4000000001}})"),
+                                    std::string(R"({"size": 1, "root": 4000000001,
+                                                    "4000000000": {"data": 1, "uid": -4000000000, "l": 0, "r": 0}})")})
+    {
+        std::stringstream broken(text);
+        ASSERT_THROW(tree.fromJsonStream(broken), std::invalid_argument);
+        ASSERT_TRUE(tree.empty());
+    }
+}
+
 
 TEST(TreeTests, leftRotate)
 {
@@ -114,6 +317,373 @@ TEST(TreeTests, leftRotate)
     ASSERT_TRUE(equal(tree1, tree2));
 }
 
+TEST(TreeTests, rightRotate)
+{
+
+    core::Json json1 = core::loadJson("assets/rbtree/tree2-left.json");
+    core::Json json2 = core::loadJson("assets/rbtree/tree2-right.json");
+    RBtree<double> tree1, tree2;
+    tree1.fromJson(json1);
+    tree2.fromJson(json2);
+
+    rightRotate(tree2, tree2.root());
+    ASSERT_TRUE(equal(tree1, tree2));
+}
+
+TEST(TreeTests, insert)
+{
+    RBtree<int> tree;
+    std::set<int> reference;
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        int value = std::rand() % 500;
+        auto [node, inserted] = tree.insert(value);
+        ASSERT_EQ(inserted, reference.insert(value).second);
+        ASSERT_EQ(node->data_, value);
+        ASSERT_EQ(tree.size(), reference.size());
+    }
+    ASSERT_TRUE(isValid(tree));
+
+    for (int value = 0; value < 500; ++value)
+        ASSERT_EQ(tree.contains(value), reference.count(value) == 1);
+}
+
+TEST(TreeTests, erase)
+{
+    RBtree<int> tree;
+    std::set<int> reference;
+
+    for (int i = 0; i < 2000; ++i)
+    {
+        int value = std::rand() % 1000;
+        tree.insert(value);
+        reference.insert(value);
+    }
 
+    for (int i = 0; i < 2000; ++i)
+    {
+        int value = std::rand() % 1000;
+        ASSERT_EQ(tree.erase(value), reference.erase(value));
+        ASSERT_EQ(tree.size(), reference.size());
+        if (i % 100 == 0)
+        {
+            ASSERT_TRUE(isValid(tree));
+        }
+    }
+    ASSERT_TRUE(isValid(tree));
+
+    for (int value : std::vector<int>(reference.begin(), reference.end()))
+        tree.erase(value);
+    ASSERT_TRUE(tree.empty());
+    ASSERT_EQ(tree.root(), tree.nil());
+}
+
+TEST(TreeTests, iterators)
+{
+    static_assert(std::bidirectional_iterator<RBtree<int>::iterator>);
+
+    RBtree<int> tree;
+    std::set<int> reference;
+    ASSERT_TRUE(tree.begin() == tree.end());
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        int value = std::rand() % 2000;
+        tree.insert(value);
+        reference.insert(value);
+    }
+
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), reference.begin(), reference.end()));
+    ASSERT_TRUE(std::equal(tree.rbegin(), tree.rend(), reference.rbegin(), reference.rend()));
+    ASSERT_EQ(std::distance(tree.begin(), tree.end()), reference.size());
+    ASSERT_EQ(*std::prev(tree.end()), *reference.rbegin());
+    ASSERT_TRUE(tree.find(-1) == tree.end());
+}
+
+TEST(TreeTests, bounds)
+{
+    RBtree<int> tree;
+    std::set<int> reference;
+    for (int i = 0; i < 500; ++i)
+    {
+        int value = 2 * (std::rand() % 500);
+        tree.insert(value);
+        reference.insert(value);
+    }
+
+    auto position = [](const auto& begin, const auto& end, const auto& it)
+    {
+        return it == end ? -1 : std::distance(begin, it);
+    };
+    for (int value = -1; value <= 1001; ++value)
+    {
+        ASSERT_EQ(position(tree.begin(), tree.end(), tree.lowerBound(value)),
+                  position(reference.begin(), reference.end(), reference.lower_bound(value)));
+        ASSERT_EQ(position(tree.begin(), tree.end(), tree.upperBound(value)),
+                  position(reference.begin(), reference.end(), reference.upper_bound(value)));
+
+        auto [first, last] = tree.equalRange(value);
+        ASSERT_EQ(std::distance(first, last), reference.count(value));
+    }
+}
+
+TEST(TreeTests, rangeScan)
+{
+    RBtree<int> tree;
+    for (int i = 0; i < 1000; ++i)
+        tree.insert(i * 3);
+
+    std::vector<int> visited;
+    std::size_t num_visited = tree.rangeScan(100, 200, [&](int v) {visited.push_back(v);});
+
+    std::vector<int> expected;
+    for (int v = 102; v < 200; v += 3)
+        expected.push_back(v);
+    ASSERT_EQ(visited, expected);
+    ASSERT_EQ(num_visited, expected.size());
+
+    // empty and out of range windows
+    ASSERT_EQ(tree.rangeScan(200, 100, [](int) {}), 0);
+    ASSERT_EQ(tree.rangeScan(5000, 6000, [](int) {}), 0);
+    ASSERT_EQ(tree.rangeScan(-10, 1, [](int) {}), 1);
+
+    // a bool returning visitor stops the scan
+    visited.clear();
+    tree.rangeScan(0, 3000, [&](int v) {visited.push_back(v); return visited.size() < 5;});
+    ASSERT_EQ(visited, (std::vector<int>{0, 3, 6, 9, 12}));
+}
+
+TEST(TreeTests, searchBatch)
+{
+    RBtree<int> tree;
+    for (int i = 0; i < 5000; ++i)
+        tree.insert(std::rand() % 10000);
+
+    for (int n : {0, 1, 15, 16, 17, 1000})
+    {
+        std::vector<int> keys(n);
+        for (auto& key : keys)
+            key = std::rand() % 11000 - 500;
+
+        for (bool sort_keys : {false, true})
+        {
+            std::vector<Node<int>*> out(n, nullptr);
+            tree.searchBatch(keys, out, sort_keys);
+            for (int i = 0; i < n; ++i)
+                ASSERT_EQ(out[i], tree.search(keys[i]));
+        }
+    }
+
+    std::vector<int> keys(3);
+    std::vector<Node<int>*> out(2);
+    ASSERT_THROW(tree.searchBatch(keys, out), std::invalid_argument);
+}
+
+TEST(TreeTests, fromSorted)
+{
+    for (int n : {0, 1, 2, 3, 4, 7, 8, 100, 1023, 1024, 1025})
+    {
+        std::vector<int> values(n);
+        std::iota(values.begin(), values.end(), 0);
+
+        RBtree<int> tree;
+        tree.insert(-1);
+        tree.fromSorted(values.begin(), values.end());
+        ASSERT_EQ(tree.size(), n);
+        ASSERT_TRUE(isValid(tree));
+        ASSERT_TRUE(std::equal(tree.begin(), tree.end(), values.begin(), values.end()));
+    }
+
+    std::vector<int> unsorted{1, 3, 2};
+    RBtree<int> tree;
+    ASSERT_THROW(tree.fromSorted(unsorted.begin(), unsorted.end()), std::invalid_argument);
+}
+
+TEST(TreeTests, joinSplit)
+{
+    std::vector<int> low(1000), high(10);
+    std::iota(low.begin(), low.end(), 0);
+    std::iota(high.begin(), high.end(), 1000);
+
+    RBtree<int> tree1, tree2;
+    tree1.fromSorted(low.begin(), low.end());
+    tree2.fromSorted(high.begin(), high.end());
+    ASSERT_THROW(tree2.join(tree1), std::invalid_argument);
+
+    tree1.join(tree2);
+    ASSERT_EQ(tree1.size(), 1010);
+    ASSERT_TRUE(isValid(tree1));
+    ASSERT_EQ(*std::prev(tree1.end()), 1009);
+
+    for (int value : {-5, 0, 500, 1009, 2000})
+    {
+        RBtree<int> tree;
+        tree.fromSorted(low.begin(), low.end());
+        RBtree<int> upper = tree.split(value);
+        ASSERT_TRUE(isValid(tree));
+        ASSERT_TRUE(isValid(upper));
+        ASSERT_EQ(tree.size() + upper.size(), low.size());
+        ASSERT_TRUE(std::all_of(tree.begin(), tree.end(), [&](int v) {return v <= value;}));
+        ASSERT_TRUE(std::all_of(upper.begin(), upper.end(), [&](int v) {return v > value;}));
+    }
+}
+
+TEST(TreeTests, setOperations)
+{
+    // the larger sizes run the recursion on several threads
+    for (auto [n, m] : {std::pair{0, 100}, {100, 0}, {1000, 300}, {30000, 50000}})
+    {
+        std::set<int> a, b;
+        RBtree<int> tree_a, tree_b;
+        for (int i = 0; i < n; ++i)
+            a.insert(std::rand() % (2 * n + 1));
+        for (int i = 0; i < m; ++i)
+            b.insert(std::rand() % (2 * n + 1));
+        tree_a.fromSorted(a.begin(), a.end());
+        tree_b.fromSorted(b.begin(), b.end());
+
+        auto check = [&](auto op, auto set_op)
+        {
+            RBtree<int> tree;
+            tree.fromSorted(a.begin(), a.end());
+            (tree.*op)(tree_b);
+
+            std::vector<int> expected;
+            set_op(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+            ASSERT_EQ(tree.size(), expected.size());
+            ASSERT_TRUE(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end()));
+            ASSERT_TRUE(isValid(tree));
+        };
+        check(&RBtree<int>::unite, [](auto... args) {return std::set_union(args...);});
+        check(&RBtree<int>::intersect, [](auto... args) {return std::set_intersection(args...);});
+        check(&RBtree<int>::subtract, [](auto... args) {return std::set_difference(args...);});
+    }
+}
+
+/* sum and maximum of the values, a monoid without an inverse */
+struct SumMax
+{
+    using value_type = std::pair<long, int>;
+
+    static constexpr bool enabled = true;
+
+    static value_type identity() {return {0, std::numeric_limits<int>::min()};};
+
+    static value_type lift(int value) {return {value, value};};
+
+    static value_type combine(value_type a, value_type b)
+    {
+        return {a.first + b.first, std::max(a.second, b.second)};
+    };
+};
+
+TEST(AugmentTests, noOverhead)
+{
+    static_assert(sizeof(RBtree<double>::node_type) == sizeof(Node<double>));
+    static_assert(sizeof(RBtree<double, std::less<double>, SubtreeSize>::node_type) ==
+                  sizeof(Node<double>) + sizeof(std::size_t));
+}
+
+TEST(AugmentTests, rankSelect)
+{
+    RBtree<int, std::less<int>, SubtreeSize> tree;
+    std::set<int> reference;
+
+    for (int i = 0; i < 4000; ++i)
+    {
+        int value = std::rand() % 2000;
+        if (i % 3 == 2)
+        {
+            tree.erase(value);
+            reference.erase(value);
+        }
+        else
+        {
+            tree.insert(value);
+            reference.insert(value);
+        }
+    }
+    ASSERT_TRUE(isValid(tree));
+    ASSERT_EQ(tree.aggregate(), reference.size());
+
+    std::vector<int> sorted(reference.begin(), reference.end());
+    for (std::size_t i = 0; i < sorted.size(); ++i)
+    {
+        ASSERT_EQ(*tree.select(i), sorted[i]);
+        ASSERT_EQ(tree.rank(sorted[i]), i);
+    }
+    for (int value = -1; value <= 2000; ++value)
+    {
+        auto expected = std::lower_bound(sorted.begin(), sorted.end(), value) - sorted.begin();
+        ASSERT_EQ(tree.rank(value), expected);
+    }
+    ASSERT_THROW(tree.select(sorted.size()), std::out_of_range);
+}
+
+TEST(AugmentTests, rangeAggregate)
+{
+    RBtree<int, std::less<int>, SumMax> tree;
+    std::set<int> reference;
+    for (int i = 0; i < 1000; ++i)
+    {
+        int value = std::rand() % 1000;
+        tree.insert(value);
+        reference.insert(value);
+    }
+    ASSERT_TRUE(isValid(tree));
+
+    for (int i = 0; i < 200; ++i)
+    {
+        int lo = std::rand() % 1100 - 50;
+        int hi = lo + std::rand() % 300;
+
+        SumMax::value_type expected = SumMax::identity();
+        for (auto it = reference.lower_bound(lo); it != reference.lower_bound(hi); ++it)
+            expected = SumMax::combine(expected, SumMax::lift(*it));
+        ASSERT_EQ(tree.aggregate(lo, hi), expected);
+    }
+    ASSERT_EQ(tree.aggregate(10, 10), SumMax::identity());
+}
+
+TEST(AugmentTests, bulkOperations)
+{
+    std::vector<int> values(5000);
+    std::iota(values.begin(), values.end(), 0);
+
+    RBtree<int, std::less<int>, SubtreeSize> tree1, tree2;
+    tree1.fromSorted(values.begin(), values.begin() + 3000);
+    tree2.fromSorted(values.begin() + 2000, values.end());
+    ASSERT_TRUE(isValid(tree1));
+
+    tree1.unite(tree2);
+    ASSERT_TRUE(isValid(tree1));
+    ASSERT_EQ(tree1.aggregate(), 5000);
+
+    auto upper = tree1.split(2499);
+    ASSERT_TRUE(isValid(tree1));
+    ASSERT_TRUE(isValid(upper));
+    ASSERT_EQ(*upper.select(0), 2500);
+
+    RBtree<int, std::less<int>, SubtreeSize> tree3;
+    tree3.fromJson(tree1.toJson());
+    ASSERT_TRUE(isValid(tree3));
+    ASSERT_EQ(tree3.rank(1000), 1000);
+}
+
+TEST(TreeTests, move)
+{
+    RBtree<int> tree1;
+    for (int i = 0; i < 10; ++i)
+        tree1.insert(i);
+
+    RBtree<int> tree2(std::move(tree1));
+    ASSERT_EQ(tree2.size(), 10);
+    ASSERT_TRUE(tree1.empty());
+    ASSERT_TRUE(isValid(tree2));
+    ASSERT_TRUE(tree2.contains(7));
+}
+
+
+}
 }
-}
\ No newline at end of file
@@ -0,0 +1,331 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#ifndef SNAPSHOT_HPP_
+#define SNAPSHOT_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <libfoundation/core/assertions.hpp>
+#include <libfoundation/core/io.hpp>
+#include <libfoundation/rbtree/rbtree.hpp>
+
+namespace foundation {
+namespace rbree {
+
+    //--------------------------------------------------------------------------------------------//
+    //                                      Snapshot format                                       //
+    //--------------------------------------------------------------------------------------------//
+    /*
+        A binary snapshot of an ordered set of trivially copyable values, for
+        trees too large to reload from JSON in reasonable time:
+
+            offset  0   magic "RBTSNAP\0"
+                    8   format version
+                   12   byte order mark 0x01020304, as written by the producer
+                   16   sizeof(T)
+                   20   alignof(T)
+                   24   number of values
+                   32   the values in order, packed
+
+        Only the values are stored, not the shape of the tree. A red-black tree
+        over sorted values is rebuilt in linear time by RBtree::fromSorted(),
+        perfectly balanced, and the sorted array can be searched in place, so
+        readers can serve lookups straight from the mapped file without building
+        anything.
+    */
+    struct SnapshotHeader
+    {
+        static constexpr std::array<char, 8> MAGIC{'R', 'B', 'T', 'S', 'N', 'A', 'P', '\0'};
+        static constexpr std::uint32_t VERSION = 1;
+        static constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+        std::array<char, 8> magic_{MAGIC};
+        std::uint32_t version_{VERSION};
+        std::uint32_t byte_order_{BYTE_ORDER_MARK};
+        std::uint32_t value_size_{0};
+        std::uint32_t value_align_{0};
+        std::uint64_t size_{0};
+    };
+
+    static_assert(sizeof(SnapshotHeader) == 32 && std::is_trivially_copyable_v<SnapshotHeader>);
+
+    template <typename T>
+    concept Snapshottable = std::is_trivially_copyable_v<T> && alignof(T) <= alignof(std::max_align_t);
+
+    //--------------------------------------------------------------------------------------------//
+    //                                    class SnapshotWriter                                    //
+    //--------------------------------------------------------------------------------------------//
+    /*
+        Streams values into a snapshot file through a fixed size buffer, so a
+        snapshot can be written without holding all values in memory. The values
+        must be appended in strictly increasing order. The header is completed by
+        close(), a file which was not closed is not recognized as a snapshot.
+    */
+    template <Snapshottable T, typename Compare = std::less<T>>
+    class SnapshotWriter
+    {
+        private:
+
+        static constexpr std::size_t BUFFER_LEN = (std::size_t{1} << 16) / sizeof(T) + 1;
+
+        std::FILE* file_{nullptr};
+        std::string filename_;
+        std::vector<T> buffer_;
+        std::uint64_t size_{0};
+        bool has_last_{false};
+        T last_{};
+        Compare cmp_;
+
+        void flush()
+        {
+            std::size_t num_written = std::fwrite(buffer_.data(), sizeof(T), buffer_.size(), file_);
+            ERR_ASSERT_THROW_m(num_written == buffer_.size(), std::runtime_error,
+                               "failed to write snapshot " + filename_);
+            buffer_.clear();
+        }
+
+        void writeHeader(bool complete)
+        {
+            SnapshotHeader header;
+            if (!complete)
+                header.magic_ = {};
+            header.value_size_ = sizeof(T);
+            header.value_align_ = alignof(T);
+            header.size_ = size_;
+            ERR_ASSERT_THROW_m(std::fwrite(&header, sizeof(header), 1, file_) == 1, std::runtime_error,
+                               "failed to write snapshot " + filename_);
+        }
+
+        public:
+
+        explicit SnapshotWriter(const std::string& filename, Compare cmp = Compare{})
+            : filename_{filename}, cmp_{cmp}
+        {
+            file_ = std::fopen(filename.c_str(), "wb");
+            ERR_ASSERT_THROW_m(file_ != nullptr, std::runtime_error,
+                               "cannot create snapshot " + filename);
+            buffer_.reserve(BUFFER_LEN);
+            // without the magic, until the number of values is known
+            writeHeader(false);
+        }
+
+        SnapshotWriter(const SnapshotWriter&) = delete;
+        SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+        ~SnapshotWriter()
+        {
+            if (file_)
+                std::fclose(file_);
+        }
+
+        std::uint64_t size() const {return size_;};
+
+        void append(const T& value)
+        {
+            ERR_ASSERT_THROW_INVARG_m(!has_last_ || cmp_(last_, value),
+                                      "snapshot values must be strictly increasing");
+            buffer_.push_back(value);
+            last_ = value;
+            has_last_ = true;
+            ++size_;
+            if (buffer_.size() == BUFFER_LEN)
+                flush();
+        }
+
+        /*
+            Writes the buffered values and the final header and closes the file.
+        */
+        void close()
+        {
+            flush();
+            ERR_ASSERT_THROW_m(std::fseek(file_, 0, SEEK_SET) == 0, std::runtime_error,
+                               "failed to write snapshot " + filename_);
+            writeHeader(true);
+            int status = std::fclose(file_);
+            file_ = nullptr;
+            ERR_ASSERT_THROW_m(status == 0, std::runtime_error, "failed to write snapshot " + filename_);
+        }
+    };
+
+    //--------------------------------------------------------------------------------------------//
+    //                                     class MappedSnapshot                                   //
+    //--------------------------------------------------------------------------------------------//
+    /*
+        A read-only view of a snapshot file, through core::MappedFile. Where mmap
+        is available pages are faulted in as lookups touch them, so opening even a
+        large snapshot costs a few system calls; elsewhere the file is read in one
+        go.
+
+        The header is validated on open and std::runtime_error is thrown for files
+        which are not snapshots of T written on a machine of the same byte order.
+    */
+    template <Snapshottable T, typename Compare = std::less<T>>
+    class MappedSnapshot
+    {
+        private:
+
+        core::MappedFile file_;
+        std::span<const T> values_;
+        Compare cmp_;
+
+        void validate(const std::string& filename)
+        {
+            SnapshotHeader header;
+            header.magic_ = {};
+            if (file_.size() >= sizeof(header))
+                std::memcpy(&header, file_.bytes().data(), sizeof(header));
+
+            std::string error;
+            if (header.magic_ != SnapshotHeader::MAGIC)
+                error = "not a snapshot: ";
+            else if (header.version_ != SnapshotHeader::VERSION)
+                error = "unsupported snapshot version: ";
+            else if (header.byte_order_ != SnapshotHeader::BYTE_ORDER_MARK)
+                error = "snapshot written with a different byte order: ";
+            else if (header.value_size_ != sizeof(T) || header.value_align_ != alignof(T))
+                error = "snapshot of a different value type: ";
+            else if (header.size_ > (file_.size() - sizeof(SnapshotHeader)) / sizeof(T))
+                error = "truncated snapshot ";
+
+            if (!error.empty())
+            {
+                file_ = {};
+                ERR_ASSERT_THROW_m(false, std::runtime_error, error + filename);
+            }
+            values_ = {reinterpret_cast<const T*>(file_.bytes().data() + sizeof(SnapshotHeader)),
+                       static_cast<std::size_t>(header.size_)};
+        }
+
+        public:
+
+        MappedSnapshot() = default;
+
+        explicit MappedSnapshot(const std::string& filename, Compare cmp = Compare{})
+            : file_{filename}, cmp_{cmp}
+        {
+            validate(filename);
+        }
+
+        MappedSnapshot(MappedSnapshot&& other) noexcept
+            : file_{std::move(other.file_)},
+              values_{std::exchange(other.values_, {})},
+              cmp_{std::move(other.cmp_)}
+        {
+        }
+
+        MappedSnapshot& operator=(MappedSnapshot&& other) noexcept
+        {
+            if (this != &other)
+            {
+                file_ = std::move(other.file_);
+                values_ = std::exchange(other.values_, {});
+                cmp_ = std::move(other.cmp_);
+            }
+            return *this;
+        }
+
+        /* the values in order, valid as long as the snapshot is */
+        std::span<const T> values() const {return values_;};
+
+        std::size_t size() const {return values_.size();};
+
+        bool empty() const {return values_.empty();};
+
+        auto begin() const {return values_.begin();};
+
+        auto end() const {return values_.end();};
+
+        auto lowerBound(const T& value) const
+        {
+            return std::lower_bound(values_.begin(), values_.end(), value, cmp_);
+        }
+
+        auto upperBound(const T& value) const
+        {
+            return std::upper_bound(values_.begin(), values_.end(), value, cmp_);
+        }
+
+        /*
+            Returns the value equivalent to value, or nullptr.
+        */
+        const T* search(const T& value) const
+        {
+            auto it = lowerBound(value);
+            if (it == values_.end() || cmp_(value, *it))
+                return nullptr;
+            return &*it;
+        }
+
+        bool contains(const T& value) const
+        {
+            return search(value) != nullptr;
+        }
+
+        /*
+            Calls visitor on every value in [lo, hi) in order and returns the number
+            of values visited. If the visitor returns bool, the scan stops after it
+            returns false.
+        */
+        template <typename Visitor>
+        std::size_t rangeScan(const T& lo, const T& hi, Visitor&& visitor) const
+        {
+            std::size_t num_visited{0};
+            for (auto it = lowerBound(lo); it != values_.end() && cmp_(*it, hi); ++it)
+            {
+                ++num_visited;
+                if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, const T&>, bool>)
+                {
+                    if (!visitor(*it))
+                        break;
+                }
+                else
+                {
+                    visitor(*it);
+                }
+            }
+            return num_visited;
+        }
+    };
+
+    /*
+        Writes the values of tree to a snapshot file.
+    */
+    template <Snapshottable T, typename Compare, typename Augment>
+    void saveSnapshot(const RBtree<T, Compare, Augment>& tree, const std::string& filename)
+    {
+        SnapshotWriter<T, Compare> writer(filename, tree.cmp());
+        for (const T& value : tree)
+            writer.append(value);
+        writer.close();
+    }
+
+    /*
+        Replaces the contents of tree by the values of a snapshot file, building
+        the tree in linear time straight from the mapped values.
+    */
+    template <Snapshottable T, typename Compare, typename Augment>
+    void loadSnapshot(RBtree<T, Compare, Augment>& tree, const std::string& filename)
+    {
+        MappedSnapshot<T, Compare> snapshot(filename, tree.cmp());
+        tree.fromSorted(snapshot.begin(), snapshot.end());
+    }
+
+}
+}
+
+#endif  // SNAPSHOT_HPP_
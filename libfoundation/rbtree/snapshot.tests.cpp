@@ -0,0 +1,135 @@
+// ------------------------------------------------------
+//  John Alexander Ferguson, 2023
+//  Distributed under CC0 1.0 Universal licence
+// ------------------------------------------------------
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <libfoundation/rbtree/snapshot.hpp>
+
+#include <gtest/gtest.h>
+
+namespace foundation {
+namespace rbree {
+
+static std::string snapshotPath(const std::string& name)
+{
+    return (std::filesystem::temp_directory_path() / ("foundation-" + name + ".snap")).string();
+}
+
+TEST(SnapshotTests, roundTrip)
+{
+    auto path = snapshotPath("round-trip");
+    for (int n : {0, 1, 1000, 100000})
+    {
+        // built in one go, inserts would each validate the whole tree with expensive checks
+        std::vector<std::int64_t> values(n);
+        std::int64_t value{4 * static_cast<std::int64_t>(n)};
+        for (std::int64_t& v : values)
+            v = value -= 1 + std::rand() % 4;
+        RBtree<std::int64_t, std::greater<std::int64_t>> tree;
+        tree.fromSorted(values.begin(), values.end());
+        saveSnapshot(tree, path);
+
+        RBtree<std::int64_t, std::greater<std::int64_t>> loaded;
+        loaded.insert(-1);
+        loadSnapshot(loaded, path);
+        ASSERT_EQ(loaded.size(), tree.size());
+        ASSERT_EQ(std::vector<std::int64_t>(loaded.begin(), loaded.end()),
+                  std::vector<std::int64_t>(tree.begin(), tree.end()));
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(SnapshotTests, mappedReads)
+{
+    auto path = snapshotPath("mapped-reads");
+    RBtree<int> tree;
+    for (int i = 0; i < 5000; ++i)
+        tree.insert(std::rand() % 20000);
+    saveSnapshot(tree, path);
+
+    MappedSnapshot<int> snapshot(path);
+    ASSERT_EQ(snapshot.size(), tree.size());
+    for (int i = 0; i < 1000; ++i)
+    {
+        int value = std::rand() % 20100 - 50;
+        ASSERT_EQ(snapshot.contains(value), tree.contains(value));
+        auto lower = tree.lowerBound(value);
+        ASSERT_EQ(snapshot.lowerBound(value) == snapshot.end(), lower == tree.end());
+        if (lower != tree.end())
+        {
+            ASSERT_EQ(*snapshot.lowerBound(value), *lower);
+        }
+    }
+
+    std::vector<int> expected;
+    tree.rangeScan(100, 900, [&](int value) {expected.push_back(value);});
+    std::vector<int> found;
+    ASSERT_EQ(snapshot.rangeScan(100, 900, [&](int value) {found.push_back(value);}), expected.size());
+    ASSERT_EQ(found, expected);
+
+    // the mapping moves with the snapshot
+    MappedSnapshot<int> moved = std::move(snapshot);
+    ASSERT_EQ(moved.size(), tree.size());
+    ASSERT_TRUE(snapshot.empty());
+    std::filesystem::remove(path);
+}
+
+TEST(SnapshotTests, streamingWriter)
+{
+    auto path = snapshotPath("streaming");
+    {
+        SnapshotWriter<std::int64_t> writer(path);
+        for (std::int64_t i = 0; i < 100000; ++i)
+            writer.append(3 * i);
+        ASSERT_THROW(writer.append(0), std::invalid_argument);
+        writer.close();
+    }
+    MappedSnapshot<std::int64_t> snapshot(path);
+    ASSERT_EQ(snapshot.size(), 100000);
+    ASSERT_TRUE(snapshot.contains(3 * 77777));
+    ASSERT_FALSE(snapshot.contains(3 * 77777 + 1));
+    std::filesystem::remove(path);
+}
+
+TEST(SnapshotTests, invalidFiles)
+{
+    auto path = snapshotPath("invalid");
+    ASSERT_THROW(MappedSnapshot<int>(snapshotPath("missing")), std::runtime_error);
+
+    // a writer which was never closed
+    {
+        SnapshotWriter<int> writer(path);
+        writer.append(1);
+    }
+    ASSERT_THROW(MappedSnapshot<int>{path}, std::runtime_error);
+
+    // a snapshot of another value type
+    {
+        SnapshotWriter<std::int64_t> writer(path);
+        writer.append(1);
+        writer.close();
+    }
+    ASSERT_THROW(MappedSnapshot<int>{path}, std::runtime_error);
+
+    // a truncated snapshot
+    std::filesystem::resize_file(path, sizeof(SnapshotHeader) + 4);
+    ASSERT_THROW(MappedSnapshot<std::int64_t>{path}, std::runtime_error);
+
+    // not a snapshot at all
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    std::fputs("{\"size\": 0, \"root\": 0, \"padding\": \"...........\"}", file);
+    std::fclose(file);
+    ASSERT_THROW(MappedSnapshot<int>{path}, std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+}
+}
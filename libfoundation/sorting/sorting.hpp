@@ -11,6 +11,8 @@
 #include <stack>
 #include <utility>
 
+#include <libfoundation/core/assertions.hpp>
+#include <libfoundation/core/memory.hpp>
 #include <libfoundation/heaps/heaps.hpp>
 
 namespace foundation
@@ -76,6 +78,7 @@ void insertionSort(BidirIt start, BidirIt end)
 
         }
     }
+    ERR_ASSERT_EXPENSIVE_m(std::is_sorted(start, end), "insertionSort() left the range unsorted");
 }
 //}}}
 //{{{ fun: heap sort
@@ -112,6 +115,7 @@ void heapSort(BidirIt first, BidirIt last)
         heaps::internal::heapify(first, heap_size, 0);
         std::advance(top, -1);
     }
+    ERR_ASSERT_EXPENSIVE_m(std::is_sorted(first, last), "heapSort() left the range unsorted");
 }
 
 //}}}
@@ -148,6 +152,9 @@ BidirIt partition(BidirIt start, BidirIt end)
         }
         std::iter_swap(std::next(i_iter), std::prev(end));
         std::advance(i_iter, 1);
+        ERR_ASSERT_EXPENSIVE_m(std::all_of(start, i_iter, [&](const Value& x) { return x <= *i_iter; }) &&
+                                   std::all_of(std::next(i_iter), end, [&](const Value& x) { return *i_iter < x; }),
+                               "partition() left the range unpartitioned");
     }
     return i_iter;
 }
@@ -161,7 +168,12 @@ void quickSort(BidirIt start, BidirIt end)
     using Diff  = DiffType<BidirIt>;
     using Range = std::pair<BidirIt, BidirIt>;
 
-    std::stack<Range> ranges;
+    /* doc
+    The stack of pending ranges lives in the thread's scratch arena, so
+    sorting does not touch the global heap once the arena has warmed up.
+    */
+    core::ScratchScope                         scratch;
+    std::stack<Range, std::pmr::vector<Range>> ranges(scratch.vector<Range>(64));
     ranges.push({start, end});
 
     while (!ranges.empty())
@@ -184,6 +196,7 @@ void quickSort(BidirIt start, BidirIt end)
             ranges.push({tmp, current_end});
         }
     }
+    ERR_ASSERT_EXPENSIVE_m(std::is_sorted(start, end), "quickSort() left the range unsorted");
 }
 
 //}}}